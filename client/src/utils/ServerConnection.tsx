@@ -10,6 +10,65 @@ import {
 
 import SubscriptionManager from './SubscriptionManager'
 
+// see ServerEvents.InputEvent for the layout of input frames
+const INPUT_FRAME_KEYFRAME = 0x01
+const INPUT_FRAME_SENSORS_16_BIT = 0x02
+const INPUT_FRAME_HEADER_SIZE = 3
+
+// input data of a device so far, as input frames only carry changes
+interface InputFrameState {
+  sensors: number[]
+  buttons: boolean[]
+}
+
+const decodeInputFrame = (
+  frame: Uint8Array | ArrayBuffer,
+  previous: InputFrameState | undefined
+): InputFrameState | null => {
+  const bytes = frame instanceof ArrayBuffer ? new Uint8Array(frame) : frame
+  const flags = bytes[0]
+  const sensorCount = bytes[1]
+  const buttonCount = bytes[2]
+  const keyframe = (flags & INPUT_FRAME_KEYFRAME) !== 0
+  const sensors16Bit = (flags & INPUT_FRAME_SENSORS_16_BIT) !== 0
+  const maxSensorValue = sensors16Bit ? 0xffff : 0xff
+
+  // changes to something we don't have yet are useless. wait for a keyframe.
+  if (!keyframe && (!previous || previous.sensors.length !== sensorCount)) {
+    return null
+  }
+
+  let offset = INPUT_FRAME_HEADER_SIZE
+
+  const buttons: boolean[] = []
+  for (let i = 0; i < buttonCount; i++) {
+    buttons.push((bytes[offset + (i >> 3)] & (1 << (i & 7))) !== 0)
+  }
+  offset += Math.ceil(buttonCount / 8)
+
+  const maskOffset = offset
+  if (!keyframe) {
+    offset += Math.ceil(sensorCount / 8)
+  }
+
+  const sensors = keyframe ? new Array<number>(sensorCount) : [...previous!.sensors]
+  for (let i = 0; i < sensorCount; i++) {
+    if (!keyframe && (bytes[maskOffset + (i >> 3)] & (1 << (i & 7))) === 0) {
+      continue
+    }
+
+    if (sensors16Bit) {
+      sensors[i] = (bytes[offset] | (bytes[offset + 1] << 8)) / maxSensorValue
+      offset += 2
+    } else {
+      sensors[i] = bytes[offset] / maxSensorValue
+      offset += 1
+    }
+  }
+
+  return { sensors, buttons }
+}
+
 interface ServerConnectionSettings {
   address: string
   onConnect: () => void
@@ -21,6 +80,7 @@ class ServerConnection {
   private ioSocket: SocketIOClient.Socket
   private inputEventSubscriptions: SubscriptionManager<DeviceInputData>
   private rateEventSubscriptions: SubscriptionManager<number>
+  private inputFrameStates: { [deviceId: string]: InputFrameState } = {}
 
   constructor(settings: ServerConnectionSettings) {
     this.inputEventSubscriptions = new SubscriptionManager()
@@ -41,7 +101,15 @@ class ServerConnection {
   }
 
   private handleInputEvent = (event: ServerEvents.InputEvent) => {
-    this.inputEventSubscriptions.emit(event.deviceId, event.inputData)
+    const state = decodeInputFrame(event.frame, this.inputFrameStates[event.deviceId])
+
+    if (!state) {
+      return
+    }
+
+    // subscribers get arrays of their own, next frame doesn't touch them.
+    this.inputFrameStates[event.deviceId] = state
+    this.inputEventSubscriptions.emit(event.deviceId, state)
   }
 
   private handleRateEvent = (event: ServerEvents.EventRate) => {
@@ -54,6 +122,8 @@ class ServerConnection {
   }
 
   private unsubscribeFromDevice = (deviceId: string) => {
+    delete this.inputFrameStates[deviceId]
+
     const event: ClientEvents.UnsubscribeFromDevice = {
       deviceId
     }
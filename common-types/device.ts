@@ -1,15 +1,33 @@
+// how raw values of a sensor are filtered on the device before comparing them
+// to thresholds. stages are applied in this order.
+export interface SensorFilter {
+  medianOf3: boolean // reject single sample spikes
+  emaShift: number // new sample has weight of 1 / 2^emaShift, 0-6. 0 = no averaging
+  deadband: number // in raw sensor units, 0-15. 0 = no deadband
+}
+
 // this is information that user is excepted to reconfigure
 export interface DeviceConfiguration {
   name: string
+  // profile that is in use. fields below are the configuration of this profile
+  activeProfile: number
   sensorThresholds: number[]
+  // same release threshold for all sensors. changing it sets every sensor to it
   releaseThreshold: number
+  // button is released when sensor drops below this fraction of its threshold
+  sensorReleaseThresholds: number[]
   sensorToButtonMapping: number[]
+  sensorFilters: SensorFilter[]
+  // device moves thresholds along when sensors slowly drift while idle
+  trackSensorDrift: boolean
 }
 
 // this is information from device that cannot be changed
 export interface DeviceProperties {
   buttonCount: number
   sensorCount: number
+  // how many configuration profiles device can switch between
+  profileCount: number
 }
 
 export interface DeviceDescription {
@@ -23,4 +41,24 @@ export interface DeviceInputData {
   buttons: boolean[]
 }
 
+// distribution of measured durations. every bucket contains values below its
+// upper bound and above the previous one, last bucket has no upper bound.
+export interface DeviceTelemetryHistogram {
+  bucketUpperBoundsUs: number[]
+  counts: number[]
+  maxUs: number
+}
+
+// device's own timing measurements since the previous telemetry update
+export interface DeviceTelemetry {
+  scanDuration: DeviceTelemetryHistogram
+  // from the scan that changed a button to host taking the gamepad report
+  pressLatency: DeviceTelemetryHistogram
+  // how steadily device gets to make a gamepad report every 1 ms. this is
+  // not measured from host polls, see Telemetry.h in firmware.
+  callbackJitter: DeviceTelemetryHistogram
+  // from the scan a gamepad report was made from to the poll that took it
+  sampleAge: DeviceTelemetryHistogram
+}
+
 export type DeviceDescriptionMap = { [deviceId: string]: DeviceDescription }
\ No newline at end of file
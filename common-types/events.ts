@@ -1,4 +1,8 @@
-import { DeviceConfiguration, DeviceInputData, DeviceDescriptionMap } from './device'
+import {
+  DeviceConfiguration,
+  DeviceDescriptionMap,
+  DeviceTelemetry
+} from './device'
 
 // events from server
 export namespace ServerEvents {
@@ -11,9 +15,30 @@ export namespace ServerEvents {
     eventRate: number
   }
 
+  // input data is sent as a binary frame, which holds only the sensors that
+  // have changed since the previous frame of the device:
+  //
+  //   byte 0       flags. 0x01 = keyframe, every sensor is included.
+  //                0x02 = sensor values are 16-bit, otherwise 8-bit
+  //   byte 1       sensor count
+  //   byte 2       button count
+  //   buttons      bitfield, one bit per button, lowest bit first. 1 = pressed
+  //   sensor mask  bitfield of sensors included in this frame. not in keyframes
+  //   sensors      included sensors in order, 0 to 255 or 65535 (uint16 LE),
+  //                mapping to 0 to 1 of DeviceInputData
+  //
+  // sensors that are not included keep their previous value. frames can be
+  // dropped, but a keyframe comes at least once a second and right after
+  // subscribing to a device.
   export type InputEvent = {
     deviceId: string
-    inputData: DeviceInputData
+    // Buffer on the server, ArrayBuffer on the client
+    frame: Uint8Array | ArrayBuffer
+  }
+
+  export type Telemetry = {
+    deviceId: string
+    telemetry: DeviceTelemetry
   }
 }
 
@@ -49,6 +74,9 @@ export namespace ClientEvents {
 
   export type Calibrate = {
     deviceId: string,
+    // 0-1, how far above its idle value a threshold goes, on the same scale
+    // as sensor values and thresholds that clients see. drivers convert it
+    // to device units, which can be raw or linearized.
     calibrationBuffer: number
   }
 } 
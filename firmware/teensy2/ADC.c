@@ -1,7 +1,14 @@
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <util/delay_basic.h>
 
 #include "Config/DancePadConfig.h"
+#include "ADC.h"
+#include "Telemetry.h"
 
 // see page 308 of https://cdn.sparkfun.com/datasheets/Dev/Arduino/Boards/ATMega32U4.pdf for these
 static const uint8_t sensorToAnalogPin[12] = {
@@ -19,33 +26,731 @@ static const uint8_t sensorToAnalogPin[12] = {
     0b100101
 };
 
+// ADC clock is cpu clock divided by 2^prescaler, prescaler being the value
+// of ADPS bits as is. see ADC_SetSpeed().
+#define ADC_MAX_PRESCALER 7
+#define ADC_PRESCALER_MASK ((1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0))
+
+// captures only need 8 bits, which the ADC still gives with a 1 MHz clock.
+// 13 us per conversion.
+#define ADC_CAPTURE_PRESCALER_BITS ((1 << ADPS2) | (0 << ADPS1) | (0 << ADPS0))
+
+#if ADC_MUX_COUNT > 0
+    #if ADC_MUX_COUNT > 12
+        #error "there are only 12 analog pins for muxes"
+    #endif
+
+    #define ADC_MUX_SELECT_MASK ((ADC_MUX_CHANNELS - 1) << ADC_MUX_SELECT_SHIFT)
+
+    static const uint8_t muxSettleUs[] = ADC_MUX_SETTLE_US;
+    _Static_assert(sizeof (muxSettleUs) == ADC_MUX_COUNT, "ADC_MUX_SETTLE_US needs one value per mux");
+
+    // ADC samples its input 1.5 ADC clocks after the conversion starts, and
+    // conversion starts on the next ADC clock edge. select lines can't
+    // change before that. one loop is 4 cpu cycles, depends on prescaler.
+    static uint16_t sampleDelayLoops = 1;
+
+    // input that select lines point to, and when they were last changed.
+    static uint8_t muxInput = 0;
+    static uint16_t muxInputChangedAt = 0;
+
+    // how long the mux of the selected sensor takes to settle.
+    static uint16_t selectedSettleTicks = 0;
+#endif
+
 #if ADC_TEST_MODE
     static uint16_t test_mode_value = 0;
 #endif
 
-void ADC_Init(void) {
-    // different prescalers change conversion speed. tinker! 111 is slowest, and not fast enough for many sensors.
-    const uint8_t prescaler = (1 << ADPS2) | (1 << ADPS1) | (0 << ADPS0);
+// scanning happens in the ADC interrupt: every time a conversion finishes, the
+// result is stored and conversion for the next sensor is started right away.
+// when all sensors have been converted, the frame that was written to becomes
+// the latest complete frame and the ISR moves on to the next one in the ring.
+// frame with sequence number n is always in slot n % ADC_FRAME_BUFFER_SIZE.
+// captures use the same memory, there isn't RAM for both.
+static volatile union {
+    AdcFrame frames[ADC_FRAME_BUFFER_SIZE];
+    uint8_t captureSamples[ADC_CAPTURE_BUFFER_SIZE];
+} buffer;
 
-    ADCSRA = (1 << ADEN) | prescaler;
-    ADMUX = (1 << REFS0); // analog reference = 5V VCC
-    ADCSRB = (1 << ADHSM); // enable high speed mode
-}
+static volatile uint8_t currentSensor = 0;
+static volatile bool newFrameAvailable = false;
+static volatile uint16_t frameCount = 0;
+
+// how many of the completed frames in the buffer can be read, at most one
+// less than there are slots.
+static volatile uint8_t validFrames = 0;
+
+// ISR scans by one schedule, the other one is where the next schedule is
+// written to. they are swapped between frames.
+static AdcSchedule schedules[2];
+static volatile uint8_t activeSchedule = 0;
+static volatile bool schedulePending = false;
+
+// only touched by the ISR once it's running.
+static uint8_t schedulePosition = 0;
+static uint8_t conversionsInFrame = 0;
+static uint8_t idleSensorIndex = 0;
+
+// speed settings in use, and the ones that are taken into use when the
+// next frame starts.
+static AdcSpeedSettings speed = ADC_DEFAULT_SPEED;
+static AdcSpeedSettings pendingSpeed;
+static volatile bool speedPending = false;
+
+// see ADC_SetFrameDeadline(). 0 is off.
+static volatile uint16_t frameDeadlineTicks = 0;
+static volatile uint16_t startOfFrameTicks = 0;
+static uint16_t readFrameTimestamp = 0;
+
+// pausing shorter than this isn't worth the interrupt.
+#define ADC_MIN_PAUSE_TICKS (4 * TELEMETRY_TICKS_PER_US)
+
+// same goes for waiting for muxes, shorter waits are spun in the ISR. even if
+// every conversion of a frame spun this long, it would take a small part of
+// the time between host polls.
+_Static_assert((SENSOR_COUNT + 1) * ADC_MIN_PAUSE_TICKS <= ADC_USB_FRAME_TICKS / 10, "ISR would spin too long");
+
+// how long the previous frame took from its first conversion to its end,
+// without and with an idle sensor. 0 until measured.
+static uint16_t frameStartTicks = 0;
+static uint16_t frameDurations[2] = { 0, 0 };
+
+// captures go through these states. starting and stopping happen in the
+// ISR, when conversion that was running is done.
+#define ADC_CAPTURE_STARTING 4
+#define ADC_CAPTURE_STOPPING 5
+
+static volatile uint8_t captureState = ADC_CAPTURE_IDLE;
+static AdcCaptureSettings captureSettings;
 
-uint16_t ADC_Read(uint8_t sensor) {
-    uint8_t pin = sensorToAnalogPin[sensor];
+// only touched by the ISR while capturing.
+static uint8_t captureSlot = 0; // which of the sensors is being converted
+static uint16_t captureWriteIndex = 0;
+static uint16_t captureBufferEnd = 0; // buffer is used as a ring of whole rounds of samples
+static uint16_t capturePreTriggerLeft = 0; // rounds before the trigger is looked for
+static uint16_t captureSamplesLeft = 0; // after the trigger
+static uint8_t capturePreviousValue = 0;
+static uint16_t captureTriggerTicks = 0;
+static uint16_t captureDurationTicks = 0;
+
+#if ADC_MUX_COUNT > 0
+    // with muxes, select lines are shared, so sensors behind the same mux
+    // input are converted one after another. once the last of them has been
+    // sampled, select lines are changed for the next input while it's still
+    // being converted, so muxes settle in the background. muxes that settle
+    // slower are converted later, which gives them more time.
+    static bool ADC_ScansBefore(uint8_t a, uint8_t b) {
+        uint8_t inputA = a % ADC_MUX_CHANNELS;
+        uint8_t inputB = b % ADC_MUX_CHANNELS;
+
+        if (inputA != inputB) {
+            return inputA < inputB;
+        }
+
+        uint8_t muxA = a / ADC_MUX_CHANNELS;
+        uint8_t muxB = b / ADC_MUX_CHANNELS;
+
+        if (muxSettleUs[muxA] != muxSettleUs[muxB]) {
+            return muxSettleUs[muxA] < muxSettleUs[muxB];
+        }
+
+        return muxA < muxB;
+    }
+
+    static void ADC_SortScanOrder(uint8_t* sensors, uint8_t count) {
+        for (uint8_t i = 1; i < count; i++) {
+            uint8_t sensor = sensors[i];
+            uint8_t j = i;
+
+            for (; j > 0 && ADC_ScansBefore(sensor, sensors[j - 1]); j--) {
+                sensors[j] = sensors[j - 1];
+            }
+
+            sensors[j] = sensor;
+        }
+    }
+
+    static inline void ADC_SelectMuxInput(uint8_t sensor) {
+        uint8_t input = sensor % ADC_MUX_CHANNELS;
+
+        if (input != muxInput) {
+            ADC_MUX_SELECT_PORT = (ADC_MUX_SELECT_PORT & ~ADC_MUX_SELECT_MASK) | (input << ADC_MUX_SELECT_SHIFT);
+            muxInput = input;
+            muxInputChangedAt = Telemetry_Now();
+        }
+    }
+
+    // 0 if select lines were changed long enough ago for the selected sensor.
+    static inline uint16_t ADC_MuxSettleTicksLeft(void) {
+        uint16_t elapsed = Telemetry_Now() - muxInputChangedAt;
+        return elapsed < selectedSettleTicks ? selectedSettleTicks - elapsed : 0;
+    }
+
+    // called right after conversion of the current sensor is started.
+    static inline void ADC_PrepareMux(uint8_t nextSensor) {
+        if (nextSensor % ADC_MUX_CHANNELS != muxInput) {
+            _delay_loop_2(sampleDelayLoops);
+            ADC_SelectMuxInput(nextSensor);
+        }
+    }
+#endif
+
+static inline void ADC_SelectChannel(uint8_t sensor) {
+    #if ADC_MUX_COUNT > 0
+        // normally select lines are already there, see ADC_PrepareMux().
+        // conversion waits for the mux to settle, see ADC_StartWhenSettled().
+        ADC_SelectMuxInput(sensor);
+        selectedSettleTicks = muxSettleUs[sensor / ADC_MUX_CHANNELS] * TELEMETRY_TICKS_PER_US;
+        uint8_t pin = sensorToAnalogPin[sensor / ADC_MUX_CHANNELS];
+    #else
+        uint8_t pin = sensorToAnalogPin[sensor];
+    #endif
 
     // see: https://www.avrfreaks.net/comment/885267#comment-885267
     ADMUX = (ADMUX & 0xE0) | (pin & 0x1F); // select channel (MUX0-4 bits)
-    ADCSRB = (ADCSRB & 0xDF) | (pin & 0x20); // select channel (MUX5 bit) 
+    ADCSRB = (ADCSRB & 0xDF) | (pin & 0x20); // select channel (MUX5 bit)
+}
+
+// only called when no conversion is running.
+static void ADC_ApplySpeed(void) {
+    ADMUX = speed.eightBit ? (ADMUX | (1 << ADLAR)) : (ADMUX & ~(1 << ADLAR));
+    ADCSRB = speed.highSpeed ? (ADCSRB | (1 << ADHSM)) : (ADCSRB & ~(1 << ADHSM));
+    ADCSRA = (ADCSRA & ~ADC_PRESCALER_MASK) | speed.prescaler;
+
+    #if ADC_MUX_COUNT > 0
+        sampleDelayLoops = (3 << speed.prescaler) / 4;
+
+        if (sampleDelayLoops == 0) {
+            sampleDelayLoops = 1;
+        }
+    #endif
+}
+
+// picks up pending speed and schedule, and decides whether an idle sensor is
+// converted in the frame that is starting.
+static inline void ADC_StartFrame(void) {
+    if (speedPending) {
+        speed = pendingSpeed;
+        speedPending = false;
+        ADC_ApplySpeed();
+
+        // frames take a different time now.
+        frameDurations[0] = 0;
+        frameDurations[1] = 0;
+    }
+
+    if (schedulePending) {
+        activeSchedule ^= 1;
+        schedulePending = false;
+        idleSensorIndex = 0;
+    }
+
+    const AdcSchedule* schedule = &schedules[activeSchedule];
+    conversionsInFrame = schedule->sensorCount;
+    schedulePosition = 0;
+
+    // schedule without any sensors still needs something to convert.
+    if (schedule->idleSensorCount > 0 && (schedule->sensorCount == 0 || (frameCount % ADC_IDLE_SENSOR_INTERVAL) == 0)) {
+        conversionsInFrame++;
+    }
+}
+
+static inline uint8_t ADC_ScheduledSensor(uint8_t position) {
+    const AdcSchedule* schedule = &schedules[activeSchedule];
+    return position < schedule->sensorCount ? schedule->sensors[position] : schedule->idleSensors[idleSensorIndex];
+}
+
+static inline bool ADC_FrameHasIdleSensor(void) {
+    return conversionsInFrame > schedules[activeSchedule].sensorCount;
+}
+
+// timer 1 compare interrupt starts the conversion at given time instead.
+// time has to be at least ADC_MIN_PAUSE_TICKS away.
+static inline void ADC_StartConversionAt(uint16_t ticks) {
+    OCR1A = ticks;
+    TIFR1 = (1 << OCF1A);
+    TIMSK1 |= (1 << OCIE1A);
+}
+
+// with a deadline, frame that is about to start is held back if it's the
+// last one to complete before the deadline, so that it completes right at
+// it. samples are then as fresh as they can be when host polls. timer 1
+// compare interrupt starts the frame when the pause is over.
+static inline bool ADC_PauseBeforeFrame(void) {
+    uint16_t deadline = frameDeadlineTicks;
+    uint16_t duration = frameDurations[ADC_FrameHasIdleSensor()];
+
+    if (deadline == 0 || duration == 0 || duration >= ADC_USB_FRAME_TICKS) {
+        return false;
+    }
+
+    uint16_t now = Telemetry_Now();
+    uint16_t sinceStartOfFrame = now - startOfFrameTicks;
+
+    // start of frames have stopped, ie. bus is suspended.
+    if (sinceStartOfFrame >= ADC_USB_FRAME_TICKS) {
+        return false;
+    }
+
+    uint16_t untilDeadline = deadline > sinceStartOfFrame
+        ? deadline - sinceStartOfFrame
+        : deadline + ADC_USB_FRAME_TICKS - sinceStartOfFrame;
+
+    // frame misses this deadline anyway, or another one fits before it.
+    if (untilDeadline < duration || untilDeadline - duration >= duration) {
+        return false;
+    }
+
+    uint16_t pause = untilDeadline - duration;
+
+    if (pause < ADC_MIN_PAUSE_TICKS) {
+        return false;
+    }
+
+    ADC_StartConversionAt(now + pause);
+    return true;
+}
+
+// starts converting the sensor that has already been selected.
+static inline void ADC_StartConversion(void) {
+    if (schedulePosition == 0) {
+        frameStartTicks = Telemetry_Now();
+    }
+
+    ADCSRA |= (1 << ADSC);
+
+    #if ADC_MUX_COUNT > 0
+        // sensor after this one. first one of the next frame is a guess, as
+        // schedule could still change, but a wrong guess only costs a wait.
+        uint8_t nextPosition = schedulePosition + 1;
+        ADC_PrepareMux(ADC_ScheduledSensor(nextPosition < conversionsInFrame ? nextPosition : 0));
+    #endif
+}
+
+// starts converting the sensor that has already been selected, once its mux
+// has settled. ISR doesn't wait for slow muxes, timer 1 compare interrupt
+// starts the conversion when it's time.
+static inline void ADC_StartWhenSettled(void) {
+    #if ADC_MUX_COUNT > 0
+        uint16_t settleTicksLeft = ADC_MuxSettleTicksLeft();
+
+        if (settleTicksLeft >= ADC_MIN_PAUSE_TICKS) {
+            ADC_StartConversionAt(Telemetry_Now() + settleTicksLeft);
+            return;
+        }
+
+        if (settleTicksLeft > 0) {
+            // one tick is 8 cpu cycles, one loop is 4.
+            _delay_loop_2(settleTicksLeft * 2);
+        }
+    #endif
+
+    if (captureState != ADC_CAPTURE_IDLE) {
+        ADCSRA |= (1 << ADSC);
+    } else {
+        ADC_StartConversion();
+    }
+}
+
+static inline bool ADC_CaptureTriggered(uint8_t value) {
+    uint8_t level = captureSettings.triggerLevel;
+    uint8_t flags = captureSettings.triggerFlags;
+    uint8_t previous = capturePreviousValue;
+
+    if (!(flags & (ADC_CAPTURE_TRIGGER_RISING | ADC_CAPTURE_TRIGGER_FALLING))) {
+        return true;
+    }
+
+    return ((flags & ADC_CAPTURE_TRIGGER_RISING) && previous < level && value >= level)
+        || ((flags & ADC_CAPTURE_TRIGGER_FALLING) && previous > level && value <= level);
+}
+
+// picks up where scanning was before the capture, with a fresh frame.
+static void ADC_ResumeScanning(void) {
+    ADC_ApplySpeed();
+    captureState = ADC_CAPTURE_IDLE;
+
+    // samples have overwritten every frame.
+    memset((void*) buffer.frames, 0, sizeof (buffer.frames));
+    validFrames = 0;
+
+    ADC_StartFrame();
+    currentSensor = ADC_ScheduledSensor(0);
+    ADC_SelectChannel(currentSensor);
+    ADC_StartWhenSettled();
+}
+
+// called from the ISR instead of scanning while there is a capture.
+static inline void ADC_CaptureSample(void) {
+    uint8_t state = captureState;
+
+    if (state == ADC_CAPTURE_STOPPING) {
+        ADC_ResumeScanning();
+        return;
+    }
+
+    if (state == ADC_CAPTURE_STARTING) {
+        // result of the conversion that was running is dropped, frames
+        // aren't there for it anymore.
+        ADMUX |= (1 << ADLAR);
+        ADCSRA = (ADCSRA & ~ADC_PRESCALER_MASK) | ADC_CAPTURE_PRESCALER_BITS;
+        newFrameAvailable = false;
+        validFrames = 0;
+        captureSlot = 0;
+        captureWriteIndex = 0;
+        captureState = ADC_CAPTURE_WAITING;
+    } else if (state != ADC_CAPTURE_DONE) {
+        uint8_t value = ADCH;
+        buffer.captureSamples[captureWriteIndex] = value;
+
+        if (++captureWriteIndex == captureBufferEnd) {
+            captureWriteIndex = 0;
+        }
 
-    ADCSRA |= (1 << ADSC); // start conversion
-    while (ADCSRA & (1 << ADSC)) {}; // wait until done
+        // first sensor is the one that triggers.
+        if (state == ADC_CAPTURE_WAITING && captureSlot == 0) {
+            if (capturePreTriggerLeft > 0) {
+                capturePreTriggerLeft--;
+            } else if (ADC_CaptureTriggered(value)) {
+                captureTriggerTicks = Telemetry_Now();
+                captureState = state = ADC_CAPTURE_RUNNING;
+            }
+
+            capturePreviousValue = value;
+        }
+
+        // ADC is left idle once done, until capture is stopped.
+        if (state == ADC_CAPTURE_RUNNING && --captureSamplesLeft == 0) {
+            captureDurationTicks = Telemetry_Now() - captureTriggerTicks;
+            captureState = ADC_CAPTURE_DONE;
+            return;
+        }
+
+        if (++captureSlot == captureSettings.sensorCount) {
+            captureSlot = 0;
+        }
+    } else {
+        return;
+    }
+
+    if (state == ADC_CAPTURE_STARTING || captureSettings.sensorCount > 1) {
+        ADC_SelectChannel(captureSettings.sensors[captureSlot]);
+    }
+
+    ADC_StartWhenSettled();
+}
+
+void ADC_SetSchedule(const AdcSchedule* schedule) {
+    #if ADC_MUX_COUNT > 0
+        // sorted before interrupts are turned off, it takes a while.
+        AdcSchedule sorted = *schedule;
+        ADC_SortScanOrder(sorted.sensors, sorted.sensorCount);
+        ADC_SortScanOrder(sorted.idleSensors, sorted.idleSensorCount);
+        schedule = &sorted;
+    #endif
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        memcpy(&schedules[activeSchedule ^ 1], schedule, sizeof (AdcSchedule));
+        schedulePending = true;
+    }
+}
+
+bool ADC_SetSpeed(const AdcSpeedSettings* settings) {
+    if (settings->prescaler == 0 || settings->prescaler > ADC_MAX_PRESCALER) {
+        return false;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        pendingSpeed = *settings;
+        speedPending = true;
+    }
+
+    return true;
+}
+
+void ADC_SetFrameDeadline(uint16_t offsetTicks) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        frameDeadlineTicks = offsetTicks % ADC_USB_FRAME_TICKS;
+    }
+}
+
+void ADC_StartOfFrame(uint16_t ticks) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        startOfFrameTicks = ticks;
+    }
+}
+
+bool ADC_StartCapture(const AdcCaptureSettings* settings) {
+    AdcCaptureSettings capture = *settings;
+
+    if (capture.sensorCount == 0 || capture.sensorCount > ADC_CAPTURE_MAX_SENSORS) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < capture.sensorCount; i++) {
+        if (capture.sensors[i] >= SENSOR_COUNT) {
+            return false;
+        }
+    }
+
+    uint16_t maxSampleCount = ADC_CAPTURE_BUFFER_SIZE / capture.sensorCount;
+
+    if (capture.sampleCount > maxSampleCount) {
+        capture.sampleCount = maxSampleCount;
+    }
+
+    if (!(capture.triggerFlags & (ADC_CAPTURE_TRIGGER_RISING | ADC_CAPTURE_TRIGGER_FALLING))) {
+        capture.preTriggerCount = 0;
+    }
+
+    if (capture.sampleCount == 0 || capture.preTriggerCount >= capture.sampleCount) {
+        return false;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // a capture that is already running is simply restarted.
+        if (captureState == ADC_CAPTURE_DONE) {
+            ADC_ResumeScanning();
+        }
+
+        captureSettings = capture;
+        captureBufferEnd = maxSampleCount * capture.sensorCount;
+        capturePreTriggerLeft = capture.preTriggerCount;
+        captureSamplesLeft = (capture.sampleCount - capture.preTriggerCount) * capture.sensorCount;
+
+        // so that the level has to be crossed after the capture has started.
+        uint8_t direction = capture.triggerFlags & (ADC_CAPTURE_TRIGGER_RISING | ADC_CAPTURE_TRIGGER_FALLING);
+        capturePreviousValue = direction == ADC_CAPTURE_TRIGGER_RISING ? UINT8_MAX
+            : direction == ADC_CAPTURE_TRIGGER_FALLING ? 0
+            : capture.triggerLevel;
+
+        captureState = ADC_CAPTURE_STARTING;
+    }
+
+    return true;
+}
+
+void ADC_StopCapture(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        uint8_t state = captureState;
+
+        if (state == ADC_CAPTURE_DONE) {
+            // ADC is idle, nothing is going to call the ISR.
+            ADC_ResumeScanning();
+        } else if (state != ADC_CAPTURE_IDLE) {
+            // even one that hasn't started yet: a restarted capture has
+            // already changed ADC settings and overwritten frames.
+            captureState = ADC_CAPTURE_STOPPING;
+        }
+    }
+}
+
+void ADC_GetCaptureStatus(AdcCaptureStatus* status) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        uint8_t state = captureState;
+
+        if (state == ADC_CAPTURE_STARTING) {
+            state = ADC_CAPTURE_WAITING;
+        } else if (state == ADC_CAPTURE_STOPPING) {
+            state = ADC_CAPTURE_IDLE;
+        }
+
+        status->state = state;
+        status->sensorCount = captureSettings.sensorCount;
+        status->sampleCount = captureSettings.sampleCount;
+        status->triggerPosition = captureSettings.preTriggerCount;
+        status->durationTicks = state == ADC_CAPTURE_DONE ? captureDurationTicks : 0;
+    }
+}
+
+uint8_t ADC_ReadCapture(uint16_t offset, uint8_t* samples, uint8_t count) {
+    // ISR doesn't touch anything once capture is done.
+    if (captureState != ADC_CAPTURE_DONE) {
+        return 0;
+    }
+
+    uint16_t total = captureSettings.sampleCount * captureSettings.sensorCount;
+
+    if (offset >= total) {
+        return 0;
+    }
+
+    if (count > total - offset) {
+        count = total - offset;
+    }
+
+    // capture ended where the next sample would have been written.
+    uint16_t index = captureWriteIndex + offset + (captureBufferEnd - total);
+
+    for (uint8_t i = 0; i < count; i++, index++) {
+        if (index >= captureBufferEnd) {
+            index -= captureBufferEnd;
+        }
+
+        samples[i] = buffer.captureSamples[index];
+    }
+
+    return count;
+}
+
+void ADC_Init(void) {
+    ADMUX = (1 << REFS0); // analog reference = 5V VCC
+    ADCSRB = 0;
+    ADCSRA = (1 << ADEN) | (1 << ADIE);
+
+    const AdcSpeedSettings defaultSpeed = ADC_DEFAULT_SPEED;
+    speed = defaultSpeed;
+    speedPending = false;
+    ADC_ApplySpeed();
+
+    #if ADC_MUX_COUNT > 0
+        ADC_MUX_SELECT_DDR |= ADC_MUX_SELECT_MASK;
+        ADC_MUX_SELECT_PORT &= ~ADC_MUX_SELECT_MASK;
+        muxInput = 0;
+        muxInputChangedAt = Telemetry_Now();
+    #endif
+
+    // every sensor in every frame until told otherwise.
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        schedules[0].sensors[i] = i;
+    }
+
+    #if ADC_MUX_COUNT > 0
+        ADC_SortScanOrder(schedules[0].sensors, SENSOR_COUNT);
+    #endif
+
+    schedules[0].sensorCount = SENSOR_COUNT;
+    schedules[0].idleSensorCount = 0;
+    activeSchedule = 0;
+    schedulePending = false;
+    frameDeadlineTicks = 0;
+    frameDurations[0] = 0;
+    frameDurations[1] = 0;
+    TIMSK1 &= ~(1 << OCIE1A);
+    captureState = ADC_CAPTURE_IDLE;
+    validFrames = 0;
+    ADC_StartFrame();
+
+    // kick off the first conversion, the interrupt keeps it going from there.
+    currentSensor = ADC_ScheduledSensor(0);
+    ADC_SelectChannel(currentSensor);
+    ADC_StartWhenSettled();
+}
+
+bool ADC_ReadFrame(uint16_t* sensorValues) {
+    bool available;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        available = newFrameAvailable;
+
+        if (available) {
+            // interrupts are off, so ISR can't swap frames while we're copying.
+            uint8_t latest = (frameCount - 1) & (ADC_FRAME_BUFFER_SIZE - 1);
+            memcpy(sensorValues, (const uint16_t*) buffer.frames[latest].sensorValues, sizeof (buffer.frames[0].sensorValues));
+            readFrameTimestamp = buffer.frames[latest].timestamp;
+            newFrameAvailable = false;
+        }
+    }
+
+    return available;
+}
+
+uint16_t ADC_GetReadFrameTimestamp(void) {
+    return readFrameTimestamp;
+}
+
+uint16_t ADC_GetFrameCount(void) {
+    uint16_t count;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        count = frameCount;
+    }
+
+    return count;
+}
+
+bool ADC_ReadBufferedFrame(uint16_t sequence, AdcFrame* frame) {
+    bool available;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // how many frames ago it was completed, minus one.
+        uint16_t age = frameCount - 1 - sequence;
+        available = age < validFrames;
+
+        if (available) {
+            memcpy(frame, (const AdcFrame*) &buffer.frames[sequence & (ADC_FRAME_BUFFER_SIZE - 1)], sizeof (AdcFrame));
+        }
+    }
+
+    return available;
+}
+
+ISR(ADC_vect) {
+    if (captureState != ADC_CAPTURE_IDLE) {
+        ADC_CaptureSample();
+        return;
+    }
+
+    uint8_t sensor = currentSensor;
+    volatile AdcFrame* frame = &buffer.frames[frameCount & (ADC_FRAME_BUFFER_SIZE - 1)];
 
     #if ADC_TEST_MODE
         test_mode_value++;
-        return ((test_mode_value / 50) + (sensor * 50)) % 1024;
+        frame->sensorValues[sensor] = ((test_mode_value / 50) + (sensor * 50)) % 1024;
     #else
-        return ADC;  
+        // 8 bits are read from the high byte, see ADC_SetSpeed().
+        frame->sensorValues[sensor] = speed.eightBit ? ADCH << 2 : ADC;
     #endif
+
+    if (++schedulePosition == conversionsInFrame) {
+        const AdcSchedule* schedule = &schedules[activeSchedule];
+
+        if (conversionsInFrame > schedule->sensorCount && ++idleSensorIndex == schedule->idleSensorCount) {
+            idleSensorIndex = 0;
+        }
+
+        uint16_t now = Telemetry_Now();
+        frameDurations[ADC_FrameHasIdleSensor()] = now - frameStartTicks;
+        frame->timestamp = now;
+        newFrameAvailable = true;
+        frameCount++;
+
+        // slot of the current frame counts as taken.
+        if (validFrames < ADC_FRAME_BUFFER_SIZE - 1) {
+            validFrames++;
+        }
+
+        ADC_StartFrame();
+
+        // sensors that won't be converted carry their values over to the
+        // next frame.
+        schedule = &schedules[activeSchedule];
+        volatile AdcFrame* next = &buffer.frames[frameCount & (ADC_FRAME_BUFFER_SIZE - 1)];
+
+        for (uint8_t i = 0; i < schedule->idleSensorCount; i++) {
+            uint8_t idleSensor = schedule->idleSensors[i];
+            next->sensorValues[idleSensor] = frame->sensorValues[idleSensor];
+        }
+    }
+
+    sensor = ADC_ScheduledSensor(schedulePosition);
+
+    // channel can be changed right away, sample and hold for the previous
+    // conversion has been done long ago.
+    currentSensor = sensor;
+    ADC_SelectChannel(sensor);
+
+    if (schedulePosition == 0 && ADC_PauseBeforeFrame()) {
+        return;
+    }
+
+    ADC_StartWhenSettled();
+}
+
+// end of the pause before a frame, see ADC_PauseBeforeFrame(), or of the
+// wait for a mux, see ADC_StartWhenSettled().
+ISR(TIMER1_COMPA_vect) {
+    TIMSK1 &= ~(1 << OCIE1A);
+    ADC_StartWhenSettled();
 }
@@ -1,7 +1,131 @@
 #ifndef _ADC_H_
 #define _ADC_H_
     #include <stdint.h>
-    
+    #include <stdbool.h>
+    #include "Config/DancePadConfig.h"
+    #include "Telemetry.h"
+
+    // how many of the most recently scanned frames are kept around. one of
+    // them is always being written to. must be a power of two.
+    #define ADC_FRAME_BUFFER_SIZE 8
+
+    typedef struct {
+        uint16_t sensorValues[SENSOR_COUNT];
+        uint16_t timestamp; // telemetry ticks when the frame was completed
+    } AdcFrame;
+
+    // USB full speed frame is 1 ms, see ADC_SetFrameDeadline().
+    #define ADC_USB_FRAME_TICKS (1000 * TELEMETRY_TICKS_PER_US)
+
+    // idle sensors are converted one at a time, once every this many frames.
+    #define ADC_IDLE_SENSOR_INTERVAL 16
+
+    // which sensors are converted for every frame. fewer conversions make
+    // frames shorter, so the sensors that matter are scanned more often.
+    // idle sensors keep their previous value in between.
+    typedef struct {
+        uint8_t sensors[SENSOR_COUNT];
+        uint8_t sensorCount;
+        uint8_t idleSensors[SENSOR_COUNT];
+        uint8_t idleSensorCount;
+    } AdcSchedule;
+
+    // how sensors are converted. ADC clock is cpu clock divided by 2^prescaler
+    // (ADPS bits, 1-7), high speed mode (ADHSM) lets it run faster than 200
+    // kHz at the cost of power, and with eightBit only the 8 most significant
+    // bits are read (ADLAR), which are still good at clocks where the last
+    // two are noise. values are in 10-bit scale either way. faster clocks
+    // scan more often but are noisier, see Characterization.h.
+    typedef struct {
+        uint8_t prescaler;
+        bool highSpeed;
+        bool eightBit;
+    } __attribute__((packed)) AdcSpeedSettings;
+
+    // ADC clock of 250 kHz, 52 us per conversion.
+    #define ADC_DEFAULT_SPEED { .prescaler = 6, .highSpeed = true, .eightBit = false }
+
+    // high speed capture of a few sensors, to see how they respond between
+    // scans. while capturing, ADC converts only those sensors, back to back
+    // with 8-bit precision and a faster ADC clock, and no frames are scanned.
+    // samples share memory with the frame buffer, so scanning only resumes
+    // once capture is stopped, after the samples have been read.
+    #define ADC_CAPTURE_MAX_SENSORS 4
+    #define ADC_CAPTURE_BUFFER_SIZE (ADC_FRAME_BUFFER_SIZE * sizeof (AdcFrame))
+
+    // capture is triggered when first sensor crosses triggerLevel in given
+    // direction. without either, it starts right away.
+    #define ADC_CAPTURE_TRIGGER_RISING 0x01
+    #define ADC_CAPTURE_TRIGGER_FALLING 0x02
+
+    typedef struct {
+        uint8_t sensors[ADC_CAPTURE_MAX_SENSORS];
+        uint8_t sensorCount;
+        uint16_t sampleCount; // per sensor, capped to what fits the buffer
+        uint16_t preTriggerCount; // of sampleCount, how many are from before the trigger
+        uint8_t triggerLevel; // 8-bit, like samples
+        uint8_t triggerFlags;
+    } __attribute__((packed)) AdcCaptureSettings;
+
+    #define ADC_CAPTURE_IDLE 0
+    #define ADC_CAPTURE_WAITING 1 // for the trigger
+    #define ADC_CAPTURE_RUNNING 2
+    #define ADC_CAPTURE_DONE 3
+
+    typedef struct {
+        uint8_t state;
+        uint8_t sensorCount;
+        uint16_t sampleCount; // per sensor
+        uint16_t triggerPosition; // sample where the trigger was
+        uint16_t durationTicks; // from the trigger to the last sample
+    } __attribute__((packed)) AdcCaptureStatus;
+
+    // starts scanning all sensors continuously in the background, at default
+    // speed.
     void ADC_Init(void);
-    uint16_t ADC_Read(uint8_t channel);
+
+    // takes schedule in use from the next frame on.
+    void ADC_SetSchedule(const AdcSchedule* schedule);
+
+    // takes speed settings in use from the next frame on. returns false, and
+    // doesn't change anything, if prescaler is out of range.
+    bool ADC_SetSpeed(const AdcSpeedSettings* settings);
+
+    // phase locks scanning to USB frames: when needed, scanning pauses
+    // before a frame so that it completes offsetTicks after start of frame.
+    // other frames follow each other back to back as usual. 0 turns it off.
+    void ADC_SetFrameDeadline(uint16_t offsetTicks);
+
+    // call on every USB start of frame, with the time it happened.
+    void ADC_StartOfFrame(uint16_t ticks);
+
+    // copies latest complete frame of sensor values to sensorValues, if there
+    // is one that hasn't been read yet. returns false otherwise.
+    bool ADC_ReadFrame(uint16_t* sensorValues);
+
+    // telemetry ticks when the frame that ADC_ReadFrame() returned last was
+    // completed.
+    uint16_t ADC_GetReadFrameTimestamp(void);
+
+    // amount of frames scanned so far. wraps around. this is also the
+    // sequence number of the frame that is being scanned right now.
+    uint16_t ADC_GetFrameCount(void);
+
+    // returns false, and doesn't start, if settings are invalid.
+    bool ADC_StartCapture(const AdcCaptureSettings* settings);
+
+    // drops the samples and goes back to scanning frames. sensors that are
+    // only converted now and then read 0 until their turn, like after boot.
+    void ADC_StopCapture(void);
+
+    void ADC_GetCaptureStatus(AdcCaptureStatus* status);
+
+    // copies up to count samples from offset on, oldest first, samples of
+    // the sensors interleaved in their order in settings. returns how many
+    // were copied, which is 0 unless capture is done.
+    uint8_t ADC_ReadCapture(uint16_t offset, uint8_t* samples, uint8_t count);
+
+    // copies frame with given sequence number to frame, if it has been
+    // completed and hasn't been overwritten yet. returns false otherwise.
+    bool ADC_ReadBufferedFrame(uint16_t sequence, AdcFrame* frame);
 #endif
@@ -29,37 +29,201 @@
 
 #include "Config/DancePadConfig.h"
 #include "AnalogDancePad.h"
+#include "ADC.h"
 #include "Communication.h"
 #include "Descriptors.h"
 #include "Pad.h"
 #include "Reset.h"
 #include "ConfigStore.h"
+#include "Telemetry.h"
+#include "Calibration.h"
+#include "Characterization.h"
 
-/** Buffer to hold the previously generated HID report, for comparison purposes inside the HID class driver. */
-static uint8_t PrevHIDReportBuffer[GENERIC_EPSIZE];
+/** Buffers to hold the previously generated HID reports, for comparison purposes inside the HID class driver. */
+static uint8_t PrevGamepadHIDReportBuffer[sizeof (GamepadHIDReport)];
+static uint8_t PrevTelemetryHIDReportBuffer[sizeof (TelemetryHIDReportBuffer)];
 
 /** LUFA HID Class driver interface configuration and state information. This structure is
  *  passed to all HID Class driver functions, so that multiple instances of the same class
  *  within a device can be differentiated from one another.
  */
-USB_ClassInfo_HID_Device_t Generic_HID_Interface =
+// buttons for games. nothing else goes through this interface, so its
+// reports are never delayed by sensor data or configuration. with two
+// banks, a report can be written while the previous one still waits for
+// the host, so a change right before a poll isn't held back.
+USB_ClassInfo_HID_Device_t Gamepad_HID_Interface =
     {
         .Config =
             {
-                .InterfaceNumber              = INTERFACE_ID_GenericHID,
+                .InterfaceNumber              = INTERFACE_ID_Gamepad,
                 .ReportINEndpoint             =
                     {
-                        .Address              = GENERIC_IN_EPADDR,
-                        .Size                 = GENERIC_EPSIZE,
+                        .Address              = GAMEPAD_IN_EPADDR,
+                        .Size                 = GAMEPAD_EPSIZE,
+                        .Banks                = 2,
+                    },
+                .PrevReportINBuffer           = PrevGamepadHIDReportBuffer,
+                .PrevReportINBufferSize       = sizeof(PrevGamepadHIDReportBuffer),
+            },
+    };
+
+// sensor values and all feature and output reports, for the configuration tool.
+USB_ClassInfo_HID_Device_t Telemetry_HID_Interface =
+    {
+        .Config =
+            {
+                .InterfaceNumber              = INTERFACE_ID_Telemetry,
+                .ReportINEndpoint             =
+                    {
+                        .Address              = TELEMETRY_IN_EPADDR,
+                        .Size                 = TELEMETRY_EPSIZE,
                         .Banks                = 1,
                     },
-                .PrevReportINBuffer           = PrevHIDReportBuffer,
-                .PrevReportINBufferSize       = sizeof(PrevHIDReportBuffer),
+                .PrevReportINBuffer           = PrevTelemetryHIDReportBuffer,
+                .PrevReportINBufferSize       = sizeof(PrevTelemetryHIDReportBuffer),
             },
     };
 
 static Configuration configuration;
 
+// profile that is returned when host requests pad configuration report.
+static uint8_t configurationReportProfile = 0;
+
+// first sample that is returned when host requests capture samples report.
+static uint16_t captureSampleOffset = 0;
+
+// host polls the gamepad endpoint at about the same point of every USB
+// frame. scanning is timed so that a frame completes just before that, see
+// ADC_SetFrameDeadline(), and the report made from it is waiting in the
+// endpoint when the poll comes.
+static volatile uint16_t startOfFrameTicks;
+
+// when the frame PAD_STATE comes from was completed.
+static uint16_t padFrameTicks;
+
+// reports waiting in gamepad endpoint banks, oldest first: frame they were
+// made from, and the first button edge they carry to host, if any.
+typedef struct {
+    uint16_t frameTicks;
+    uint16_t edgeTicks;
+    bool hasEdge;
+} QueuedReport;
+
+static QueuedReport queuedReports[2];
+static uint8_t queuedReportCount = 0;
+
+// polls are noticed late when main loop is busy, never early, so the
+// earliest one is the best guess. it creeps later slowly in case polls
+// have moved. time from a completed frame to a report in the endpoint is
+// the other way around: the longest one is the guess, creeping shorter.
+#define POLL_PHASE_UNKNOWN UINT16_MAX
+static uint16_t pollPhase = POLL_PHASE_UNKNOWN;
+static uint16_t reportDelay = 0;
+
+// extra time left between a report getting to the endpoint and the poll.
+#define POLL_MARGIN_TICKS (20 * TELEMETRY_TICKS_PER_US)
+
+// configuration is stored straight from RAM in the background, see
+// ConfigStore_StoreConfiguration(). a change in the middle of it would leave
+// a mix of old and new in the slot, so storing starts over.
+static void ConfigurationChanged(void)
+{
+    if (ConfigStore_IsStoring()) {
+        ConfigStore_StoreConfiguration(&configuration);
+    }
+}
+
+static uint8_t GamepadBusyBanks(void)
+{
+    Endpoint_SelectEndpoint(GAMEPAD_IN_EPADDR);
+    return Endpoint_GetBusyBanks();
+}
+
+static void UpdateFrameDeadline(void)
+{
+    // pauses would count as slow conversions.
+    if (pollPhase == POLL_PHASE_UNKNOWN || CHARACTERIZATION_STATE.measuring) {
+        return;
+    }
+
+    // deadline is relative to start of frame, wrapping around to the
+    // previous USB frame if needed. 0 would turn the deadline off.
+    uint16_t deadline = pollPhase + 2 * ADC_USB_FRAME_TICKS - reportDelay - POLL_MARGIN_TICKS;
+    deadline %= ADC_USB_FRAME_TICKS;
+    ADC_SetFrameDeadline(deadline ? deadline : 1);
+}
+
+// notices reports that host has taken from the gamepad endpoint since the
+// previous call. polls themselves aren't seen: this is called from the main
+// loop next to HID_Device_USBTask(), and a bank that has emptied since
+// means that a poll happened at some point before. poll phase is inferred
+// from these, so it's when main loop got here, never earlier than the poll.
+static void TrackGamepadPolls(void)
+{
+    uint8_t busyBanks = GamepadBusyBanks();
+
+    if (busyBanks >= queuedReportCount) {
+        return;
+    }
+
+    uint16_t now = Telemetry_Now();
+    uint16_t phase;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        phase = now - startOfFrameTicks;
+    }
+
+    // oldest ones went first.
+    while (queuedReportCount > busyBanks) {
+        Telemetry_RecordSampleAge(now - queuedReports[0].frameTicks);
+
+        if (queuedReports[0].hasEdge) {
+            Telemetry_RecordPressLatency(now - queuedReports[0].edgeTicks);
+        }
+
+        queuedReports[0] = queuedReports[1];
+        queuedReportCount--;
+    }
+
+    if (phase >= ADC_USB_FRAME_TICKS) {
+        return;
+    }
+
+    if (phase < pollPhase) {
+        pollPhase = phase;
+    } else {
+        pollPhase++;
+    }
+
+    UpdateFrameDeadline();
+}
+
+// notices a report that LUFA just wrote to the gamepad endpoint from
+// CALLBACK_HID_Device_CreateHIDReport(). that happens at most once per USB
+// frame, when buttons have changed, so this is callback cadence too.
+static void TrackGamepadReports(void)
+{
+    uint8_t busyBanks = GamepadBusyBanks();
+
+    if (busyBanks <= queuedReportCount) {
+        return;
+    }
+
+    QueuedReport* report = &queuedReports[queuedReportCount++];
+    report->frameTicks = padFrameTicks;
+    report->hasEdge = Telemetry_TakeButtonEdge(&report->edgeTicks);
+
+    // delays from rare slow main loop rounds, like saving configuration to
+    // EEPROM, are not worth waiting for on every frame.
+    uint16_t delay = Telemetry_Now() - padFrameTicks;
+
+    if (delay > reportDelay && delay < ADC_USB_FRAME_TICKS / 2) {
+        reportDelay = delay;
+    } else if (reportDelay > 0) {
+        reportDelay--;
+    }
+}
+
 /** Main program entry point. This routine contains the overall program flow, including initial
  *  setup of all components and the main program loop.
  */
@@ -68,11 +232,46 @@ int main(void)
     SetupHardware();
     GlobalInterruptEnable();
     ConfigStore_LoadConfiguration(&configuration);
-    Pad_Initialize(&configuration.padConfiguration);
+    Pad_Initialize(configuration.profiles, configuration.activeProfile);
+    ADC_SetSpeed(&configuration.adcSpeed);
 
     for (;;)
     {
-        HID_Device_USBTask(&Generic_HID_Interface);
+        // process new sensor values whenever ADC has scanned a complete frame,
+        // independent of how often the host polls for reports.
+        uint16_t scanStartTicks = Telemetry_Now();
+        if (Pad_UpdateState()) {
+            Telemetry_RecordScanDuration(scanStartTicks);
+            padFrameTicks = ADC_GetReadFrameTimestamp();
+        }
+
+        // calibration adjusts thresholds of the active profile. only
+        // finished calibration is stored, drift is followed again on every boot.
+        uint8_t activeProfile = Pad_GetActiveProfile();
+        CalibrationResult calibrationResult = Calibration_Apply(&configuration.profiles[activeProfile]);
+
+        if (calibrationResult != CALIBRATION_UNCHANGED) {
+            Pad_SetThresholds(activeProfile, &configuration.profiles[activeProfile]);
+        }
+
+        if (calibrationResult == CALIBRATION_FINISHED) {
+            ConfigStore_StoreConfiguration(&configuration);
+        } else if (calibrationResult == CALIBRATION_DRIFTED) {
+            ConfigurationChanged();
+        }
+
+        // characterization scans with its own speed and schedule.
+        if (Characterization_Update()) {
+            ADC_SetSpeed(&configuration.adcSpeed);
+            Pad_UpdateConfiguration(activeProfile, &configuration.profiles[activeProfile]);
+            UpdateFrameDeadline();
+        }
+
+        // gamepad first, it has the report that someone is waiting for.
+        TrackGamepadPolls();
+        HID_Device_USBTask(&Gamepad_HID_Interface);
+        TrackGamepadReports();
+        HID_Device_USBTask(&Telemetry_HID_Interface);
         USB_USBTask();
     }
 }
@@ -101,25 +300,43 @@ void SetupHardware(void)
 
     /* Hardware Initialization */
     USB_Init();
+    Telemetry_Init();
 }
 
 /** Event handler for the library USB Configuration Changed event. */
 void EVENT_USB_Device_ConfigurationChanged(void)
 {
-    HID_Device_ConfigureEndpoints(&Generic_HID_Interface);
+    HID_Device_ConfigureEndpoints(&Gamepad_HID_Interface);
+    HID_Device_ConfigureEndpoints(&Telemetry_HID_Interface);
     USB_Device_EnableSOFEvents();
+
+    // endpoints start empty, and polls may come at a different point now.
+    queuedReportCount = 0;
+    pollPhase = POLL_PHASE_UNKNOWN;
+    ADC_SetFrameDeadline(0);
+
+    // whoever started a capture isn't going to stop it anymore.
+    ADC_StopCapture();
 }
 
 /** Event handler for the library USB Control Request reception event. */
 void EVENT_USB_Device_ControlRequest(void)
 {
-    HID_Device_ProcessControlRequest(&Generic_HID_Interface);
+    // each of these only handles requests to its own interface.
+    HID_Device_ProcessControlRequest(&Gamepad_HID_Interface);
+    HID_Device_ProcessControlRequest(&Telemetry_HID_Interface);
 }
 
 /** Event handler for the USB device Start Of Frame event. */
 void EVENT_USB_Device_StartOfFrame(void)
 {
-    HID_Device_MillisecondElapsed(&Generic_HID_Interface);
+    uint16_t now = Telemetry_Now();
+    startOfFrameTicks = now;
+    ADC_StartOfFrame(now);
+
+    HID_Device_MillisecondElapsed(&Gamepad_HID_Interface);
+    HID_Device_MillisecondElapsed(&Telemetry_HID_Interface);
+    Communication_MillisecondElapsed();
 }
 
 /** HID class driver callback function for the creation of HID reports to the host.
@@ -138,19 +355,74 @@ bool CALLBACK_HID_Device_CreateHIDReport(USB_ClassInfo_HID_Device_t* const HIDIn
                                          void* ReportData,
                                          uint16_t* const ReportSize)
 {
+    if (HIDInterfaceInfo == &Gamepad_HID_Interface) {
+        // LUFA only sends this when it differs from the previous one, ie.
+        // when buttons change. press latency is measured up to host taking
+        // it, see TrackGamepadPolls().
+        Telemetry_RecordReportCallback(Telemetry_Now());
+        Communication_WriteGamepadHIDReport(ReportData);
+        *ReportSize = sizeof (GamepadHIDReport);
+        return false;
+    }
+
     if (*ReportID == 0) {
         // no report id requested - write button and sensor data
-        Communication_WriteInputHIDReport(ReportData);
-        *ReportID = INPUT_REPORT_ID;
-        *ReportSize = sizeof (InputHIDReport);
+        if (!Communication_WriteInputHIDReport(ReportID, ReportData, ReportSize)) {
+            // nothing worth sending. make the report identical to the previous
+            // one, so LUFA's comparison against PrevHIDReportBuffer skips it.
+            memcpy(ReportData, PrevTelemetryHIDReportBuffer, *ReportSize);
+            return false;
+        }
     } else if (*ReportID == PAD_CONFIGURATION_REPORT_ID) {
         PadConfigurationFeatureHIDReport* configurationHidReport = ReportData;
-        configurationHidReport->configuration = PAD_CONF;
+        configurationHidReport->profileIndex = configurationReportProfile;
+        configurationHidReport->configuration = configuration.profiles[configurationReportProfile];
         *ReportSize = sizeof (PadConfigurationFeatureHIDReport);
+    } else if (*ReportID == PROFILES_REPORT_ID) {
+        ProfilesFeatureHIDReport* profilesHidReport = ReportData;
+        profilesHidReport->profileCount = PROFILE_COUNT;
+        profilesHidReport->activeProfile = Pad_GetActiveProfile();
+        profilesHidReport->configurationProfile = configurationReportProfile;
+        *ReportSize = sizeof (ProfilesFeatureHIDReport);
+    } else if (*ReportID == CALIBRATION_REPORT_ID) {
+        CalibrationFeatureHIDReport* calibrationHidReport = ReportData;
+        calibrationHidReport->trackDrift = CALIBRATION_STATE.trackDrift;
+        calibrationHidReport->calibrating = CALIBRATION_STATE.calibrating;
+        memcpy(calibrationHidReport->baselines, CALIBRATION_STATE.baselines, sizeof (calibrationHidReport->baselines));
+        memcpy(calibrationHidReport->noise, CALIBRATION_STATE.noise, sizeof (calibrationHidReport->noise));
+        *ReportSize = sizeof (CalibrationFeatureHIDReport);
     } else if (*ReportID == NAME_REPORT_ID) {
         NameFeatureHIDReport* nameHidReport = ReportData;
         memcpy(&nameHidReport->nameAndSize, &configuration.nameAndSize, sizeof (nameHidReport->nameAndSize));
         *ReportSize = sizeof (NameFeatureHIDReport);
+    } else if (*ReportID == TELEMETRY_REPORT_ID) {
+        TelemetryFeatureHIDReport* telemetryHidReport = ReportData;
+        Telemetry_ReadAndReset(&telemetryHidReport->telemetry);
+        *ReportSize = sizeof (TelemetryFeatureHIDReport);
+    } else if (*ReportID == REPORTING_CONFIGURATION_REPORT_ID) {
+        ReportingConfigurationFeatureHIDReport* reportingHidReport = ReportData;
+        reportingHidReport->configuration = REPORTING_CONF;
+        *ReportSize = sizeof (ReportingConfigurationFeatureHIDReport);
+    } else if (*ReportID == PROPERTIES_REPORT_ID) {
+        PropertiesFeatureHIDReport* propertiesHidReport = ReportData;
+        propertiesHidReport->buttonCount = BUTTON_COUNT;
+        propertiesHidReport->sensorCount = SENSOR_COUNT;
+        *ReportSize = sizeof (PropertiesFeatureHIDReport);
+    } else if (*ReportID == CAPTURE_SAMPLES_REPORT_ID) {
+        CaptureSamplesFeatureHIDReport* captureHidReport = ReportData;
+        ADC_GetCaptureStatus(&captureHidReport->status);
+        captureHidReport->offset = captureSampleOffset;
+        memset(captureHidReport->samples, 0, sizeof (captureHidReport->samples));
+        ADC_ReadCapture(captureSampleOffset, captureHidReport->samples, CAPTURE_PAGE_SIZE);
+        *ReportSize = sizeof (CaptureSamplesFeatureHIDReport);
+    } else if (*ReportID == ADC_SPEED_REPORT_ID) {
+        AdcSpeedFeatureHIDReport* speedHidReport = ReportData;
+        speedHidReport->settings = configuration.adcSpeed;
+        *ReportSize = sizeof (AdcSpeedFeatureHIDReport);
+    } else if (*ReportID == CHARACTERIZATION_REPORT_ID) {
+        CharacterizationFeatureHIDReport* characterizationHidReport = ReportData;
+        characterizationHidReport->state = CHARACTERIZATION_STATE;
+        *ReportSize = sizeof (CharacterizationFeatureHIDReport);
     }
     
     return true;
@@ -170,10 +442,42 @@ void CALLBACK_HID_Device_ProcessHIDReport(USB_ClassInfo_HID_Device_t* const HIDI
                                           const void* ReportData,
                                           const uint16_t ReportSize)
 {
+    // gamepad has no output or feature reports.
+    if (HIDInterfaceInfo != &Telemetry_HID_Interface) {
+        return;
+    }
+
     if (ReportID == PAD_CONFIGURATION_REPORT_ID && ReportSize == sizeof (PadConfigurationFeatureHIDReport)) {
         const PadConfigurationFeatureHIDReport* configurationHidReport = ReportData;
-        memcpy(&configuration.padConfiguration, &configurationHidReport->configuration, sizeof (configuration.padConfiguration));
-        Pad_UpdateConfiguration(&configurationHidReport->configuration);
+        uint8_t profile = configurationHidReport->profileIndex;
+
+        if (profile < PROFILE_COUNT) {
+            memcpy(&configuration.profiles[profile], &configurationHidReport->configuration, sizeof (PadConfiguration));
+            Pad_UpdateConfiguration(profile, &configurationHidReport->configuration);
+            ConfigurationChanged();
+        }
+    } else if (ReportID == SELECT_PROFILE_REPORT_ID && ReportSize == sizeof (SelectProfileHIDReport)) {
+        const SelectProfileHIDReport* selectHidReport = ReportData;
+        uint8_t profile = selectHidReport->profileIndex;
+
+        if (profile < PROFILE_COUNT) {
+            Pad_SelectProfile(profile, &configuration.profiles[profile]);
+        }
+
+        configuration.activeProfile = Pad_GetActiveProfile();
+        ConfigurationChanged();
+    } else if (ReportID == PROFILES_REPORT_ID && ReportSize == sizeof (ProfilesFeatureHIDReport)) {
+        const ProfilesFeatureHIDReport* profilesHidReport = ReportData;
+
+        if (profilesHidReport->configurationProfile < PROFILE_COUNT) {
+            configurationReportProfile = profilesHidReport->configurationProfile;
+        }
+    } else if (ReportID == CALIBRATE_REPORT_ID && ReportSize == sizeof (CalibrateHIDReport)) {
+        const CalibrateHIDReport* calibrateHidReport = ReportData;
+        Calibration_Start(calibrateHidReport->sensorBuffers);
+    } else if (ReportID == CALIBRATION_REPORT_ID && ReportSize == sizeof (CalibrationFeatureHIDReport)) {
+        const CalibrationFeatureHIDReport* calibrationHidReport = ReportData;
+        Calibration_SetDriftTracking(calibrationHidReport->trackDrift);
     } else if (ReportID == RESET_REPORT_ID) {
         Reset_JumpToBootloader();
     } else if (ReportID == SAVE_CONFIGURATION_REPORT_ID) {
@@ -181,5 +485,36 @@ void CALLBACK_HID_Device_ProcessHIDReport(USB_ClassInfo_HID_Device_t* const HIDI
     } else if (ReportID == NAME_REPORT_ID && ReportSize == sizeof (NameFeatureHIDReport)) {
         const NameFeatureHIDReport* nameHidReport = ReportData;
         memcpy(&configuration.nameAndSize, &nameHidReport->nameAndSize, sizeof (configuration.nameAndSize));
+        ConfigurationChanged();
+    } else if (ReportID == REPORTING_CONFIGURATION_REPORT_ID && ReportSize == sizeof (ReportingConfigurationFeatureHIDReport)) {
+        const ReportingConfigurationFeatureHIDReport* reportingHidReport = ReportData;
+        Communication_UpdateReportingConfiguration(&reportingHidReport->configuration);
+    } else if (ReportID == CAPTURE_REPORT_ID && ReportSize == sizeof (CaptureHIDReport)) {
+        const CaptureHIDReport* captureHidReport = ReportData;
+
+        if (captureHidReport->settings.sensorCount == 0) {
+            ADC_StopCapture();
+        } else {
+            ADC_StartCapture(&captureHidReport->settings);
+        }
+
+        captureSampleOffset = 0;
+    } else if (ReportID == CAPTURE_SAMPLES_REPORT_ID && ReportSize == sizeof (CaptureSamplesFeatureHIDReport)) {
+        const CaptureSamplesFeatureHIDReport* captureHidReport = ReportData;
+        captureSampleOffset = captureHidReport->offset;
+    } else if (ReportID == ADC_SPEED_REPORT_ID && ReportSize == sizeof (AdcSpeedFeatureHIDReport)) {
+        const AdcSpeedFeatureHIDReport* speedHidReport = ReportData;
+
+        // would change speed in the middle of characterization.
+        if (!CHARACTERIZATION_STATE.measuring && ADC_SetSpeed(&speedHidReport->settings)) {
+            configuration.adcSpeed = speedHidReport->settings;
+            ConfigurationChanged();
+        }
+    } else if (ReportID == CHARACTERIZE_REPORT_ID && ReportSize == sizeof (CharacterizeHIDReport)) {
+        const CharacterizeHIDReport* characterizeHidReport = ReportData;
+
+        if (Characterization_Start(&characterizeHidReport->settings)) {
+            ADC_SetFrameDeadline(0);
+        }
     }
 }
@@ -0,0 +1,174 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "Config/DancePadConfig.h"
+#include "Pad.h"
+#include "Calibration.h"
+#include "Linearization.h"
+
+#define MIN(a,b) ((a) < (b) ? a : b)
+#define MAX(a,b) ((a) > (b) ? a : b)
+
+#define MAX_SENSOR_VALUE 1023
+#define WINDOW_FRAMES (1 << CALIBRATION_WINDOW_SHIFT)
+
+CalibrationState CALIBRATION_STATE = {
+    .baselines = { [0 ... SENSOR_COUNT - 1] = 0 },
+    .noise = { [0 ... SENSOR_COUNT - 1] = 0 },
+    .calibrating = false,
+    .trackDrift = false
+};
+
+// sums of 256 10-bit values fit easily to 32 bits, so average is just a
+// shift in the end, no division needed.
+typedef struct {
+    uint32_t sums[SENSOR_COUNT];
+    uint16_t minimums[SENSOR_COUNT];
+    uint16_t maximums[SENSOR_COUNT];
+    SensorMask sensorsPressed; // sensors that have been over threshold during the window
+    uint16_t frameCount;
+} CalibrationWindow;
+
+static CalibrationWindow WINDOW = {
+    .minimums = { [0 ... SENSOR_COUNT - 1] = 0xFFFF }
+};
+
+static uint16_t SENSOR_BUFFERS[SENSOR_COUNT];
+
+// baselines that thresholds were last adjusted to. small drifts add up here
+// until they move the threshold by at least one unit.
+static uint16_t THRESHOLD_BASELINES[SENSOR_COUNT];
+
+static bool HAS_BASELINES = false;
+static bool WINDOW_FINISHED = false;
+
+// calibration window has finished, but thresholds haven't been set yet.
+static bool CALIBRATION_PENDING = false;
+
+static void Calibration_StartWindow(void) {
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        WINDOW.sums[i] = 0;
+        WINDOW.minimums[i] = 0xFFFF;
+        WINDOW.maximums[i] = 0;
+    }
+
+    WINDOW.sensorsPressed = 0;
+    WINDOW.frameCount = 0;
+}
+
+static void Calibration_FinishWindow(void) {
+    bool calibrating = CALIBRATION_STATE.calibrating;
+    SensorMask sensorBit = 1;
+
+    for (int i = 0; i < SENSOR_COUNT; i++, sensorBit <<= 1) {
+        uint16_t average = WINDOW.sums[i] >> CALIBRATION_WINDOW_SHIFT;
+        uint16_t noise = WINDOW.maximums[i] - WINDOW.minimums[i];
+        CALIBRATION_STATE.noise[i] = MIN(noise, 0xFF);
+
+        // pad is supposed to be idle while calibrating, so everything counts.
+        if (calibrating || !HAS_BASELINES) {
+            CALIBRATION_STATE.baselines[i] = average;
+            THRESHOLD_BASELINES[i] = average;
+            continue;
+        }
+
+        if (WINDOW.sensorsPressed & sensorBit) {
+            continue;
+        }
+
+        int16_t drift = (int16_t) average - (int16_t) CALIBRATION_STATE.baselines[i];
+        drift = MAX(MIN(drift, CALIBRATION_MAX_DRIFT_PER_WINDOW), -CALIBRATION_MAX_DRIFT_PER_WINDOW);
+        CALIBRATION_STATE.baselines[i] += drift;
+    }
+
+    HAS_BASELINES = true;
+    WINDOW_FINISHED = true;
+
+    if (calibrating) {
+        CALIBRATION_STATE.calibrating = false;
+        CALIBRATION_PENDING = true;
+    }
+}
+
+void Calibration_Start(const uint16_t* sensorBuffers) {
+    memcpy(SENSOR_BUFFERS, sensorBuffers, sizeof (SENSOR_BUFFERS));
+    CALIBRATION_STATE.calibrating = true;
+    Calibration_StartWindow();
+}
+
+void Calibration_SetDriftTracking(bool trackDrift) {
+    // only drift from now on counts.
+    memcpy(THRESHOLD_BASELINES, CALIBRATION_STATE.baselines, sizeof (THRESHOLD_BASELINES));
+    CALIBRATION_STATE.trackDrift = trackDrift;
+}
+
+void Calibration_Update(const uint16_t* sensorValues, SensorMask sensorsOverThreshold) {
+    WINDOW.sensorsPressed |= sensorsOverThreshold;
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        uint16_t value = sensorValues[i];
+        WINDOW.sums[i] += value;
+        WINDOW.minimums[i] = MIN(WINDOW.minimums[i], value);
+        WINDOW.maximums[i] = MAX(WINDOW.maximums[i], value);
+    }
+
+    if (++WINDOW.frameCount < WINDOW_FRAMES) {
+        return;
+    }
+
+    Calibration_FinishWindow();
+    Calibration_StartWindow();
+}
+
+static uint16_t Calibration_ClampThreshold(int32_t threshold) {
+    return MAX(MIN(threshold, MAX_SENSOR_VALUE), 0);
+}
+
+// baseline in the same units as thresholds of conf.
+static inline uint16_t Calibration_ThresholdUnits(const PadConfiguration* conf, uint16_t value) {
+    return (conf->flags & PAD_CONFIGURATION_LINEARIZED_THRESHOLDS) ? Linearization_Linearize(value) : value;
+}
+
+CalibrationResult Calibration_Apply(PadConfiguration* conf) {
+    if (!WINDOW_FINISHED) {
+        return CALIBRATION_UNCHANGED;
+    }
+
+    WINDOW_FINISHED = false;
+
+    if (CALIBRATION_PENDING) {
+        CALIBRATION_PENDING = false;
+
+        for (int i = 0; i < SENSOR_COUNT; i++) {
+            uint16_t baseline = Calibration_ThresholdUnits(conf, CALIBRATION_STATE.baselines[i]);
+            int32_t threshold = (int32_t) baseline + SENSOR_BUFFERS[i];
+            conf->sensorThresholds[i] = Calibration_ClampThreshold(threshold);
+        }
+
+        return CALIBRATION_FINISHED;
+    }
+
+    CalibrationResult result = CALIBRATION_UNCHANGED;
+
+    if (!CALIBRATION_STATE.trackDrift) {
+        return result;
+    }
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        uint16_t baseline = CALIBRATION_STATE.baselines[i];
+        int16_t drift = Calibration_ThresholdUnits(conf, baseline) - Calibration_ThresholdUnits(conf, THRESHOLD_BASELINES[i]);
+
+        if (drift == 0) {
+            continue;
+        }
+
+        // threshold keeps its distance to the baseline.
+        int32_t threshold = (int32_t) conf->sensorThresholds[i] + drift;
+        conf->sensorThresholds[i] = Calibration_ClampThreshold(threshold);
+        THRESHOLD_BASELINES[i] = baseline;
+        result = CALIBRATION_DRIFTED;
+    }
+
+    return result;
+}
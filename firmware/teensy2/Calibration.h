@@ -0,0 +1,51 @@
+#ifndef _CALIBRATION_H_
+#define _CALIBRATION_H_
+    #include <stdint.h>
+    #include <stdbool.h>
+    #include "Config/DancePadConfig.h"
+    #include "Pad.h"
+
+    // statistics of sensors are gathered over windows of 2^shift scanned
+    // frames, 256 frames being ~160 ms.
+    #define CALIBRATION_WINDOW_SHIFT 8
+
+    // when tracking drift, baseline of a sensor follows its idle value by at
+    // most this much per window. FSRs drift slowly, and this way a foot
+    // resting lightly on a panel can't drag the thresholds along.
+    #define CALIBRATION_MAX_DRIFT_PER_WINDOW 1
+
+    typedef struct {
+        // average value of every sensor while it's idle.
+        uint16_t baselines[SENSOR_COUNT];
+        // difference of the highest and lowest value during the latest
+        // window, capped to 255.
+        uint8_t noise[SENSOR_COUNT];
+        // waiting for a window to finish to calibrate thresholds.
+        bool calibrating;
+        // thresholds follow changes in baselines.
+        bool trackDrift;
+    } CalibrationState;
+
+    typedef enum {
+        CALIBRATION_UNCHANGED,
+        CALIBRATION_DRIFTED,
+        CALIBRATION_FINISHED
+    } CalibrationResult;
+
+    // starts a fresh window. when it has finished, threshold of every sensor
+    // is set to its baseline + buffer, both in the same units as thresholds
+    // of the profile. pad should be idle meanwhile.
+    void Calibration_Start(const uint16_t* sensorBuffers);
+
+    void Calibration_SetDriftTracking(bool trackDrift);
+
+    // called by Pad_UpdateState() for every scanned frame. sensors over
+    // threshold are being stepped on, and don't count as idle.
+    void Calibration_Update(const uint16_t* sensorValues, SensorMask sensorsOverThreshold);
+
+    // applies results of a finished window to thresholds of conf, which
+    // should be the active profile. called from the main loop.
+    CalibrationResult Calibration_Apply(PadConfiguration* conf);
+
+    extern CalibrationState CALIBRATION_STATE;
+#endif
@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "Config/DancePadConfig.h"
+#include "ADC.h"
+#include "Characterization.h"
+#include "Telemetry.h"
+
+#define MEASURED_FRAMES (1 << CHARACTERIZATION_FRAMES_SHIFT)
+
+CharacterizationState CHARACTERIZATION_STATE = {
+    .settings = ADC_DEFAULT_SPEED,
+    .measuring = false
+};
+
+// squares of 128 10-bit values still fit to 32 bits.
+static uint32_t sums[SENSOR_COUNT];
+static uint32_t squareSums[SENSOR_COUNT];
+static uint16_t measuredFrames;
+
+// frames are read from the buffer behind ADC, so they can be missed when
+// main loop is slow. only time between consecutive frames is counted.
+static uint16_t nextSequence;
+static uint16_t previousSequence;
+static uint16_t previousTimestamp;
+static uint16_t timedFrames;
+static uint32_t elapsedTicks;
+
+// fewer frames than measured ones are timed, so conversions per second can
+// be calculated in 32 bits without 64-bit division from libgcc.
+_Static_assert((uint64_t) MEASURED_FRAMES * SENSOR_COUNT * 1000000 * TELEMETRY_TICKS_PER_US <= UINT32_MAX,
+    "conversions per second doesn't fit to 32 bits");
+
+static void Characterization_Finish(void) {
+    uint32_t conversions = (uint32_t) timedFrames * SENSOR_COUNT;
+    CHARACTERIZATION_STATE.conversionsPerSecond = elapsedTicks == 0 ? 0
+        : conversions * (1000000UL * TELEMETRY_TICKS_PER_US) / elapsedTicks;
+
+    // variance is sum of squares / n - (sum / n)^2, here multiplied by 16 and
+    // n^2 first, so that everything is integers and divisions are shifts.
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        uint64_t spread = ((uint64_t) squareSums[i] << CHARACTERIZATION_FRAMES_SHIFT) - (uint64_t) sums[i] * sums[i];
+        uint64_t noise = spread >> (2 * CHARACTERIZATION_FRAMES_SHIFT - 4);
+        CHARACTERIZATION_STATE.noise[i] = noise > 0xFFFF ? 0xFFFF : noise;
+    }
+
+    CHARACTERIZATION_STATE.measuring = false;
+}
+
+bool Characterization_Start(const AdcSpeedSettings* settings) {
+    if (!ADC_SetSpeed(settings)) {
+        return false;
+    }
+
+    AdcSchedule schedule;
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        schedule.sensors[i] = i;
+    }
+
+    schedule.sensorCount = SENSOR_COUNT;
+    schedule.idleSensorCount = 0;
+    ADC_SetSchedule(&schedule);
+
+    memset(sums, 0, sizeof (sums));
+    memset(squareSums, 0, sizeof (squareSums));
+    measuredFrames = 0;
+    timedFrames = 0;
+    elapsedTicks = 0;
+
+    // frame that is being scanned right now is still the old kind.
+    nextSequence = ADC_GetFrameCount() + 1;
+
+    CHARACTERIZATION_STATE.settings = *settings;
+    CHARACTERIZATION_STATE.measuring = true;
+    return true;
+}
+
+bool Characterization_Update(void) {
+    if (!CHARACTERIZATION_STATE.measuring) {
+        return false;
+    }
+
+    AdcFrame frame;
+
+    while (measuredFrames < MEASURED_FRAMES) {
+        if (!ADC_ReadBufferedFrame(nextSequence, &frame)) {
+            // not scanned yet, or overwritten already.
+            if ((int16_t) (nextSequence - ADC_GetFrameCount()) >= 0) {
+                return false;
+            }
+
+            nextSequence++;
+            continue;
+        }
+
+        if (measuredFrames > 0 && nextSequence == (uint16_t) (previousSequence + 1)) {
+            elapsedTicks += (uint16_t) (frame.timestamp - previousTimestamp);
+            timedFrames++;
+        }
+
+        for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+            uint16_t value = frame.sensorValues[i];
+            sums[i] += value;
+            squareSums[i] += (uint32_t) value * value;
+        }
+
+        previousSequence = nextSequence++;
+        previousTimestamp = frame.timestamp;
+        measuredFrames++;
+    }
+
+    Characterization_Finish();
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef _CHARACTERIZATION_H_
+#define _CHARACTERIZATION_H_
+    #include <stdint.h>
+    #include <stdbool.h>
+    #include "Config/DancePadConfig.h"
+    #include "ADC.h"
+
+    // measures how fast sensors are scanned with given ADC speed settings, and
+    // how noisy they are then, so that the fastest settings that sensors of a
+    // pad can take can be found without reflashing. every sensor is converted
+    // in every frame while measuring. pad should be idle meanwhile, anything
+    // that moves a sensor counts as noise.
+
+    // 2^shift frames are measured, 128 frames being ~80 ms at default speed.
+    #define CHARACTERIZATION_FRAMES_SHIFT 7
+
+    typedef struct {
+        AdcSpeedSettings settings; // being measured, or measured last
+        bool measuring;
+        uint32_t conversionsPerSecond;
+        // variance of every sensor in 1/16ths of raw units squared, capped to
+        // 0xFFFF. 16 is a standard deviation of one unit.
+        uint16_t noise[SENSOR_COUNT];
+    } __attribute__((packed)) CharacterizationState;
+
+    // ADC runs with settings until measurement has finished. returns false,
+    // and doesn't start, if they are invalid.
+    bool Characterization_Start(const AdcSpeedSettings* settings);
+
+    // called from the main loop. returns true when measurement has just
+    // finished, and ADC should be put back to the speed and schedule of the pad.
+    bool Characterization_Update(void);
+
+    extern CharacterizationState CHARACTERIZATION_STATE;
+#endif
@@ -1,21 +1,348 @@
 #include <stdbool.h>
+#include <string.h>
+#include <util/atomic.h>
 
 #include "Config/DancePadConfig.h"
+#include "ADC.h"
 #include "Communication.h"
+#include "Descriptors.h"
 #include "Pad.h"
+#include "Linearization.h"
 
-void Communication_WriteInputHIDReport(InputHIDReport* report) {
-    // first, update pad state
-    Pad_UpdateState();
+ReportingConfiguration REPORTING_CONF = {
+    .inputReportMode = INPUT_REPORT_MODE_FULL,
+    .changeDriven = false,
+    .sensorChangeDelta = 0,
+    .idleKeepaliveMs = 0,
+    .linearizedSensorValues = false,
+    .reportIntervalMs = 0,
+    .peakSensorValues = false
+};
 
-    // write buttons to the report
-    for (int i = 0; i < BUTTON_COUNT; i++) {
-        // trol https://stackoverflow.com/a/47990
-        report->buttons[i / 8] ^= (-PAD_STATE.buttonsPressed[i] ^ report->buttons[i / 8]) & (1UL << i % 8);
+// what was in the last input report that was actually sent.
+static struct {
+    ButtonMask buttons;
+    uint16_t sensorValues[SENSOR_COUNT];
+    bool valid;
+} LAST_SENT;
+
+// sequence number of the first frame for next batched report.
+static uint16_t nextBatchSequence = 0;
+
+_Static_assert(sizeof (BatchedSensorsInputHIDReport) < TELEMETRY_EPSIZE || BATCHED_FRAME_COUNT == 1, "batched report doesn't fit to endpoint");
+_Static_assert(sizeof (ButtonEventsInputHIDReport) < TELEMETRY_EPSIZE || BUTTON_EVENTS_PER_REPORT == 4, "button events report doesn't fit to endpoint");
+_Static_assert(sizeof (TelemetryHIDReportBuffer) <= 255, "LUFA can't handle reports this big");
+_Static_assert(sizeof (GamepadHIDReport) <= GAMEPAD_EPSIZE, "gamepad report doesn't fit to endpoint");
+
+// incremented from SOF interrupt, saturates instead of wrapping.
+static volatile uint16_t msSinceLastSent = 0;
+
+void Communication_UpdateReportingConfiguration(const ReportingConfiguration* configuration) {
+    memcpy(&REPORTING_CONF, configuration, sizeof (ReportingConfiguration));
+
+    if (REPORTING_CONF.inputReportMode >= INPUT_REPORT_MODE_COUNT) {
+        REPORTING_CONF.inputReportMode = INPUT_REPORT_MODE_FULL;
+    }
+
+    // other modes would leave the queue full and the dropped count growing.
+    Pad_SetButtonEventsEnabled(REPORTING_CONF.inputReportMode == INPUT_REPORT_MODE_BUTTON_EVENTS);
+
+    // layout may have changed, make sure host gets a fresh report.
+    LAST_SENT.valid = false;
+}
+
+void Communication_MillisecondElapsed(void) {
+    if (msSinceLastSent != UINT16_MAX) {
+        msSinceLastSent++;
+    }
+}
+
+// values that reports are made of, before linearization.
+static inline const uint16_t* Communication_SensorValues(void) {
+    return REPORTING_CONF.peakSensorValues ? PAD_STATE.sensorMaxima : PAD_STATE.sensorValues;
+}
+
+static bool Communication_ShouldSend(void) {
+    if (!LAST_SENT.valid) {
+        return true;
+    }
+
+    uint16_t elapsed;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        elapsed = msSinceLastSent;
+    }
+
+    if (elapsed < REPORTING_CONF.reportIntervalMs) {
+        return false;
+    }
+
+    if (!REPORTING_CONF.changeDriven) {
+        return true;
+    }
+
+    if (PAD_STATE.buttonsPressed != LAST_SENT.buttons) {
+        return true;
+    }
+
+    if (REPORTING_CONF.inputReportMode == INPUT_REPORT_MODE_BUTTON_EVENTS && Pad_HasButtonEvents()) {
+        return true;
+    }
+
+    if (REPORTING_CONF.idleKeepaliveMs != 0) {
+        if (elapsed >= REPORTING_CONF.idleKeepaliveMs) {
+            return true;
+        }
+    }
+
+    if (REPORTING_CONF.inputReportMode == INPUT_REPORT_MODE_BUTTONS) {
+        return false;
+    }
+
+    const uint16_t* sensorValues = Communication_SensorValues();
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        uint16_t value = sensorValues[i];
+        uint16_t lastValue = LAST_SENT.sensorValues[i];
+        uint16_t change = value > lastValue ? value - lastValue : lastValue - value;
+
+        if (change > REPORTING_CONF.sensorChangeDelta) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// sensor values as they are reported to the host. returns values itself when
+// there is nothing to convert, otherwise converted values are written to buffer.
+static inline const uint16_t* Communication_ReportedSensorValues(const uint16_t* values, uint16_t* buffer) {
+    if (!REPORTING_CONF.linearizedSensorValues) {
+        return values;
+    }
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        buffer[i] = Linearization_Linearize(values[i]);
+    }
+
+    return buffer;
+}
+
+static inline void Communication_WriteButtons(uint8_t* buttons) {
+    // both AVR and report are little endian, so button mask can be copied as is.
+    memcpy(buttons, &PAD_STATE.buttonsPressed, CEILING(BUTTON_COUNT, 8));
+}
+
+static inline void Communication_PackSensorValues(uint8_t* packed, const uint16_t* values) {
+    // four 10-bit values to five bytes at a time. last group is padded with
+    // zeros if sensor count is not divisible by 4.
+    for (uint8_t i = 0; i < SENSOR_COUNT; i += 4, values += 4, packed += 5) {
+        uint16_t v0 = values[0];
+        uint16_t v1 = i + 1 < SENSOR_COUNT ? values[1] : 0;
+        uint16_t v2 = i + 2 < SENSOR_COUNT ? values[2] : 0;
+        uint16_t v3 = i + 3 < SENSOR_COUNT ? values[3] : 0;
+
+        packed[0] = v0;
+        packed[1] = (v0 >> 8) | (v1 << 2);
+        packed[2] = (v1 >> 6) | (v2 << 4);
+        packed[3] = (v2 >> 4) | (v3 << 6);
+        packed[4] = v3 >> 2;
+    }
+}
+
+// returns false if frame differs too much from previous one to be encoded.
+static inline bool Communication_EncodeDeltaFrame(BatchedSensorsDeltaFrame* deltaFrame, const AdcFrame* frame,
+                                                  uint16_t* previousValues, uint16_t* previousTimestamp) {
+    // time deltas are rounded, so compare against time host has reconstructed
+    // to keep rounding errors from adding up.
+    uint16_t timeDelta = (uint16_t) (frame->timestamp - *previousTimestamp + BATCHED_TIME_DELTA_TICKS / 2) / BATCHED_TIME_DELTA_TICKS;
+
+    if (timeDelta > UINT8_MAX) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        int16_t delta = frame->sensorValues[i] - previousValues[i];
+
+        if (delta < INT8_MIN || delta > INT8_MAX) {
+            return false;
+        }
+
+        deltaFrame->sensorDeltas[i] = delta;
+    }
+
+    deltaFrame->timeDelta = timeDelta;
+    *previousTimestamp += timeDelta * BATCHED_TIME_DELTA_TICKS;
+    memcpy(previousValues, frame->sensorValues, sizeof (frame->sensorValues));
+    return true;
+}
+
+static void Communication_WriteBatchedSensors(BatchedSensorsInputHIDReport* report) {
+    uint16_t sequence = nextBatchSequence;
+    AdcFrame frame;
+
+    report->frameCount = 0;
+
+    // skip frames that have been overwritten already.
+    while (!ADC_ReadBufferedFrame(sequence, &frame)) {
+        if (sequence == ADC_GetFrameCount()) {
+            report->sequence = sequence;
+            return;
+        }
+
+        sequence++;
     }
-   
-    // write sensor values to the report
-    for (int i = 0; i < SENSOR_COUNT; i++) {
-        report->sensorValues[i] = PAD_STATE.sensorValues[i];
+
+    uint16_t previousValues[SENSOR_COUNT];
+    uint16_t previousTimestamp = frame.timestamp;
+    uint8_t frameCount = 1;
+
+    report->sequence = sequence;
+    report->timestamp = frame.timestamp;
+    Communication_ReportedSensorValues(frame.sensorValues, frame.sensorValues);
+    Communication_PackSensorValues(report->sensorValues, frame.sensorValues);
+    memcpy(previousValues, frame.sensorValues, sizeof (previousValues));
+
+    while (frameCount < BATCHED_FRAME_COUNT && ADC_ReadBufferedFrame(sequence + frameCount, &frame)) {
+        Communication_ReportedSensorValues(frame.sensorValues, frame.sensorValues);
+
+        if (!Communication_EncodeDeltaFrame(&report->deltaFrames[frameCount - 1], &frame, previousValues, &previousTimestamp)) {
+            break;
+        }
+
+        frameCount++;
     }
-}
\ No newline at end of file
+
+    report->frameCount = frameCount;
+    nextBatchSequence = sequence + frameCount;
+}
+
+static void Communication_WriteButtonEvents(ButtonEventsInputHIDReport* report) {
+    uint8_t eventCount = 0;
+
+    while (eventCount < BUTTON_EVENTS_PER_REPORT && Pad_ReadButtonEvent(&report->events[eventCount])) {
+        eventCount++;
+    }
+
+    report->eventCount = eventCount;
+}
+
+bool Communication_WriteInputHIDReport(uint8_t* reportId, void* reportData, uint16_t* reportSize) {
+    // pad state is kept up to date by the main loop, so just copy it over.
+    bool send = Communication_ShouldSend();
+    uint16_t buffer[SENSOR_COUNT];
+    const uint16_t* sensorValues = Communication_SensorValues();
+
+    if (send) {
+        LAST_SENT.buttons = PAD_STATE.buttonsPressed;
+        memcpy(LAST_SENT.sensorValues, sensorValues, sizeof (LAST_SENT.sensorValues));
+        LAST_SENT.valid = true;
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            msSinceLastSent = 0;
+        }
+    }
+
+    switch (REPORTING_CONF.inputReportMode) {
+        case INPUT_REPORT_MODE_BUTTONS: {
+            ButtonsInputHIDReport* report = reportData;
+            Communication_WriteButtons(report->buttons);
+            *reportId = BUTTONS_INPUT_REPORT_ID;
+            *reportSize = sizeof (ButtonsInputHIDReport);
+            break;
+        }
+
+        case INPUT_REPORT_MODE_PACKED_SENSORS: {
+            PackedSensorsInputHIDReport* report = reportData;
+            Communication_WriteButtons(report->buttons);
+            sensorValues = Communication_ReportedSensorValues(sensorValues, buffer);
+            Communication_PackSensorValues(report->sensorValues, sensorValues);
+            *reportId = PACKED_SENSORS_INPUT_REPORT_ID;
+            *reportSize = sizeof (PackedSensorsInputHIDReport);
+            break;
+        }
+
+        case INPUT_REPORT_MODE_PEAK_SENSORS: {
+            PeakSensorsInputHIDReport* report = reportData;
+            Communication_WriteButtons(report->buttons);
+            sensorValues = Communication_ReportedSensorValues(PAD_STATE.sensorValues, buffer);
+            Communication_PackSensorValues(report->sensorValues, sensorValues);
+            sensorValues = Communication_ReportedSensorValues(PAD_STATE.sensorMaxima, buffer);
+            Communication_PackSensorValues(report->sensorMaxima, sensorValues);
+            sensorValues = Communication_ReportedSensorValues(PAD_STATE.sensorMinima, buffer);
+            Communication_PackSensorValues(report->sensorMinima, sensorValues);
+            *reportId = PEAK_SENSORS_INPUT_REPORT_ID;
+            *reportSize = sizeof (PeakSensorsInputHIDReport);
+            break;
+        }
+
+        case INPUT_REPORT_MODE_BUTTON_EVENTS: {
+            ButtonEventsInputHIDReport* report = reportData;
+            Communication_WriteButtons(report->buttons);
+            sensorValues = Communication_ReportedSensorValues(sensorValues, buffer);
+            Communication_PackSensorValues(report->sensorValues, sensorValues);
+            report->timestamp = Telemetry_Now();
+            report->droppedEvents = Pad_GetDroppedButtonEvents();
+            report->eventCount = 0;
+
+            if (send) {
+                // events are consumed, so only take them when report is sent.
+                Communication_WriteButtonEvents(report);
+            }
+
+            *reportId = BUTTON_EVENTS_INPUT_REPORT_ID;
+            *reportSize = sizeof (ButtonEventsInputHIDReport);
+            break;
+        }
+
+        case INPUT_REPORT_MODE_SCALED_SENSORS: {
+            ScaledSensorsInputHIDReport* report = reportData;
+            Communication_WriteButtons(report->buttons);
+            sensorValues = Communication_ReportedSensorValues(sensorValues, buffer);
+
+            for (int i = 0; i < SENSOR_COUNT; i++) {
+                report->sensorValues[i] = sensorValues[i] >> 2;
+            }
+
+            *reportId = SCALED_SENSORS_INPUT_REPORT_ID;
+            *reportSize = sizeof (ScaledSensorsInputHIDReport);
+            break;
+        }
+
+        case INPUT_REPORT_MODE_BATCHED_SENSORS: {
+            BatchedSensorsInputHIDReport* report = reportData;
+            Communication_WriteButtons(report->buttons);
+
+            if (send) {
+                // frames are consumed, so only take them when report is sent.
+                Communication_WriteBatchedSensors(report);
+            }
+
+            *reportId = BATCHED_SENSORS_INPUT_REPORT_ID;
+            *reportSize = sizeof (BatchedSensorsInputHIDReport);
+            break;
+        }
+
+        default: {
+            InputHIDReport* report = reportData;
+            Communication_WriteButtons(report->buttons);
+            sensorValues = Communication_ReportedSensorValues(sensorValues, buffer);
+            memcpy(report->sensorValues, sensorValues, sizeof (report->sensorValues));
+            *reportId = INPUT_REPORT_ID;
+            *reportSize = sizeof (InputHIDReport);
+            break;
+        }
+    }
+
+    // peaks of the next report start from here.
+    if (send) {
+        Pad_ResetPeaks();
+    }
+
+    return send;
+}
+
+void Communication_WriteGamepadHIDReport(GamepadHIDReport* report) {
+    Communication_WriteButtons(report->buttons);
+    report->unusedAxis = 0;
+}
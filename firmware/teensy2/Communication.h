@@ -2,10 +2,14 @@
 #define _COMMUNICATION_H_
 
     #include <stdint.h>
+    #include <stdbool.h>
     #include "Config/DancePadConfig.h"
     #include "Pad.h"
+    #include "ADC.h"
+    #include "Characterization.h"
     #include "Communication.h"
     #include "ConfigStore.h"
+    #include "Telemetry.h"
 
     // small helper macro to do x / y, but rounded up instead of floored.
     #define CEILING(x,y) (((x) + (y) - 1) / (y))
@@ -15,23 +19,277 @@
     // ie. from microcontroller to computer
     //
 
+    // the only report of the gamepad interface, sent whenever buttons
+    // change. axis is always 0, see Descriptors.c.
+    typedef struct {
+        uint8_t buttons[CEILING(BUTTON_COUNT, 8)];
+        uint8_t unusedAxis;
+    } __attribute__((packed)) GamepadHIDReport;
+
+    // rest of the input reports are for the telemetry interface.
+    // there are several layouts for input reports, see InputReportMode below.
+    // every layout has its own report ID.
+
     typedef struct {
         uint8_t buttons[CEILING(BUTTON_COUNT, 8)];
         uint16_t sensorValues[SENSOR_COUNT];
     } __attribute__((packed)) InputHIDReport;
 
+    typedef struct {
+        uint8_t buttons[CEILING(BUTTON_COUNT, 8)];
+    } __attribute__((packed)) ButtonsInputHIDReport;
+
+    // 10-bit sensor values packed to a little endian bit stream: every group
+    // of 4 sensors takes 5 bytes.
+    #define PACKED_SENSOR_BYTES (CEILING(SENSOR_COUNT, 4) * 5)
+
+    typedef struct {
+        uint8_t buttons[CEILING(BUTTON_COUNT, 8)];
+        uint8_t sensorValues[PACKED_SENSOR_BYTES];
+    } __attribute__((packed)) PackedSensorsInputHIDReport;
+
+    // current values, and the highest and lowest values since the previous
+    // report, so that host sees taps that come and go between reports. all
+    // of them are packed like above.
+    typedef struct {
+        uint8_t buttons[CEILING(BUTTON_COUNT, 8)];
+        uint8_t sensorValues[PACKED_SENSOR_BYTES];
+        uint8_t sensorMaxima[PACKED_SENSOR_BYTES];
+        uint8_t sensorMinima[PACKED_SENSOR_BYTES];
+    } __attribute__((packed)) PeakSensorsInputHIDReport;
+
+    // sensor values with two least significant bits dropped.
+    typedef struct {
+        uint8_t buttons[CEILING(BUTTON_COUNT, 8)];
+        uint8_t sensorValues[SENSOR_COUNT];
+    } __attribute__((packed)) ScaledSensorsInputHIDReport;
+
+    // several consecutive scanned frames in one report, so that host gets
+    // every frame even when scanning is faster than polling. first frame is
+    // sent as is, following ones as differences to the frame before them.
+    // report ends early if a difference doesn't fit, and frames that are too
+    // old to be buffered anymore are skipped; host can tell from sequence.
+    typedef struct {
+        uint8_t timeDelta; // in BATCHED_TIME_DELTA_TICKS units
+        int8_t sensorDeltas[SENSOR_COUNT];
+    } __attribute__((packed)) BatchedSensorsDeltaFrame;
+
+    #define BATCHED_TIME_DELTA_TICKS 16
+
+    // report, including report ID, has to fit to one 64 byte packet. with
+    // too many sensors for that, report only has the first frame and takes
+    // two packets.
+    #define BATCHED_HEADER_SIZE (CEILING(BUTTON_COUNT, 8) + 5 + PACKED_SENSOR_BYTES)
+
+    #if BATCHED_HEADER_SIZE < 63
+        #define BATCHED_FRAME_COUNT (1 + (63 - BATCHED_HEADER_SIZE) / sizeof (BatchedSensorsDeltaFrame))
+    #else
+        #define BATCHED_FRAME_COUNT 1
+    #endif
+
+    typedef struct {
+        uint8_t buttons[CEILING(BUTTON_COUNT, 8)];
+        uint8_t frameCount; // 0 if no new frames were scanned since previous report
+        uint16_t sequence; // of the first frame, see ADC_GetFrameCount()
+        uint16_t timestamp; // of the first frame, in telemetry ticks
+        uint8_t sensorValues[PACKED_SENSOR_BYTES]; // first frame, packed like above
+        BatchedSensorsDeltaFrame deltaFrames[BATCHED_FRAME_COUNT - 1];
+    } __attribute__((packed)) BatchedSensorsInputHIDReport;
+
+    // packed sensor values like above, and button presses and releases since
+    // the previous report with the time they were scanned. events that don't
+    // fit wait in the queue for the next report, see Pad_ReadButtonEvent().
+    // host gets the age of an event by comparing it to timestamp.
+    #define BUTTON_EVENTS_HEADER_SIZE (CEILING(BUTTON_COUNT, 8) + PACKED_SENSOR_BYTES + 4)
+
+    // like batched report, fits to one packet unless there are too many sensors.
+    #if BUTTON_EVENTS_HEADER_SIZE + 4 * 3 <= 63
+        #define BUTTON_EVENTS_PER_REPORT ((63 - BUTTON_EVENTS_HEADER_SIZE) / sizeof (ButtonEvent))
+    #else
+        #define BUTTON_EVENTS_PER_REPORT 4
+    #endif
+
+    typedef struct {
+        uint8_t buttons[CEILING(BUTTON_COUNT, 8)];
+        uint8_t sensorValues[PACKED_SENSOR_BYTES];
+        uint16_t timestamp; // when report was written, in telemetry ticks
+        uint8_t droppedEvents; // see Pad_GetDroppedButtonEvents()
+        uint8_t eventCount;
+        ButtonEvent events[BUTTON_EVENTS_PER_REPORT];
+    } __attribute__((packed)) ButtonEventsInputHIDReport;
+
+    //
+    // OUTPUT REPORTS
+    // ie. from computer to microcontroller
+    //
+
+    // switches to another profile. takes effect on the next scan.
+    typedef struct {
+        uint8_t profileIndex;
+    } __attribute__((packed)) SelectProfileHIDReport;
+
+    // calibrates thresholds of the active profile to baseline + buffer.
+    // buffers are in the same units as thresholds of the profile: raw sensor
+    // units, or linearized ones if it has PAD_CONFIGURATION_LINEARIZED_THRESHOLDS,
+    // in which case baselines are linearized before buffers are added. pad
+    // should be left idle until it's done, see CalibrationFeatureHIDReport.
+    typedef struct {
+        uint16_t sensorBuffers[SENSOR_COUNT];
+    } __attribute__((packed)) CalibrateHIDReport;
+
+    // starts a high speed capture, see ADC_StartCapture(). sensor count of 0
+    // stops capture instead, which has to be done to get pad working again
+    // once samples have been read.
+    typedef struct {
+        AdcCaptureSettings settings;
+    } __attribute__((packed)) CaptureHIDReport;
+
+    // measures given ADC speed settings, see Characterization.h. pad keeps
+    // working meanwhile, but should be left idle. results are read with
+    // CharacterizationFeatureHIDReport.
+    typedef struct {
+        AdcSpeedSettings settings;
+    } __attribute__((packed)) CharacterizeHIDReport;
+
     //
     // FEATURE REPORTS
     // ie. can be requested by computer and written by computer
     //
 
+    // configuration of one profile. which profile is returned when host
+    // requests this report is chosen with ProfilesFeatureHIDReport.
     typedef struct {
+        uint8_t profileIndex;
         PadConfiguration configuration;
     } __attribute__((packed)) PadConfigurationFeatureHIDReport;
 
+    typedef struct {
+        uint8_t profileCount; // read only
+        uint8_t activeProfile; // read only, use SelectProfileHIDReport to change
+        uint8_t configurationProfile; // profile that PadConfigurationFeatureHIDReport returns
+    } __attribute__((packed)) ProfilesFeatureHIDReport;
+
     typedef struct {
         NameAndSize nameAndSize;
     } __attribute__((packed)) NameFeatureHIDReport;
 
-    void Communication_WriteInputHIDReport(InputHIDReport* report);
+    // like ReportingConfiguration, drift tracking is not stored.
+    typedef struct {
+        bool trackDrift;
+        bool calibrating; // read only
+        uint16_t baselines[SENSOR_COUNT]; // read only, always raw sensor units
+        uint8_t noise[SENSOR_COUNT]; // read only
+    } __attribute__((packed)) CalibrationFeatureHIDReport;
+
+    // samples of a capture are read a page at a time: host writes the offset
+    // of the first sample it wants, and reading returns the page from there.
+    // samples are only there once status says capture is done.
+    #define CAPTURE_PAGE_SIZE 64
+
+    typedef struct {
+        AdcCaptureStatus status; // read only
+        uint16_t offset;
+        uint8_t samples[CAPTURE_PAGE_SIZE]; // read only
+    } __attribute__((packed)) CaptureSamplesFeatureHIDReport;
+
+    // speed that ADC scans sensors at. stored with the rest of configuration.
+    // writes are ignored while characterization is measuring.
+    typedef struct {
+        AdcSpeedSettings settings;
+    } __attribute__((packed)) AdcSpeedFeatureHIDReport;
+
+    // read only.
+    typedef struct {
+        CharacterizationState state;
+    } __attribute__((packed)) CharacterizationFeatureHIDReport;
+
+    // which input report is sent to the host.
+    #define INPUT_REPORT_MODE_FULL 0
+    #define INPUT_REPORT_MODE_BUTTONS 1
+    #define INPUT_REPORT_MODE_PACKED_SENSORS 2
+    #define INPUT_REPORT_MODE_SCALED_SENSORS 3
+    #define INPUT_REPORT_MODE_BATCHED_SENSORS 4
+    #define INPUT_REPORT_MODE_PEAK_SENSORS 5
+    #define INPUT_REPORT_MODE_BUTTON_EVENTS 6
+    #define INPUT_REPORT_MODE_COUNT 7
+
+    // how the device reports to the host. unlike PadConfiguration, this is
+    // not stored, so that whoever connects gets the default behaviour.
+    //
+    // when changeDriven is set, input report is only sent when a button
+    // changes, when a sensor has moved more than sensorChangeDelta since the
+    // last sent report, or when nothing has been sent for idleKeepaliveMs
+    // (0 = never). with button events reports, queued events are a change
+    // too. otherwise a report is sent on every poll.
+    //
+    // when linearizedSensorValues is set, sensor values are reported
+    // linearized, see Linearization.h. sensorChangeDelta is still in raw units.
+    //
+    // input reports are sent at most every reportIntervalMs (0 = every
+    // poll). games read buttons from the gamepad interface, which isn't
+    // affected by any of this.
+    //
+    // when peakSensorValues is set, full, packed, scaled and button events reports have the
+    // highest value of every sensor since the previous report instead of the
+    // current one. sensorChangeDelta is compared against those then.
+    typedef struct {
+        uint8_t inputReportMode;
+        bool changeDriven;
+        uint8_t sensorChangeDelta;
+        uint16_t idleKeepaliveMs;
+        bool linearizedSensorValues;
+        uint8_t reportIntervalMs;
+        bool peakSensorValues;
+    } __attribute__((packed)) ReportingConfiguration;
+
+    typedef struct {
+        ReportingConfiguration configuration;
+    } __attribute__((packed)) ReportingConfigurationFeatureHIDReport;
+
+    typedef struct {
+        TelemetryData telemetry;
+    } __attribute__((packed)) TelemetryFeatureHIDReport;
+
+    // what the device has, read only. sensor count depends on how many
+    // external muxes firmware was built for, see DancePadConfig.h.
+    typedef struct {
+        uint8_t buttonCount;
+        uint8_t sensorCount;
+    } __attribute__((packed)) PropertiesFeatureHIDReport;
+
+    // every report that the telemetry interface sends, input or feature.
+    // LUFA builds them in a buffer as big as this, which is bigger than an
+    // endpoint when there are many sensors.
+    typedef union {
+        InputHIDReport input;
+        PackedSensorsInputHIDReport packedSensorsInput;
+        PeakSensorsInputHIDReport peakSensorsInput;
+        ScaledSensorsInputHIDReport scaledSensorsInput;
+        BatchedSensorsInputHIDReport batchedSensorsInput;
+        ButtonEventsInputHIDReport buttonEventsInput;
+        PadConfigurationFeatureHIDReport padConfiguration;
+        ProfilesFeatureHIDReport profiles;
+        NameFeatureHIDReport name;
+        CalibrationFeatureHIDReport calibration;
+        ReportingConfigurationFeatureHIDReport reportingConfiguration;
+        TelemetryFeatureHIDReport telemetry;
+        PropertiesFeatureHIDReport properties;
+        CaptureSamplesFeatureHIDReport captureSamples;
+        AdcSpeedFeatureHIDReport adcSpeed;
+        CharacterizationFeatureHIDReport characterization;
+    } TelemetryHIDReportBuffer;
+
+    extern ReportingConfiguration REPORTING_CONF;
+
+    void Communication_UpdateReportingConfiguration(const ReportingConfiguration* configuration);
+
+    void Communication_WriteGamepadHIDReport(GamepadHIDReport* report);
+
+    // writes input report in the currently selected layout. report ID and size
+    // are written to reportId and reportSize. returns false if the report
+    // doesn't need to be sent, see ReportingConfiguration.
+    bool Communication_WriteInputHIDReport(uint8_t* reportId, void* reportData, uint16_t* reportSize);
+
+    // call every millisecond, drives idle keepalive.
+    void Communication_MillisecondElapsed(void);
 #endif
@@ -2,12 +2,73 @@
 #define _DANCE_PAD_CONFIG_H_
     // this value doesn't mean we're actively using all these buttons.
     // it's just what we report and is technically possible to use.
-    // for now, should be divisible by 8.
+    // for now, should be divisible by 8. at most 32.
     #define BUTTON_COUNT 16
 
+    // sensors can be read through external analog multiplexers, like CD4067
+    // (16 inputs) or CD4051 (8 inputs). output of mux n is connected to where
+    // sensor n would be without muxes, see ADC.c, and select lines of all
+    // muxes are shared and connected to ADC_MUX_SELECT_PORT, starting from
+    // bit ADC_MUX_SELECT_SHIFT. sensor n is then input n % ADC_MUX_CHANNELS
+    // of mux n / ADC_MUX_CHANNELS. 0 = sensors are connected directly.
+    #ifndef ADC_MUX_COUNT
+        #define ADC_MUX_COUNT 0
+    #endif
+
+    // inputs per mux, a power of two.
+    #ifndef ADC_MUX_CHANNELS
+        #define ADC_MUX_CHANNELS 16
+    #endif
+
+    #define ADC_MUX_SELECT_PORT PORTB
+    #define ADC_MUX_SELECT_DDR DDRB
+    #define ADC_MUX_SELECT_SHIFT 0
+
+    // how long output of each mux takes to settle after select lines change,
+    // in microseconds, one value per mux. depends on the resistors used in
+    // the setup: high impedance sensors take longer. changing select lines
+    // mostly overlaps with conversions, see ADC.c, so this is rarely waited,
+    // and when it is, a timer interrupt starts the conversion afterwards.
+    #ifndef ADC_MUX_SETTLE_US
+        #if ADC_MUX_COUNT > 1
+            #define ADC_MUX_SETTLE_US { 10, 10 }
+        #else
+            #define ADC_MUX_SETTLE_US { 10 }
+        #endif
+    #endif
+
     // this value doesn't mean we're reading all these sensors.
-    // teensy 2.0 has 12 analog sensors, so that's what we use.
-    #define SENSOR_COUNT 12
+    // teensy 2.0 has 12 analog sensors, so that's what we use without muxes.
+    // every sensor takes ~70 bytes of RAM in scanning, filtering, calibration
+    // and reports, so at most 16 fit to the 2.5 KB of ATmega32U4, eg. one
+    // 16 input mux or two 8 input ones. host/makefile checks the budget.
+    #if ADC_MUX_COUNT > 0
+        #define SENSOR_COUNT (ADC_MUX_COUNT * ADC_MUX_CHANNELS)
+    #else
+        #define SENSOR_COUNT 12
+    #endif
+
+    #if SENSOR_COUNT > 16
+        #error "more than 16 sensors don't fit to RAM"
+    #endif
+
+    // how many pad configurations device holds at once. each one takes 5
+    // bytes per sensor of RAM, and all of them are stored to EEPROM, where
+    // at least two copies of the whole configuration have to fit, see
+    // ConfigStore.c.
+    #if SENSOR_COUNT > 12
+        #define PROFILE_COUNT 2
+    #else
+        #define PROFILE_COUNT 4
+    #endif
+
+    // curve that turns raw sensor values to linearized ones, see
+    // Linearization.h. x is the raw value divided by
+    // LINEARIZATION_MAX_SENSOR_VALUE, and the result should grow from 0 to 1
+    // as x goes from 0 to 1. raw values above the maximum are treated as it.
+    // it's evaluated when compiling, so floating point is fine here.
+    #define LINEARIZATION_MAX_SENSOR_VALUE 850 // depends on the resistors used in the setup
+    #define LINEARIZATION_CURVE(x) (0.9 * (x) * (x) * (x) * (x) + 0.1 * (x))
 
     // don't actually use ACD values that are read.
     #define ADC_TEST_MODE 0
@@ -1,55 +1,211 @@
 #include <string.h>
+#include <stddef.h>
 #include <stdint.h>
-#include <util/atomic.h>
+#include <stdbool.h>
+#include <util/crc16.h>
 #include <avr/eeprom.h>
+#include <avr/interrupt.h>
 
 #include "Config/DancePadConfig.h"
 #include "Pad.h"
 #include "ConfigStore.h"
 
-// just some random bytes to figure out what we have in eeprom
-// change these to reset configuration!
-static const uint8_t magicBytes[5] = {9, 74, 9, 48, 99};
+// configuration is stored to a ring of slots. every store goes to the slot
+// after the newest one, so that
+// - writes are spread over the whole EEPROM instead of wearing out the same bytes.
+// - newest complete configuration is never overwritten. if power is cut
+//   while storing, CRC of the slot being written doesn't match and the
+//   previous one is loaded instead.
+//
+// bump this whenever Configuration changes to reset stored configurations!
+#define CONFIG_STORE_VERSION 4
 
-// where magic bytes (which indicate that a pad configuration is, in fact, stored) exist
-#define MAGIC_BYTES_ADDRESS ((void *) 0x00)
+typedef struct {
+    uint8_t version;
+    uint16_t sequence; // incremented on every store, wraps around
+    Configuration configuration;
+    uint16_t crc; // of everything above. written last, so it's only valid when the whole slot is
+} __attribute__((packed)) ConfigSlot;
 
-// where actual configration is stored
-#define CONFIGURATION_ADDRESS ((void *) (MAGIC_BYTES_ADDRESS + sizeof (magicBytes)))
+#define SLOT_COUNT ((E2END + 1) / sizeof (ConfigSlot))
+#define SLOT_ADDRESS(slot) ((uint16_t) ((slot) * sizeof (ConfigSlot)))
+
+// with one slot, every store would overwrite the only complete configuration.
+_Static_assert(SLOT_COUNT >= 2, "two configurations don't fit to EEPROM, lower PROFILE_COUNT");
 
 #define DEFAULT_NAME "Untitled Pad Device"
 
 static const Configuration DEFAULT_CONFIGURATION = {
-    .padConfiguration = {
+    .profiles = { [0 ... PROFILE_COUNT - 1] = {
         .sensorThresholds = { [0 ... SENSOR_COUNT - 1] = 400 },
-        .releaseMultiplier = 0.9,
-        .sensorToButtonMapping = { [0 ... SENSOR_COUNT - 1] = 1 }
-    },
+        .sensorReleaseThresholds = { [0 ... SENSOR_COUNT - 1] = SENSOR_RELEASE_THRESHOLD(0.9) },
+        .sensorToButtonMapping = { [0 ... SENSOR_COUNT - 1] = 1 },
+        .sensorFilters = { [0 ... SENSOR_COUNT - 1] = SENSOR_FILTER(1, false, 0) },
+        .flags = 0
+    } },
+    .activeProfile = 0,
     .nameAndSize = {
         .size = sizeof(DEFAULT_NAME) - 1, // we don't care about the null at the end.
         .name = DEFAULT_NAME
-    }
+    },
+    .adcSpeed = ADC_DEFAULT_SPEED
 };
 
+// slot that has the newest valid configuration, and its sequence number.
+static uint8_t newestSlot = SLOT_COUNT - 1;
+static uint16_t newestSequence = 0;
+
+// slot that is being written in background by EE_READY interrupt, straight
+// from the configuration that was given, so there's no copy of it in RAM.
+// CRC is calculated from the bytes as they go by. these are only touched by
+// the interrupt while writing is true and EERIE is set.
+static const Configuration* pendingConfiguration;
+static uint8_t pendingSlotIndex;
+static uint16_t pendingSequence;
+static uint16_t pendingByte;
+static uint16_t pendingCrc;
+static volatile bool writing = false;
+
+// unchanged bytes are only compared, but that takes a while for a whole
+// slot. interrupt returns after this many, and fires again right away
+// unless something more important is waiting.
+#define BYTES_PER_INTERRUPT 16
+
+// what goes to byte i of the pending slot. CRC is complete by the time it's
+// reached.
+static inline uint8_t ConfigStore_PendingByte(uint16_t i) {
+    if (i == offsetof(ConfigSlot, version)) {
+        return CONFIG_STORE_VERSION;
+    } else if (i < offsetof(ConfigSlot, configuration)) {
+        return pendingSequence >> (8 * (i - offsetof(ConfigSlot, sequence)));
+    } else if (i < offsetof(ConfigSlot, crc)) {
+        return ((const uint8_t*) pendingConfiguration)[i - offsetof(ConfigSlot, configuration)];
+    } else {
+        return pendingCrc >> (8 * (i - offsetof(ConfigSlot, crc)));
+    }
+}
+
+// reads slot in pieces, so it doesn't have to fit to RAM.
+static bool ConfigStore_IsValidSlot(uint8_t slot, uint16_t* sequence) {
+    uint8_t bytes[16];
+    uint16_t crc = 0xFFFF;
+    uint16_t address = SLOT_ADDRESS(slot);
+
+    eeprom_read_block(bytes, (const void*) (uintptr_t) address, offsetof(ConfigSlot, configuration));
+
+    if (bytes[offsetof(ConfigSlot, version)] != CONFIG_STORE_VERSION) {
+        return false;
+    }
+
+    memcpy(sequence, &bytes[offsetof(ConfigSlot, sequence)], sizeof (uint16_t));
+
+    for (uint16_t i = 0; i < offsetof(ConfigSlot, crc); i += sizeof (bytes)) {
+        uint16_t count = offsetof(ConfigSlot, crc) - i;
+        count = count < sizeof (bytes) ? count : sizeof (bytes);
+        eeprom_read_block(bytes, (const void*) (uintptr_t) (address + i), count);
+
+        for (uint16_t j = 0; j < count; j++) {
+            crc = _crc16_update(crc, bytes[j]);
+        }
+    }
+
+    uint16_t storedCrc;
+    eeprom_read_block(&storedCrc, (const void*) (uintptr_t) (address + offsetof(ConfigSlot, crc)), sizeof (storedCrc));
+    return storedCrc == crc;
+}
+
 void ConfigStore_LoadConfiguration(Configuration* conf) {
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        // see if we have magic bytes stored
-        uint8_t magicByteBuffer[sizeof (magicBytes)];
-        eeprom_read_block(magicByteBuffer, MAGIC_BYTES_ADDRESS, sizeof (magicBytes));
-
-        if (memcmp(magicByteBuffer, magicBytes, sizeof (magicBytes)) == 0) {
-            // we had magic bytes, let's load the configuration!
-            eeprom_read_block(conf, CONFIGURATION_ADDRESS, sizeof (Configuration));
-        } else {
-            // we had some garbage on magic byte address, let's just use the default configuration
-            memcpy(conf, &DEFAULT_CONFIGURATION, sizeof (Configuration));
+    bool found = false;
+
+    writing = false;
+    EECR &= ~(1 << EERIE);
+
+    for (uint8_t i = 0; i < SLOT_COUNT; i++) {
+        uint16_t sequence;
+
+        if (!ConfigStore_IsValidSlot(i, &sequence)) {
+            continue;
+        }
+
+        // sequence numbers wrap around, so compare the difference.
+        if (!found || (int16_t) (sequence - newestSequence) > 0) {
+            found = true;
+            newestSlot = i;
+            newestSequence = sequence;
         }
     }
+
+    if (found) {
+        uint16_t address = SLOT_ADDRESS(newestSlot) + offsetof(ConfigSlot, configuration);
+        eeprom_read_block(conf, (const void*) (uintptr_t) address, sizeof (Configuration));
+    } else {
+        // nothing stored yet, or it was stored by an incompatible version.
+        newestSlot = SLOT_COUNT - 1;
+        newestSequence = 0;
+        memcpy(conf, &DEFAULT_CONFIGURATION, sizeof (Configuration));
+    }
 }
 
 void ConfigStore_StoreConfiguration(const Configuration* conf) {
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        eeprom_update_block(conf, CONFIGURATION_ADDRESS, sizeof (Configuration));
-        eeprom_update_block(magicBytes, MAGIC_BYTES_ADDRESS, sizeof (magicBytes));
+    // interrupt is held off only while state is reset, other interrupts go on.
+    EECR &= ~(1 << EERIE);
+
+    // if previous store hasn't finished, its slot is still incomplete and
+    // can be reused. newest complete one stays untouched either way. bytes
+    // that were written already match, so starting over costs little.
+    if (!writing) {
+        pendingSlotIndex = (newestSlot + 1) % SLOT_COUNT;
+        pendingSequence = newestSequence + 1;
     }
+
+    pendingConfiguration = conf;
+    pendingByte = 0;
+    pendingCrc = 0xFFFF;
+    writing = true;
+
+    // interrupt fires whenever EEPROM is ready for the next byte.
+    EECR |= (1 << EERIE);
+}
+
+bool ConfigStore_IsStoring(void) {
+    return writing;
+}
+
+// writes one changed byte of the pending slot per interrupt. a byte takes
+// ~3.4 ms to write, and scanning and USB go on in the meantime.
+ISR(EE_READY_vect) {
+    uint16_t i = pendingByte;
+    uint16_t end = i + BYTES_PER_INTERRUPT;
+
+    for (; i < sizeof (ConfigSlot) && i < end; i++) {
+        uint8_t byte = ConfigStore_PendingByte(i);
+
+        if (i < offsetof(ConfigSlot, crc)) {
+            pendingCrc = _crc16_update(pendingCrc, byte);
+        }
+
+        EEAR = SLOT_ADDRESS(pendingSlotIndex) + i;
+        EECR |= (1 << EERE);
+
+        // skipping unchanged bytes saves both time and wear.
+        if (EEDR != byte) {
+            EEDR = byte;
+            EECR |= (1 << EEMPE);
+            EECR |= (1 << EEPE);
+            pendingByte = i + 1;
+            return;
+        }
+    }
+
+    pendingByte = i;
+
+    if (i < sizeof (ConfigSlot)) {
+        return;
+    }
+
+    // all bytes are written, including CRC, so this is the newest slot now.
+    EECR &= ~(1 << EERIE);
+    newestSlot = pendingSlotIndex;
+    newestSequence = pendingSequence;
+    writing = false;
 }
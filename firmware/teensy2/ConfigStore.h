@@ -1,6 +1,8 @@
 #ifndef _CONFIGSTORE_H_
 #define _CONFIGSTORE_H_
+    #include <stdbool.h>
     #include "Pad.h"
+    #include "ADC.h"
 
     #define MAX_NAME_SIZE 50
 
@@ -10,10 +12,21 @@
     } __attribute__((packed)) NameAndSize; 
 
     typedef struct {
-        PadConfiguration padConfiguration;
+        PadConfiguration profiles[PROFILE_COUNT];
+        uint8_t activeProfile;
         NameAndSize nameAndSize;
+        AdcSpeedSettings adcSpeed;
     } __attribute__((packed)) Configuration;
 
+    // loads newest stored configuration, or default one if there is none.
     void ConfigStore_LoadConfiguration(Configuration* conf);
+
+    // starts storing configuration in the background. conf is read while
+    // storing, so it has to stay around until ConfigStore_IsStoring() is
+    // false. if it changes meanwhile, call this again: storing starts over,
+    // and only the latest contents are stored. stored slot is consistent
+    // either way, as its CRC is of the bytes that were written.
     void ConfigStore_StoreConfiguration(const Configuration* conf);
+
+    bool ConfigStore_IsStoring(void);
 #endif
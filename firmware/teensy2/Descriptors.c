@@ -34,20 +34,83 @@
  *  more details on HID report descriptors.
  */
 
-const USB_Descriptor_HIDReport_Datatype_t PROGMEM GenericReport[] =
+// buttons are in the beginning of every input report, regardless of layout.
+#define BUTTON_INPUT_ITEMS \
+    HID_RI_USAGE_PAGE(8, 0x09), \
+    HID_RI_USAGE_MINIMUM(8, 0x01), \
+    HID_RI_USAGE_MAXIMUM(8, BUTTON_COUNT), \
+    HID_RI_LOGICAL_MINIMUM(8, 0x00), \
+    HID_RI_LOGICAL_MAXIMUM(8, 0x01), \
+    HID_RI_REPORT_SIZE(8, 0x01), \
+    HID_RI_REPORT_COUNT(8, BUTTON_COUNT), \
+    HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+// unused bits in the end of PackedSensorsInputHIDReport
+#define PACKED_SENSOR_PADDING_BITS (PACKED_SENSOR_BYTES * 8 - SENSOR_COUNT * 10)
+
+#if PACKED_SENSOR_PADDING_BITS > 0
+    #define PACKED_SENSOR_PADDING_ITEMS \
+        HID_RI_REPORT_SIZE(8, PACKED_SENSOR_PADDING_BITS), \
+        HID_RI_REPORT_COUNT(8, 1), \
+        HID_RI_INPUT(8, HID_IOF_CONSTANT),
+#else
+    #define PACKED_SENSOR_PADDING_ITEMS
+#endif
+
+// 10-bit value for every sensor, see PackedSensorsInputHIDReport.
+#define PACKED_SENSOR_INPUT_ITEMS \
+    HID_RI_USAGE_PAGE(16, 0xFF00), /* vendor usage page */ \
+    HID_RI_USAGE(8, 0x01), \
+    HID_RI_COLLECTION(8, 0x00), \
+        HID_RI_USAGE(8, 0x01), \
+        HID_RI_LOGICAL_MINIMUM(8, 0x00), \
+        HID_RI_LOGICAL_MAXIMUM(16, 0x03FF), \
+        HID_RI_REPORT_SIZE(8, 10), \
+        HID_RI_REPORT_COUNT(8, SENSOR_COUNT), \
+        HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE), \
+        PACKED_SENSOR_PADDING_ITEMS \
+    HID_RI_END_COLLECTION(0)
+
+// unused bits after buttons in GamepadHIDReport
+#define GAMEPAD_BUTTON_PADDING_BITS (CEILING(BUTTON_COUNT, 8) * 8 - BUTTON_COUNT)
+
+// what games see. only has the one input report, without a report ID, so
+// that it's as small as it gets and nothing else ever queues in front of it.
+const USB_Descriptor_HIDReport_Datatype_t PROGMEM GamepadReport[] =
 {
     HID_RI_USAGE_PAGE(8, 0x01),
-    HID_RI_USAGE(8, 0x04),
+    HID_RI_USAGE(8, 0x05), // gamepad
     HID_RI_COLLECTION(8, 0x01),
-        HID_RI_REPORT_ID(8, INPUT_REPORT_ID),
-        HID_RI_USAGE_PAGE(8, 0x09),
-        HID_RI_USAGE_MINIMUM(8, 0x01),
-        HID_RI_USAGE_MAXIMUM(8, BUTTON_COUNT),
-        HID_RI_LOGICAL_MINIMUM(8, 0x00),
-        HID_RI_LOGICAL_MAXIMUM(8, 0x01),
-        HID_RI_REPORT_SIZE(8, 0x01),
-        HID_RI_REPORT_COUNT(8, BUTTON_COUNT),
+        BUTTON_INPUT_ITEMS,
+        #if GAMEPAD_BUTTON_PADDING_BITS > 0
+            HID_RI_REPORT_SIZE(8, GAMEPAD_BUTTON_PADDING_BITS),
+            HID_RI_REPORT_COUNT(8, 1),
+            HID_RI_INPUT(8, HID_IOF_CONSTANT),
+        #endif
+
+        // unused axis. we only report this because stepmania uses old
+        // joystick interface on linux if device doesn't have any analog axis.
+        HID_RI_USAGE_PAGE(8, 0x01),
+        HID_RI_USAGE(8, 0x30), // X axis
+        HID_RI_LOGICAL_MINIMUM(16, 0),
+        HID_RI_LOGICAL_MAXIMUM(16, 127),
+        HID_RI_PHYSICAL_MINIMUM(16, 0),
+        HID_RI_PHYSICAL_MAXIMUM(16, 127),
+        HID_RI_REPORT_COUNT(8, 1),
+        HID_RI_REPORT_SIZE(8, 8),
         HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+    HID_RI_END_COLLECTION(0)
+};
+
+// everything else: sensor values and configuration. vendor defined, so that
+// games don't mistake this for another controller.
+const USB_Descriptor_HIDReport_Datatype_t PROGMEM TelemetryReport[] =
+{
+    HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+    HID_RI_USAGE(8, 0x01),
+    HID_RI_COLLECTION(8, 0x01),
+        HID_RI_REPORT_ID(8, INPUT_REPORT_ID),
+        BUTTON_INPUT_ITEMS,
         // TODO: padding here if BUTTON_COUNT not divisible by 8
         HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
         HID_RI_USAGE(8, 0x01),
@@ -60,6 +123,64 @@ const USB_Descriptor_HIDReport_Datatype_t PROGMEM GenericReport[] =
             HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
         HID_RI_END_COLLECTION(0),
 
+        HID_RI_REPORT_ID(8, BUTTONS_INPUT_REPORT_ID),
+        BUTTON_INPUT_ITEMS,
+
+        HID_RI_REPORT_ID(8, PACKED_SENSORS_INPUT_REPORT_ID),
+        BUTTON_INPUT_ITEMS,
+        PACKED_SENSOR_INPUT_ITEMS,
+
+        // current values, maxima and minima.
+        HID_RI_REPORT_ID(8, PEAK_SENSORS_INPUT_REPORT_ID),
+        BUTTON_INPUT_ITEMS,
+        PACKED_SENSOR_INPUT_ITEMS,
+        PACKED_SENSOR_INPUT_ITEMS,
+        PACKED_SENSOR_INPUT_ITEMS,
+
+        HID_RI_REPORT_ID(8, SCALED_SENSORS_INPUT_REPORT_ID),
+        BUTTON_INPUT_ITEMS,
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x01),
+        HID_RI_COLLECTION(8, 0x00),
+            HID_RI_USAGE(8, 0x01),
+            HID_RI_LOGICAL_MINIMUM(8, 0x00),
+            HID_RI_LOGICAL_MAXIMUM(16, 0x00FF),
+            HID_RI_REPORT_SIZE(8, 0x08),
+            HID_RI_REPORT_COUNT(8, SENSOR_COUNT),
+            HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+        HID_RI_END_COLLECTION(0),
+
+        // frames in batched report are delta encoded, so they are just
+        // opaque bytes as far as HID is concerned.
+        HID_RI_REPORT_ID(8, BATCHED_SENSORS_INPUT_REPORT_ID),
+        BUTTON_INPUT_ITEMS,
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x01),
+        HID_RI_COLLECTION(8, 0x00),
+            HID_RI_USAGE(8, 0x03),
+            HID_RI_LOGICAL_MINIMUM(8, 0x00),
+            HID_RI_LOGICAL_MAXIMUM(16, 0x00FF),
+            HID_RI_REPORT_SIZE(8, 0x08),
+            HID_RI_REPORT_COUNT(8, sizeof (BatchedSensorsInputHIDReport) - CEILING(BUTTON_COUNT, 8)),
+            HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+        HID_RI_END_COLLECTION(0),
+
+        // timestamp, counts and events after sensor values are opaque bytes
+        // too, see ButtonEventsInputHIDReport.
+        HID_RI_REPORT_ID(8, BUTTON_EVENTS_INPUT_REPORT_ID),
+        BUTTON_INPUT_ITEMS,
+        PACKED_SENSOR_INPUT_ITEMS,
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x01),
+        HID_RI_COLLECTION(8, 0x00),
+            HID_RI_USAGE(8, 0x04),
+            HID_RI_LOGICAL_MINIMUM(8, 0x00),
+            HID_RI_LOGICAL_MAXIMUM(16, 0x00FF),
+            HID_RI_REPORT_SIZE(8, 0x08),
+            HID_RI_REPORT_COUNT(8, sizeof (ButtonEventsInputHIDReport) - CEILING(BUTTON_COUNT, 8) - PACKED_SENSOR_BYTES),
+            HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+        HID_RI_END_COLLECTION(0),
+
         HID_RI_REPORT_ID(8, PAD_CONFIGURATION_REPORT_ID),
         HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
         HID_RI_USAGE(8, 0x02),
@@ -95,22 +216,137 @@ const USB_Descriptor_HIDReport_Datatype_t PROGMEM GenericReport[] =
             HID_RI_REPORT_COUNT(8, sizeof (NameFeatureHIDReport)),
             HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE | HID_IOF_NON_VOLATILE),
         HID_RI_END_COLLECTION(0),
-        
-        // unused joystick report. we only report this because stepmania uses
-        // old joystick interface on linux if device doesn't have any analog
-        // axis.
-        HID_RI_REPORT_ID(8, UNUSED_ANALOG_JOYSTICK_REPORT_ID),
-        HID_RI_USAGE_PAGE(8, 0x01),
-        HID_RI_USAGE(8, 0x04),
+
+        HID_RI_REPORT_ID(8, TELEMETRY_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x03),
         HID_RI_COLLECTION(8, 0x00),
-            HID_RI_USAGE(8, 0x30), // X axis
-            HID_RI_LOGICAL_MINIMUM(16, 0),
-            HID_RI_LOGICAL_MAXIMUM(16, 127),
-            HID_RI_PHYSICAL_MINIMUM(16, 0),
-            HID_RI_PHYSICAL_MAXIMUM(16, 127),
-            HID_RI_REPORT_COUNT(8, 1),
-            HID_RI_REPORT_SIZE(8, 8),
-            HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+            HID_RI_USAGE(8, 0x03),
+            HID_RI_LOGICAL_MINIMUM(8, 0x00),
+            HID_RI_LOGICAL_MAXIMUM(8, 0xFF),
+            HID_RI_REPORT_SIZE(8, 0x08),
+            HID_RI_REPORT_COUNT(8, sizeof (TelemetryFeatureHIDReport)),
+            HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+        HID_RI_END_COLLECTION(0),
+
+        HID_RI_REPORT_ID(8, REPORTING_CONFIGURATION_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x02),
+        HID_RI_COLLECTION(8, 0x00),
+            HID_RI_USAGE(8, 0x02),
+            HID_RI_LOGICAL_MINIMUM(8, 0x00),
+            HID_RI_LOGICAL_MAXIMUM(8, 0xFF),
+            HID_RI_REPORT_SIZE(8, 0x08),
+            HID_RI_REPORT_COUNT(8, sizeof (ReportingConfigurationFeatureHIDReport)),
+            HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+        HID_RI_END_COLLECTION(0),
+
+        HID_RI_REPORT_ID(8, SELECT_PROFILE_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x02),
+        HID_RI_LOGICAL_MINIMUM(8, 0x00),
+        HID_RI_LOGICAL_MAXIMUM(8, PROFILE_COUNT - 1),
+        HID_RI_REPORT_SIZE(8, 0x08),
+        HID_RI_REPORT_COUNT(8, sizeof (SelectProfileHIDReport)),
+        HID_RI_OUTPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+
+        HID_RI_REPORT_ID(8, PROFILES_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x02),
+        HID_RI_COLLECTION(8, 0x00),
+            HID_RI_USAGE(8, 0x02),
+            HID_RI_LOGICAL_MINIMUM(8, 0x00),
+            HID_RI_LOGICAL_MAXIMUM(8, 0xFF),
+            HID_RI_REPORT_SIZE(8, 0x08),
+            HID_RI_REPORT_COUNT(8, sizeof (ProfilesFeatureHIDReport)),
+            HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+        HID_RI_END_COLLECTION(0),
+
+        HID_RI_REPORT_ID(8, CALIBRATE_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x02),
+        HID_RI_LOGICAL_MINIMUM(8, 0x00),
+        HID_RI_LOGICAL_MAXIMUM(8, 0xFF),
+        HID_RI_REPORT_SIZE(8, 0x08),
+        HID_RI_REPORT_COUNT(8, sizeof (CalibrateHIDReport)),
+        HID_RI_OUTPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+
+        HID_RI_REPORT_ID(8, CALIBRATION_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x02),
+        HID_RI_COLLECTION(8, 0x00),
+            HID_RI_USAGE(8, 0x02),
+            HID_RI_LOGICAL_MINIMUM(8, 0x00),
+            HID_RI_LOGICAL_MAXIMUM(8, 0xFF),
+            HID_RI_REPORT_SIZE(8, 0x08),
+            HID_RI_REPORT_COUNT(8, sizeof (CalibrationFeatureHIDReport)),
+            HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+        HID_RI_END_COLLECTION(0),
+
+        HID_RI_REPORT_ID(8, PROPERTIES_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x02),
+        HID_RI_COLLECTION(8, 0x00),
+            HID_RI_USAGE(8, 0x02),
+            HID_RI_LOGICAL_MINIMUM(8, 0x00),
+            HID_RI_LOGICAL_MAXIMUM(8, 0xFF),
+            HID_RI_REPORT_SIZE(8, 0x08),
+            HID_RI_REPORT_COUNT(8, sizeof (PropertiesFeatureHIDReport)),
+            HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+        HID_RI_END_COLLECTION(0),
+
+        HID_RI_REPORT_ID(8, CAPTURE_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x02),
+        HID_RI_LOGICAL_MINIMUM(8, 0x00),
+        HID_RI_LOGICAL_MAXIMUM(8, 0xFF),
+        HID_RI_REPORT_SIZE(8, 0x08),
+        HID_RI_REPORT_COUNT(8, sizeof (CaptureHIDReport)),
+        HID_RI_OUTPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+
+        HID_RI_REPORT_ID(8, CAPTURE_SAMPLES_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x02),
+        HID_RI_COLLECTION(8, 0x00),
+            HID_RI_USAGE(8, 0x02),
+            HID_RI_LOGICAL_MINIMUM(8, 0x00),
+            HID_RI_LOGICAL_MAXIMUM(8, 0xFF),
+            HID_RI_REPORT_SIZE(8, 0x08),
+            HID_RI_REPORT_COUNT(8, sizeof (CaptureSamplesFeatureHIDReport)),
+            HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+        HID_RI_END_COLLECTION(0),
+
+        HID_RI_REPORT_ID(8, ADC_SPEED_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x02),
+        HID_RI_COLLECTION(8, 0x00),
+            HID_RI_USAGE(8, 0x02),
+            HID_RI_LOGICAL_MINIMUM(8, 0x00),
+            HID_RI_LOGICAL_MAXIMUM(8, 0xFF),
+            HID_RI_REPORT_SIZE(8, 0x08),
+            HID_RI_REPORT_COUNT(8, sizeof (AdcSpeedFeatureHIDReport)),
+            HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+        HID_RI_END_COLLECTION(0),
+
+        HID_RI_REPORT_ID(8, CHARACTERIZE_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x02),
+        HID_RI_LOGICAL_MINIMUM(8, 0x00),
+        HID_RI_LOGICAL_MAXIMUM(8, 0xFF),
+        HID_RI_REPORT_SIZE(8, 0x08),
+        HID_RI_REPORT_COUNT(8, sizeof (CharacterizeHIDReport)),
+        HID_RI_OUTPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+
+        HID_RI_REPORT_ID(8, CHARACTERIZATION_REPORT_ID),
+        HID_RI_USAGE_PAGE(16, 0xFF00), // vendor usage page
+        HID_RI_USAGE(8, 0x02),
+        HID_RI_COLLECTION(8, 0x00),
+            HID_RI_USAGE(8, 0x02),
+            HID_RI_LOGICAL_MINIMUM(8, 0x00),
+            HID_RI_LOGICAL_MAXIMUM(8, 0xFF),
+            HID_RI_REPORT_SIZE(8, 0x08),
+            HID_RI_REPORT_COUNT(8, sizeof (CharacterizationFeatureHIDReport)),
+            HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
         HID_RI_END_COLLECTION(0),
     HID_RI_END_COLLECTION(0)
 };
@@ -133,7 +369,7 @@ const USB_Descriptor_Device_t PROGMEM DeviceDescriptor =
 
     .VendorID               = 0x03EB,
     .ProductID              = 0x204F,
-    .ReleaseNumber          = VERSION_BCD(0,0,1),
+    .ReleaseNumber          = VERSION_BCD(0,0,2), // 0.0.2 and up are composite, see INTERFACE_ID_Telemetry
 
     .ManufacturerStrIndex   = STRING_ID_Manufacturer,
     .ProductStrIndex        = STRING_ID_Product,
@@ -154,7 +390,7 @@ const USB_Descriptor_Configuration_t PROGMEM ConfigurationDescriptor =
             .Header                 = {.Size = sizeof(USB_Descriptor_Configuration_Header_t), .Type = DTYPE_Configuration},
 
             .TotalConfigurationSize = sizeof(USB_Descriptor_Configuration_t),
-            .TotalInterfaces        = 1,
+            .TotalInterfaces        = 2,
 
             .ConfigurationNumber    = 1,
             .ConfigurationStrIndex  = NO_DESCRIPTOR,
@@ -164,11 +400,50 @@ const USB_Descriptor_Configuration_t PROGMEM ConfigurationDescriptor =
             .MaxPowerConsumption    = USB_CONFIG_POWER_MA(100)
         },
 
-    .HID_Interface =
+    .HID_GamepadInterface =
+        {
+            .Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},
+
+            .InterfaceNumber        = INTERFACE_ID_Gamepad,
+            .AlternateSetting       = 0x00,
+
+            .TotalEndpoints         = 1,
+
+            .Class                  = HID_CSCP_HIDClass,
+            .SubClass               = HID_CSCP_NonBootSubclass,
+            .Protocol               = HID_CSCP_NonBootProtocol,
+
+            .InterfaceStrIndex      = NO_DESCRIPTOR
+        },
+
+    .HID_GamepadHID =
+        {
+            .Header                 = {.Size = sizeof(USB_HID_Descriptor_HID_t), .Type = HID_DTYPE_HID},
+
+            .HIDSpec                = VERSION_BCD(1,1,1),
+            .CountryCode            = 0x00,
+            .TotalReportDescriptors = 1,
+            .HIDReportType          = HID_DTYPE_Report,
+            .HIDReportLength        = sizeof(GamepadReport)
+        },
+
+    // polled every millisecond, ie. at 1000 Hz. games read buttons only
+    // from here, so this interval is what their input latency depends on.
+    .HID_GamepadReportINEndpoint =
+        {
+            .Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
+
+            .EndpointAddress        = GAMEPAD_IN_EPADDR,
+            .Attributes             = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
+            .EndpointSize           = GAMEPAD_EPSIZE,
+            .PollingIntervalMS      = 0x01
+        },
+
+    .HID_TelemetryInterface =
         {
             .Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},
 
-            .InterfaceNumber        = INTERFACE_ID_GenericHID,
+            .InterfaceNumber        = INTERFACE_ID_Telemetry,
             .AlternateSetting       = 0x00,
 
             .TotalEndpoints         = 1,
@@ -180,7 +455,7 @@ const USB_Descriptor_Configuration_t PROGMEM ConfigurationDescriptor =
             .InterfaceStrIndex      = NO_DESCRIPTOR
         },
 
-    .HID_GenericHID =
+    .HID_TelemetryHID =
         {
             .Header                 = {.Size = sizeof(USB_HID_Descriptor_HID_t), .Type = HID_DTYPE_HID},
 
@@ -188,17 +463,19 @@ const USB_Descriptor_Configuration_t PROGMEM ConfigurationDescriptor =
             .CountryCode            = 0x00,
             .TotalReportDescriptors = 1,
             .HIDReportType          = HID_DTYPE_Report,
-            .HIDReportLength        = sizeof(GenericReport)
+            .HIDReportLength        = sizeof(TelemetryReport)
         },
 
-    .HID_ReportINEndpoint =
+    // polled every millisecond as well, ReportingConfiguration decides how
+    // often there is something to send.
+    .HID_TelemetryReportINEndpoint =
         {
             .Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
 
-            .EndpointAddress        = GENERIC_IN_EPADDR,
+            .EndpointAddress        = TELEMETRY_IN_EPADDR,
             .Attributes             = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
-            .EndpointSize           = GENERIC_EPSIZE,
-            .PollingIntervalMS      = 0x01 // = 1000ms, important!
+            .EndpointSize           = TELEMETRY_EPSIZE,
+            .PollingIntervalMS      = 0x01
         },
 };
 
@@ -264,13 +541,25 @@ uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
             }
 
             break;
+        // HID class descriptors are requested per interface, wIndex is the interface number.
         case HID_DTYPE_HID:
-            Address = &ConfigurationDescriptor.HID_GenericHID;
+            if (wIndex == INTERFACE_ID_Gamepad) {
+                Address = &ConfigurationDescriptor.HID_GamepadHID;
+            } else {
+                Address = &ConfigurationDescriptor.HID_TelemetryHID;
+            }
+
             Size    = sizeof(USB_HID_Descriptor_HID_t);
             break;
         case HID_DTYPE_Report:
-            Address = &GenericReport;
-            Size    = sizeof(GenericReport);
+            if (wIndex == INTERFACE_ID_Gamepad) {
+                Address = &GamepadReport;
+                Size    = sizeof(GamepadReport);
+            } else {
+                Address = &TelemetryReport;
+                Size    = sizeof(TelemetryReport);
+            }
+
             break;
     }
 
@@ -41,10 +41,15 @@
         {
             USB_Descriptor_Configuration_Header_t Config;
 
-            // Generic HID Interface
-            USB_Descriptor_Interface_t            HID_Interface;
-            USB_HID_Descriptor_HID_t              HID_GenericHID;
-            USB_Descriptor_Endpoint_t             HID_ReportINEndpoint;
+            // Gamepad HID Interface
+            USB_Descriptor_Interface_t            HID_GamepadInterface;
+            USB_HID_Descriptor_HID_t              HID_GamepadHID;
+            USB_Descriptor_Endpoint_t             HID_GamepadReportINEndpoint;
+
+            // Telemetry HID Interface
+            USB_Descriptor_Interface_t            HID_TelemetryInterface;
+            USB_HID_Descriptor_HID_t              HID_TelemetryHID;
+            USB_Descriptor_Endpoint_t             HID_TelemetryReportINEndpoint;
         } USB_Descriptor_Configuration_t;
 
         /** Enum for the device interface descriptor IDs within the device. Each interface descriptor
@@ -53,7 +58,8 @@
          */
         enum InterfaceDescriptors_t
         {
-            INTERFACE_ID_GenericHID = 0, /**< GenericHID interface descriptor ID */
+            INTERFACE_ID_Gamepad   = 0, /**< Gamepad interface descriptor ID, buttons only */
+            INTERFACE_ID_Telemetry = 1, /**< Telemetry interface descriptor ID, sensors and all the other reports */
         };
 
         /** Enum for the device string descriptor IDs within the device. Each string descriptor should
@@ -73,14 +79,38 @@
         #define RESET_REPORT_ID 0x03
         #define SAVE_CONFIGURATION_REPORT_ID 0x04
         #define NAME_REPORT_ID 0x05
-        #define UNUSED_ANALOG_JOYSTICK_REPORT_ID 0x06
+        #define UNUSED_ANALOG_JOYSTICK_REPORT_ID 0x06 // not used since gamepad got its own interface
+        #define TELEMETRY_REPORT_ID 0x07
+        #define REPORTING_CONFIGURATION_REPORT_ID 0x08
+        #define BUTTONS_INPUT_REPORT_ID 0x09
+        #define PACKED_SENSORS_INPUT_REPORT_ID 0x0A
+        #define SCALED_SENSORS_INPUT_REPORT_ID 0x0B
+        #define BATCHED_SENSORS_INPUT_REPORT_ID 0x0C
+        #define SELECT_PROFILE_REPORT_ID 0x0D
+        #define PROFILES_REPORT_ID 0x0E
+        #define CALIBRATE_REPORT_ID 0x0F
+        #define CALIBRATION_REPORT_ID 0x10
+        #define PROPERTIES_REPORT_ID 0x11
+        #define PEAK_SENSORS_INPUT_REPORT_ID 0x12
+        #define BUTTON_EVENTS_INPUT_REPORT_ID 0x13
+        #define CAPTURE_REPORT_ID 0x14
+        #define CAPTURE_SAMPLES_REPORT_ID 0x15
+        #define ADC_SPEED_REPORT_ID 0x16
+        #define CHARACTERIZE_REPORT_ID 0x17
+        #define CHARACTERIZATION_REPORT_ID 0x18
 
     /* Macros: */
-        /** Endpoint address of the Generic HID reporting IN endpoint. */
-        #define GENERIC_IN_EPADDR         (ENDPOINT_DIR_IN | 1)
+        /** Endpoint address of the Gamepad HID reporting IN endpoint. */
+        #define GAMEPAD_IN_EPADDR         (ENDPOINT_DIR_IN | 1)
 
-        // Size in bytes of the Generic HID reporting endpoint.
-        #define GENERIC_EPSIZE            64
+        // Size in bytes of the Gamepad HID reporting endpoint.
+        #define GAMEPAD_EPSIZE            8
+
+        /** Endpoint address of the Telemetry HID reporting IN endpoint. */
+        #define TELEMETRY_IN_EPADDR       (ENDPOINT_DIR_IN | 2)
+
+        // Size in bytes of the Telemetry HID reporting endpoint.
+        #define TELEMETRY_EPSIZE          64
 
     /* Function Prototypes: */
         uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
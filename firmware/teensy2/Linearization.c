@@ -0,0 +1,48 @@
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "Config/DancePadConfig.h"
+#include "Linearization.h"
+
+// one entry for every 10-bit ADC value.
+#define TABLE_SIZE 1024
+
+#define NORMALIZED(v) \
+    ((v) < LINEARIZATION_MAX_SENSOR_VALUE ? (double) (v) / LINEARIZATION_MAX_SENSOR_VALUE : 1.0)
+#define LINEARIZED(v) ((uint16_t) (LINEARIZATION_CURVE(NORMALIZED(v)) * LINEARIZED_MAX_VALUE + 0.5))
+
+// every entry is a constant expression, so compiler calculates the whole
+// table and firmware doesn't do floating point math at runtime.
+#define ENTRIES_4(v) LINEARIZED(v), LINEARIZED((v) + 1), LINEARIZED((v) + 2), LINEARIZED((v) + 3)
+#define ENTRIES_16(v) ENTRIES_4(v), ENTRIES_4((v) + 4), ENTRIES_4((v) + 8), ENTRIES_4((v) + 12)
+#define ENTRIES_64(v) ENTRIES_16(v), ENTRIES_16((v) + 16), ENTRIES_16((v) + 32), ENTRIES_16((v) + 48)
+#define ENTRIES_256(v) ENTRIES_64(v), ENTRIES_64((v) + 64), ENTRIES_64((v) + 128), ENTRIES_64((v) + 192)
+#define ENTRIES_1024(v) ENTRIES_256(v), ENTRIES_256((v) + 256), ENTRIES_256((v) + 512), ENTRIES_256((v) + 768)
+
+static const uint16_t LINEARIZATION_TABLE[TABLE_SIZE] PROGMEM = { ENTRIES_1024(0) };
+
+uint16_t Linearization_Linearize(uint16_t value) {
+    if (value >= TABLE_SIZE) {
+        value = TABLE_SIZE - 1;
+    }
+
+    return pgm_read_word(&LINEARIZATION_TABLE[value]);
+}
+
+uint16_t Linearization_Delinearize(uint16_t linearizedValue) {
+    // curve only grows, so this is a binary search. 10 steps at most.
+    uint16_t low = 0;
+    uint16_t high = TABLE_SIZE - 1;
+
+    while (low < high) {
+        uint16_t middle = (low + high + 1) / 2;
+
+        if (pgm_read_word(&LINEARIZATION_TABLE[middle]) <= linearizedValue) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    return low;
+}
@@ -0,0 +1,19 @@
+#ifndef _LINEARIZATION_H_
+#define _LINEARIZATION_H_
+    #include <stdint.h>
+
+    // FSRs respond to pressure very unevenly: most of the raw range is spent
+    // on light touches. linearized values follow LINEARIZATION_CURVE in
+    // DancePadConfig.h instead, scaled to the same 10-bit range.
+    //
+    // the curve is turned to a table in flash when compiling, so linearizing
+    // is one table read.
+    #define LINEARIZED_MAX_VALUE 1023
+
+    uint16_t Linearization_Linearize(uint16_t value);
+
+    // largest raw value that linearizes to at most given value. a raw value
+    // is over a raw threshold calculated this way exactly when its linearized
+    // value is over the linearized threshold.
+    uint16_t Linearization_Delinearize(uint16_t linearizedValue);
+#endif
@@ -5,97 +5,346 @@
 #include "ConfigStore.h"
 #include "Pad.h"
 #include "ADC.h"
+#include "Telemetry.h"
+#include "Calibration.h"
+#include "Linearization.h"
 
 #define MIN(a,b) ((a) < (b) ? a : b)
-
-PadConfiguration PAD_CONF;
+#define MAX(a,b) ((a) > (b) ? a : b)
 
 PadState PAD_STATE = { 
     .sensorValues = { [0 ... SENSOR_COUNT - 1] = 0 },
-    .buttonsPressed = { [0 ... BUTTON_COUNT - 1] = false }
+    .buttonsPressed = 0,
+    .sensorMaxima = { [0 ... SENSOR_COUNT - 1] = 0 },
+    .sensorMinima = { [0 ... SENSOR_COUNT - 1] = 0 }
 };
 
 typedef struct {
+    uint16_t sensorThresholds[SENSOR_COUNT];
     uint16_t sensorReleaseThresholds[SENSOR_COUNT];
-    int8_t buttonToSensorMap[BUTTON_COUNT][SENSOR_COUNT + 1];
+    SensorMask buttonToSensorMasks[BUTTON_COUNT];
+    uint8_t emaShifts[SENSOR_COUNT];
+    uint8_t deadbands[SENSOR_COUNT];
+    bool medianOf3[SENSOR_COUNT];
+    AdcSchedule scanSchedule;
 } InternalPadConfiguration;
 
-InternalPadConfiguration INTERNAL_PAD_CONF;
+// only the active profile is precalculated, there isn't RAM for all of
+// them. switching calculates the new one, which takes well under a frame.
+static InternalPadConfiguration INTERNAL_PAD_CONF;
+static uint8_t ACTIVE_PROFILE = 0;
+
+typedef struct {
+    // EMA of the sensor, multiplied by 2^shift so that no precision is lost.
+    uint16_t emaAccumulators[SENSOR_COUNT];
+    // two previous raw values for median of 3.
+    uint16_t previousValues[SENSOR_COUNT][2];
+} FilterState;
+
+static FilterState FILTER_STATE;
+
+// sensors that are mapped to currently pressed buttons. these are compared
+// against release threshold instead of the normal one.
+static SensorMask SENSORS_OF_PRESSED_BUTTONS = 0;
+
+// written only by scanning (head, dropped count) or only by reports (tail),
+// so neither side needs to lock the other out even if scanning moves to an
+// interrupt. indices are single bytes, which AVR reads and writes atomically.
+static ButtonEvent BUTTON_EVENTS[BUTTON_EVENT_QUEUE_SIZE];
+static volatile uint8_t buttonEventHead = 0;
+static volatile uint8_t buttonEventTail = 0;
+static volatile uint8_t droppedButtonEvents = 0;
+static bool buttonEventsEnabled = false;
+
+_Static_assert((BUTTON_EVENT_QUEUE_SIZE & (BUTTON_EVENT_QUEUE_SIZE - 1)) == 0, "button event queue size must be a power of two");
+_Static_assert(BUTTON_COUNT - 1 <= BUTTON_EVENT_INDEX_MASK, "button index doesn't fit to button event");
+
+static void Pad_CalculateThresholds(InternalPadConfiguration* internal, const PadConfiguration* padConfiguration) {
+    bool linearized = padConfiguration->flags & PAD_CONFIGURATION_LINEARIZED_THRESHOLDS;
 
-void Pad_UpdateInternalConfiguration(void) {
     for (int i = 0; i < SENSOR_COUNT; i++) {
-        INTERNAL_PAD_CONF.sensorReleaseThresholds[i] = PAD_CONF.sensorThresholds[i] * PAD_CONF.releaseMultiplier;
+        uint16_t threshold = padConfiguration->sensorThresholds[i];
+        uint16_t releaseThreshold = ((uint32_t) threshold * padConfiguration->sensorReleaseThresholds[i]) >> 8;
+
+        // comparing raw values against delinearized thresholds gives the same
+        // result as comparing linearized values, without any work per scan.
+        if (linearized) {
+            threshold = Linearization_Delinearize(threshold);
+            releaseThreshold = Linearization_Delinearize(releaseThreshold);
+        }
+
+        internal->sensorThresholds[i] = threshold;
+        internal->sensorReleaseThresholds[i] = releaseThreshold;
     }
+}
+
+static void Pad_CalculateInternalConfiguration(InternalPadConfiguration* internal, const PadConfiguration* padConfiguration) {
+    Pad_CalculateThresholds(internal, padConfiguration);
 
-    // Precalculate array for mapping buttons to sensors.
-    // For every button, there is an array of sensor indices. when there are no more buttons assigned to that sensor,
-    // the value is -1.
+    // Precalculate mask of sensors for every button, so that a button is
+    // pressed if any of the sensors in its mask are over threshold.
     for (int buttonIndex = 0; buttonIndex < BUTTON_COUNT; buttonIndex++) {
-        int mapIndex = 0;
+        SensorMask mask = 0;
 
         for (int sensorIndex = 0; sensorIndex < SENSOR_COUNT; sensorIndex++) {
-            if (PAD_CONF.sensorToButtonMapping[sensorIndex] == buttonIndex) {
-                INTERNAL_PAD_CONF.buttonToSensorMap[buttonIndex][mapIndex++] = sensorIndex;
+            if (padConfiguration->sensorToButtonMapping[sensorIndex] == buttonIndex) {
+                mask |= (SensorMask) 1 << sensorIndex;
             }
         }
 
-        // mark -1 to end
-        INTERNAL_PAD_CONF.buttonToSensorMap[buttonIndex][mapIndex] = -1;
+        internal->buttonToSensorMasks[buttonIndex] = mask;
+    }
+
+    // sensors that aren't mapped to any button can't press anything, so
+    // they are only converted now and then to keep their values visible.
+    AdcSchedule* schedule = &internal->scanSchedule;
+    schedule->sensorCount = 0;
+    schedule->idleSensorCount = 0;
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        int8_t button = padConfiguration->sensorToButtonMapping[i];
+
+        if (button >= 0 && button < BUTTON_COUNT) {
+            schedule->sensors[schedule->sensorCount++] = i;
+        } else {
+            schedule->idleSensors[schedule->idleSensorCount++] = i;
+        }
+    }
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        uint8_t filter = padConfiguration->sensorFilters[i];
+
+        internal->emaShifts[i] = MIN(filter & SENSOR_FILTER_EMA_SHIFT_MASK, SENSOR_FILTER_MAX_EMA_SHIFT);
+        internal->deadbands[i] = filter >> SENSOR_FILTER_DEADBAND_SHIFT;
+        internal->medianOf3[i] = filter & SENSOR_FILTER_MEDIAN_OF_3;
+    }
+}
+
+// takes active profile in use from the next scan on.
+static void Pad_ApplyActiveProfile(void) {
+    ADC_SetSchedule(&INTERNAL_PAD_CONF.scanSchedule);
+
+    SENSORS_OF_PRESSED_BUTTONS = 0;
+    for (int buttonIndex = 0; buttonIndex < BUTTON_COUNT; buttonIndex++) {
+        if (PAD_STATE.buttonsPressed & ((ButtonMask) 1 << buttonIndex)) {
+            SENSORS_OF_PRESSED_BUTTONS |= INTERNAL_PAD_CONF.buttonToSensorMasks[buttonIndex];
+        }
+    }
+
+    // shift might have changed, so restart filters from current value.
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        uint16_t value = PAD_STATE.sensorValues[i];
+        FILTER_STATE.emaAccumulators[i] = value << INTERNAL_PAD_CONF.emaShifts[i];
+        FILTER_STATE.previousValues[i][0] = value;
+        FILTER_STATE.previousValues[i][1] = value;
     }
 }
 
-void Pad_Initialize(const PadConfiguration* padConfiguration) {
+static inline uint16_t Pad_Median3(uint16_t a, uint16_t b, uint16_t c) {
+    uint16_t low = MIN(a, b);
+    uint16_t high = MAX(a, b);
+    return MAX(low, MIN(high, c));
+}
+
+static inline uint16_t Pad_FilterSensorValue(uint8_t sensor, uint16_t newValue) {
+    uint16_t value = newValue;
+
+    if (INTERNAL_PAD_CONF.medianOf3[sensor]) {
+        uint16_t* previous = FILTER_STATE.previousValues[sensor];
+        value = Pad_Median3(previous[0], previous[1], newValue);
+        previous[0] = previous[1];
+        previous[1] = newValue;
+    }
+
+    // accumulator = accumulator * (1 - 1/2^shift) + value, so the average
+    // itself is accumulator / 2^shift. all of it is just shifts.
+    uint8_t shift = INTERNAL_PAD_CONF.emaShifts[sensor];
+    uint16_t accumulator = FILTER_STATE.emaAccumulators[sensor];
+    accumulator = accumulator - (accumulator >> shift) + value;
+    FILTER_STATE.emaAccumulators[sensor] = accumulator;
+    value = accumulator >> shift;
+
+    uint16_t previousValue = PAD_STATE.sensorValues[sensor];
+    uint16_t difference = value > previousValue ? value - previousValue : previousValue - value;
+
+    return difference > INTERNAL_PAD_CONF.deadbands[sensor] ? value : previousValue;
+}
+
+void Pad_Initialize(const PadConfiguration* profiles, uint8_t activeProfile) {
     ADC_Init();
-    Pad_UpdateConfiguration(padConfiguration);
+
+    buttonEventHead = 0;
+    buttonEventTail = 0;
+    droppedButtonEvents = 0;
+
+    ACTIVE_PROFILE = activeProfile < PROFILE_COUNT ? activeProfile : 0;
+    Pad_CalculateInternalConfiguration(&INTERNAL_PAD_CONF, &profiles[ACTIVE_PROFILE]);
+    Pad_ApplyActiveProfile();
+}
+
+void Pad_UpdateConfiguration(uint8_t profile, const PadConfiguration* padConfiguration) {
+    // others are calculated when they are selected.
+    if (profile != ACTIVE_PROFILE) {
+        return;
+    }
+
+    Pad_CalculateInternalConfiguration(&INTERNAL_PAD_CONF, padConfiguration);
+    Pad_ApplyActiveProfile();
 }
 
-void Pad_UpdateConfiguration(const PadConfiguration* padConfiguration) {
-    memcpy(&PAD_CONF, padConfiguration, sizeof (PadConfiguration));
-    Pad_UpdateInternalConfiguration();
+void Pad_SetThresholds(uint8_t profile, const PadConfiguration* padConfiguration) {
+    if (profile != ACTIVE_PROFILE) {
+        return;
+    }
+
+    // mapping stays the same, so sensors of pressed buttons, filters and the
+    // scan schedule are all still valid. called from the main loop like
+    // scans, so a scan never sees half of the new thresholds.
+    Pad_CalculateThresholds(&INTERNAL_PAD_CONF, padConfiguration);
 }
 
-void Pad_UpdateState(void) {
-    uint16_t newValues[SENSOR_COUNT]; 
-    
-    for (int i = 0; i < SENSOR_COUNT; i++) {
-        newValues[i] = ADC_Read(i);
+void Pad_SelectProfile(uint8_t profile, const PadConfiguration* padConfiguration) {
+    // this and Pad_UpdateState() are both called from the main loop, so the
+    // switch always happens between two scans.
+    if (profile >= PROFILE_COUNT || profile == ACTIVE_PROFILE) {
+        return;
     }
-    
+
+    ACTIVE_PROFILE = profile;
+    Pad_CalculateInternalConfiguration(&INTERNAL_PAD_CONF, padConfiguration);
+    Pad_ApplyActiveProfile();
+}
+
+uint8_t Pad_GetActiveProfile(void) {
+    return ACTIVE_PROFILE;
+}
+
+void Pad_ResetPeaks(void) {
+    // reports are written in the main loop like scans are done, so this
+    // can't land in the middle of a scan.
+    memcpy(PAD_STATE.sensorMaxima, PAD_STATE.sensorValues, sizeof (PAD_STATE.sensorMaxima));
+    memcpy(PAD_STATE.sensorMinima, PAD_STATE.sensorValues, sizeof (PAD_STATE.sensorMinima));
+}
+
+static void Pad_QueueButtonEvents(ButtonMask changed, ButtonMask buttonsPressed) {
+    if (!buttonEventsEnabled) {
+        return;
+    }
+
+    uint16_t timestamp = ADC_GetReadFrameTimestamp();
+    uint8_t head = buttonEventHead;
+
+    for (uint8_t i = 0; changed; i++, changed >>= 1, buttonsPressed >>= 1) {
+        if (!(changed & 1)) {
+            continue;
+        }
+
+        if ((uint8_t) (head - buttonEventTail) >= BUTTON_EVENT_QUEUE_SIZE) {
+            droppedButtonEvents++;
+            continue;
+        }
+
+        ButtonEvent* event = &BUTTON_EVENTS[head & (BUTTON_EVENT_QUEUE_SIZE - 1)];
+        event->timestamp = timestamp;
+        event->button = i | ((buttonsPressed & 1) ? BUTTON_EVENT_PRESSED : 0);
+        head++;
+    }
+
+    // publish only after the events themselves are written.
+    buttonEventHead = head;
+}
+
+bool Pad_ReadButtonEvent(ButtonEvent* event) {
+    uint8_t tail = buttonEventTail;
+
+    if (tail == buttonEventHead) {
+        return false;
+    }
+
+    *event = BUTTON_EVENTS[tail & (BUTTON_EVENT_QUEUE_SIZE - 1)];
+    buttonEventTail = tail + 1;
+    return true;
+}
+
+bool Pad_HasButtonEvents(void) {
+    return buttonEventTail != buttonEventHead;
+}
+
+uint8_t Pad_GetDroppedButtonEvents(void) {
+    return droppedButtonEvents;
+}
+
+void Pad_SetButtonEventsEnabled(bool enabled) {
+    if (enabled == buttonEventsEnabled) {
+        return;
+    }
+
+    // called from the main loop like scans, so both ends of the queue can
+    // be touched here. events from before are stale either way.
+    buttonEventsEnabled = enabled;
+    buttonEventTail = buttonEventHead;
+    droppedButtonEvents = 0;
+}
+
+bool Pad_UpdateState(void) {
+    uint16_t scanTicks = Telemetry_Now();
+    uint16_t newValues[SENSOR_COUNT];
+
+    // nothing to do if ADC hasn't finished a new frame since the last time.
+    if (!ADC_ReadFrame(newValues)) {
+        return false;
+    }
+
     for (int i = 0; i < SENSOR_COUNT; i++) {
-        // TODO: weight of old value and new value is not configurable for now
-        // because division by unknown value means ass performance.
-        PAD_STATE.sensorValues[i] = (PAD_STATE.sensorValues[i] + newValues[i]) / 2;
+        uint16_t value = Pad_FilterSensorValue(i, newValues[i]);
+        PAD_STATE.sensorValues[i] = value;
+
+        if (value > PAD_STATE.sensorMaxima[i]) {
+            PAD_STATE.sensorMaxima[i] = value;
+        }
+
+        if (value < PAD_STATE.sensorMinima[i]) {
+            PAD_STATE.sensorMinima[i] = value;
+        }
     }
 
-    for (int i = 0; i < BUTTON_COUNT; i++) {
-        bool newButtonPressedState = false;
+    SensorMask sensorsOverThreshold = 0;
+    SensorMask sensorBit = 1;
 
-        for (int j = 0; j < SENSOR_COUNT; j++) {
-            int8_t sensor = INTERNAL_PAD_CONF.buttonToSensorMap[i][j];
-            
-            if (sensor == -1) {
-                break;
-            }
+    for (int i = 0; i < SENSOR_COUNT; i++, sensorBit <<= 1) {
+        uint16_t threshold = (SENSORS_OF_PRESSED_BUTTONS & sensorBit)
+            ? INTERNAL_PAD_CONF.sensorReleaseThresholds[i]
+            : INTERNAL_PAD_CONF.sensorThresholds[i];
 
-            if (sensor < 0 || sensor > SENSOR_COUNT) {
-                break;
-            }
+        if (PAD_STATE.sensorValues[i] > threshold) {
+            sensorsOverThreshold |= sensorBit;
+        }
+    }
 
-            uint16_t sensorVal = PAD_STATE.sensorValues[sensor];
-
-            if (PAD_STATE.buttonsPressed[i]) {
-                if (sensorVal > INTERNAL_PAD_CONF.sensorReleaseThresholds[sensor]) {
-                    newButtonPressedState = true;
-                    break;
-                }
-            } else {
-                if (sensorVal > PAD_CONF.sensorThresholds[sensor]) {
-                    newButtonPressedState = true;
-                    break;
-                }
-            }
+    Calibration_Update(PAD_STATE.sensorValues, sensorsOverThreshold);
+
+    ButtonMask buttonsPressed = 0;
+    ButtonMask buttonBit = 1;
+    SensorMask sensorsOfPressedButtons = 0;
+
+    for (int i = 0; i < BUTTON_COUNT; i++, buttonBit <<= 1) {
+        SensorMask buttonSensors = INTERNAL_PAD_CONF.buttonToSensorMasks[i];
+
+        if (sensorsOverThreshold & buttonSensors) {
+            buttonsPressed |= buttonBit;
+            sensorsOfPressedButtons |= buttonSensors;
         }
+    }
 
-        PAD_STATE.buttonsPressed[i] = newButtonPressedState;
+    ButtonMask buttonsChanged = buttonsPressed ^ PAD_STATE.buttonsPressed;
+
+    if (buttonsChanged) {
+        Telemetry_MarkButtonEdge(scanTicks);
+        Pad_QueueButtonEvents(buttonsChanged, buttonsPressed);
     }
+
+    PAD_STATE.buttonsPressed = buttonsPressed;
+    SENSORS_OF_PRESSED_BUTTONS = sensorsOfPressedButtons;
+
+    return true;
 }
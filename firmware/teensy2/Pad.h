@@ -4,21 +4,106 @@
     #include <stdbool.h>
     #include "Config/DancePadConfig.h"
 
+    // bit for every sensor or button, smallest type that fits them all.
+    #if SENSOR_COUNT <= 8
+        typedef uint8_t SensorMask;
+    #elif SENSOR_COUNT <= 16
+        typedef uint16_t SensorMask;
+    #else
+        #error "SENSOR_COUNT can be at most 16, see DancePadConfig.h"
+    #endif
+
+    #if BUTTON_COUNT <= 8
+        typedef uint8_t ButtonMask;
+    #elif BUTTON_COUNT <= 16
+        typedef uint16_t ButtonMask;
+    #elif BUTTON_COUNT <= 32
+        typedef uint32_t ButtonMask;
+    #else
+        #error "BUTTON_COUNT can be at most 32"
+    #endif
+
+    // filter settings of a sensor are packed to one byte. sensor values go
+    // through the stages in this order:
+    // - median of 3: replaces value with median of it and two previous ones, getting rid of single sample spikes.
+    // - EMA: exponential moving average, new value has weight of 1 / 2^shift. 0 = no averaging.
+    // - deadband: value only changes when it moves more than this much from the previous one.
+    #define SENSOR_FILTER_EMA_SHIFT_MASK 0x07
+    #define SENSOR_FILTER_MEDIAN_OF_3 0x08
+    #define SENSOR_FILTER_DEADBAND_SHIFT 4
+
+    // shift is capped so that 10-bit values still fit 16-bit EMA accumulator.
+    #define SENSOR_FILTER_MAX_EMA_SHIFT 6
+
+    #define SENSOR_FILTER(emaShift, medianOf3, deadband) \
+        (((emaShift) & SENSOR_FILTER_EMA_SHIFT_MASK) | ((medianOf3) ? SENSOR_FILTER_MEDIAN_OF_3 : 0) | ((deadband) << SENSOR_FILTER_DEADBAND_SHIFT))
+
+    // release threshold of a sensor is a fraction of its threshold, in
+    // 1/256ths. button is released when value drops below it.
+    #define SENSOR_RELEASE_THRESHOLD(fraction) ((uint8_t) ((fraction) * 256))
+
+    // sensor thresholds are in linearized units instead of raw ones, see
+    // Linearization.h. release thresholds are fractions of linearized
+    // thresholds then, too.
+    #define PAD_CONFIGURATION_LINEARIZED_THRESHOLDS 0x01
+
     typedef struct {
         uint16_t sensorThresholds[SENSOR_COUNT];
-        float releaseMultiplier;
+        uint8_t sensorReleaseThresholds[SENSOR_COUNT];
         int8_t sensorToButtonMapping[SENSOR_COUNT];
+        uint8_t sensorFilters[SENSOR_COUNT];
+        uint8_t flags;
     } __attribute__((packed)) PadConfiguration;
 
     typedef struct {
         uint16_t sensorValues[SENSOR_COUNT];
-        bool buttonsPressed[BUTTON_COUNT];
+        ButtonMask buttonsPressed; // bit n is set when button n is pressed
+
+        // highest and lowest value of every sensor since Pad_ResetPeaks(),
+        // so that reports can show what happened in between them.
+        uint16_t sensorMaxima[SENSOR_COUNT];
+        uint16_t sensorMinima[SENSOR_COUNT];
     } PadState;
 
-    void Pad_Initialize(const PadConfiguration* padConfiguration);
-    void Pad_UpdateState(void);
-    void Pad_UpdateConfiguration(const PadConfiguration* padConfiguration);
+    // every press and release, in the order they were scanned, so that host
+    // sees a tap even when it starts and ends between two reports. scanning
+    // pushes to a queue that reports drain, see Pad_ReadButtonEvent().
+    #define BUTTON_EVENT_QUEUE_SIZE 32 // power of two
+    #define BUTTON_EVENT_INDEX_MASK 0x1F
+    #define BUTTON_EVENT_PRESSED 0x80
+
+    typedef struct {
+        uint16_t timestamp; // of the scanned frame, in telemetry ticks
+        uint8_t button; // index, with BUTTON_EVENT_PRESSED set for presses
+    } __attribute__((packed)) ButtonEvent;
+
+    // profiles is an array of PROFILE_COUNT configurations. only the active
+    // one is used, pad doesn't keep hold of any of them.
+    void Pad_Initialize(const PadConfiguration* profiles, uint8_t activeProfile);
+    bool Pad_UpdateState(void);
+    // only changes to the active profile matter right away, others are
+    // given again when they are selected.
+    void Pad_UpdateConfiguration(uint8_t profile, const PadConfiguration* padConfiguration);
+    // same, but only thresholds have changed. filters and scanning go on
+    // as they were, so this can be called often, e.g. when following drift.
+    void Pad_SetThresholds(uint8_t profile, const PadConfiguration* padConfiguration);
+
+    // starts following peaks from current sensor values.
+    void Pad_ResetPeaks(void);
+
+    // takes the oldest queued button event. returns false if there are none.
+    bool Pad_ReadButtonEvent(ButtonEvent* event);
+    bool Pad_HasButtonEvents(void);
+    // events that didn't fit to the queue since start, wraps around.
+    uint8_t Pad_GetDroppedButtonEvents(void);
+    // events are only queued when something reads them. turning them on or
+    // off empties the queue and zeroes the dropped count. off by default.
+    void Pad_SetButtonEventsEnabled(bool enabled);
+
+    // switches to another profile, effective from the next scan.
+    // padConfiguration is the configuration of that profile.
+    void Pad_SelectProfile(uint8_t profile, const PadConfiguration* padConfiguration);
+    uint8_t Pad_GetActiveProfile(void);
 
-    extern PadConfiguration PAD_CONF;
     extern PadState PAD_STATE;
 #endif
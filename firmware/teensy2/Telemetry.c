@@ -0,0 +1,91 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/io.h>
+
+#include "Telemetry.h"
+
+static TelemetryData telemetry;
+
+static bool buttonEdgePending = false;
+static uint16_t buttonEdgeTicks;
+
+static bool previousCallbackKnown = false;
+static uint16_t previousCallbackTicks;
+
+void Telemetry_Init(void) {
+    TCCR1A = 0; // normal mode, no compare outputs
+    TCCR1B = (1 << CS11); // clock/8
+    memset(&telemetry, 0, sizeof (telemetry));
+    buttonEdgePending = false;
+    previousCallbackKnown = false;
+}
+
+void Telemetry_RecordValue(TelemetryHistogram* histogram, uint8_t shift, uint16_t ticks) {
+    uint16_t scaled = ticks >> shift;
+    uint8_t bucket = 0;
+
+    // this is log2 + 1, capped to the last bucket.
+    while (scaled && bucket < TELEMETRY_BUCKET_COUNT - 1) {
+        scaled >>= 1;
+        bucket++;
+    }
+
+    if (histogram->buckets[bucket] != UINT16_MAX) {
+        histogram->buckets[bucket]++;
+    }
+
+    if (ticks > histogram->max) {
+        histogram->max = ticks;
+    }
+}
+
+void Telemetry_RecordScanDuration(uint16_t startTicks) {
+    Telemetry_RecordValue(&telemetry.scanDuration, TELEMETRY_SCAN_DURATION_SHIFT, Telemetry_Now() - startTicks);
+}
+
+void Telemetry_MarkButtonEdge(uint16_t ticks) {
+    // if there are several changes before next report, the first one is the
+    // one that has waited for the longest.
+    if (!buttonEdgePending) {
+        buttonEdgePending = true;
+        buttonEdgeTicks = ticks;
+    }
+}
+
+bool Telemetry_TakeButtonEdge(uint16_t* ticks) {
+    if (!buttonEdgePending) {
+        return false;
+    }
+
+    buttonEdgePending = false;
+    *ticks = buttonEdgeTicks;
+    return true;
+}
+
+void Telemetry_RecordPressLatency(uint16_t ticks) {
+    Telemetry_RecordValue(&telemetry.pressLatency, TELEMETRY_PRESS_LATENCY_SHIFT, ticks);
+}
+
+void Telemetry_RecordReportCallback(uint16_t ticks) {
+    if (previousCallbackKnown) {
+        uint16_t interval = ticks - previousCallbackTicks;
+        uint16_t jitter = interval > TELEMETRY_CALLBACK_INTERVAL_TICKS
+            ? interval - TELEMETRY_CALLBACK_INTERVAL_TICKS
+            : TELEMETRY_CALLBACK_INTERVAL_TICKS - interval;
+
+        Telemetry_RecordValue(&telemetry.callbackJitter, TELEMETRY_CALLBACK_JITTER_SHIFT, jitter);
+    }
+
+    previousCallbackKnown = true;
+    previousCallbackTicks = ticks;
+}
+
+void Telemetry_RecordSampleAge(uint16_t ticks) {
+    Telemetry_RecordValue(&telemetry.sampleAge, TELEMETRY_SAMPLE_AGE_SHIFT, ticks);
+}
+
+void Telemetry_ReadAndReset(TelemetryData* data) {
+    memcpy(data, &telemetry, sizeof (telemetry));
+    memset(&telemetry, 0, sizeof (telemetry));
+}
@@ -0,0 +1,79 @@
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+    #include <stdint.h>
+    #include <stdbool.h>
+    #include <avr/io.h>
+    #include <util/atomic.h>
+
+    // timer 1 runs with clock/8 prescaler, so one tick is 0.5 us at 16 MHz
+    // and the 16-bit counter wraps around every ~32 ms. ADC.c uses its
+    // compare A interrupt, see ADC_SetFrameDeadline().
+    #define TELEMETRY_TICKS_PER_US 2
+
+    #define TELEMETRY_BUCKET_COUNT 8
+
+    // every histogram has the same amount of logarithmic buckets: bucket 0 is
+    // for values below (1 << shift) ticks, every following bucket is twice as
+    // wide as the previous one and the last bucket collects everything above.
+    #define TELEMETRY_SCAN_DURATION_SHIFT 3 // 4 us
+    #define TELEMETRY_PRESS_LATENCY_SHIFT 6 // 32 us
+    #define TELEMETRY_CALLBACK_JITTER_SHIFT 0 // 0.5 us
+    #define TELEMETRY_SAMPLE_AGE_SHIFT 5 // 16 us
+
+    // LUFA asks for a gamepad report at most once per USB frame.
+    #define TELEMETRY_CALLBACK_INTERVAL_TICKS (1000 * TELEMETRY_TICKS_PER_US)
+
+    typedef struct {
+        uint16_t buckets[TELEMETRY_BUCKET_COUNT]; // saturates at 0xFFFF
+        uint16_t max; // largest value recorded, in ticks
+    } __attribute__((packed)) TelemetryHistogram;
+
+    typedef struct {
+        // how long it takes to process a scanned frame in Pad_UpdateState().
+        TelemetryHistogram scanDuration;
+
+        // from the scan that changed state of a button to host taking the
+        // gamepad report that contains the change. main loop notices that
+        // the report is gone, so this can be up to a round of it late.
+        TelemetryHistogram pressLatency;
+
+        // how far apart two consecutive gamepad report callbacks from LUFA
+        // are from the expected 1 ms, in either direction. LUFA makes one
+        // in the first main loop round of a USB frame that has room in the
+        // endpoint, so this is how steadily main loop gets there, not how
+        // steadily host polls.
+        TelemetryHistogram callbackJitter;
+
+        // from the end of the scan that a gamepad report was made from to
+        // the poll that took the report.
+        TelemetryHistogram sampleAge;
+    } __attribute__((packed)) TelemetryData;
+
+    void Telemetry_Init(void);
+
+    // safe to call from interrupts too. 16-bit timer registers are read
+    // through a shared temporary register, so reads must not interleave.
+    static inline uint16_t Telemetry_Now(void) {
+        uint16_t ticks;
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            ticks = TCNT1;
+        }
+
+        return ticks;
+    }
+
+    void Telemetry_RecordValue(TelemetryHistogram* histogram, uint8_t shift, uint16_t ticks);
+    void Telemetry_RecordScanDuration(uint16_t startTicks);
+    void Telemetry_MarkButtonEdge(uint16_t ticks);
+    // takes the first edge since the previous call, for the gamepad report
+    // that was just queued. returns false if there was none.
+    bool Telemetry_TakeButtonEdge(uint16_t* ticks);
+    void Telemetry_RecordPressLatency(uint16_t ticks);
+    void Telemetry_RecordReportCallback(uint16_t ticks);
+    void Telemetry_RecordSampleAge(uint16_t ticks);
+
+    // copies all histograms to data and clears them, so every read returns
+    // what happened since the previous one.
+    void Telemetry_ReadAndReset(TelemetryData* data);
+#endif
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "Config/DancePadConfig.h"
+#include "Communication.h"
+#include "Descriptors.h"
+#include "Pad.h"
+#include "StubADC.h"
+
+// measures how long the hot path of the firmware takes on the host. absolute
+// numbers have nothing to do with the 16 MHz AVR, but relative changes do:
+// compare against a run on the same machine before your change.
+
+#define PATTERN_LENGTH 256
+#define DEFAULT_ITERATIONS 2000000
+
+typedef struct {
+    const char* name;
+    int8_t sensorToButtonMapping[SENSOR_COUNT];
+    uint8_t sensorFilter;
+} BenchmarkCase;
+
+static const BenchmarkCase BENCHMARK_CASES[] = {
+    { "one button", { [0 ... SENSOR_COUNT - 1] = 0 }, SENSOR_FILTER(1, false, 0) },
+    { "one-to-one", { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 }, SENSOR_FILTER(1, false, 0) },
+    { "third unwired", { 0, 1, 2, 3, 0, 1, 2, 3, -1, -1, -1, -1 }, SENSOR_FILTER(1, false, 0) },
+    { "unmapped", { [0 ... SENSOR_COUNT - 1] = -1 }, SENSOR_FILTER(1, false, 0) },
+    { "all filters", { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 }, SENSOR_FILTER(3, true, 4) }
+};
+
+static const char* INPUT_REPORT_MODE_NAMES[INPUT_REPORT_MODE_COUNT] = {
+    [INPUT_REPORT_MODE_FULL] = "full",
+    [INPUT_REPORT_MODE_BUTTONS] = "buttons",
+    [INPUT_REPORT_MODE_PACKED_SENSORS] = "packed",
+    [INPUT_REPORT_MODE_SCALED_SENSORS] = "scaled",
+    [INPUT_REPORT_MODE_BATCHED_SENSORS] = "batched",
+    [INPUT_REPORT_MODE_PEAK_SENSORS] = "peaks",
+    [INPUT_REPORT_MODE_BUTTON_EVENTS] = "events"
+};
+
+static uint16_t pattern[PATTERN_LENGTH][SENSOR_COUNT];
+
+// triangle waves with a different phase for every sensor, so buttons get
+// pressed and released all the time and both thresholds are exercised.
+static void CreatePattern(void) {
+    for (int frame = 0; frame < PATTERN_LENGTH; frame++) {
+        for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+            int phase = (frame + sensor * 21) % PATTERN_LENGTH;
+            int triangle = phase < PATTERN_LENGTH / 2 ? phase : PATTERN_LENGTH - phase;
+            pattern[frame][sensor] = 200 + triangle * 3;
+        }
+    }
+}
+
+static uint64_t NowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void PrintResult(const char* function, const char* benchmarkCase, uint64_t ns, long iterations) {
+    double nsPerCall = (double) ns / iterations;
+    printf("%-36s %-12s %10.1f ns/call %14.0f calls/s\n", function, benchmarkCase, nsPerCall, 1e9 / nsPerCall);
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : DEFAULT_ITERATIONS;
+    uint8_t report[TELEMETRY_EPSIZE] = { 0 };
+    uint8_t reportId;
+    uint16_t reportSize;
+
+    CreatePattern();
+    StubADC_SetPattern(pattern, PATTERN_LENGTH);
+
+    for (size_t c = 0; c < sizeof (BENCHMARK_CASES) / sizeof (BENCHMARK_CASES[0]); c++) {
+        PadConfiguration configuration = {
+            .sensorThresholds = { [0 ... SENSOR_COUNT - 1] = 400 },
+            .sensorReleaseThresholds = { [0 ... SENSOR_COUNT - 1] = SENSOR_RELEASE_THRESHOLD(0.9) }
+        };
+
+        for (int i = 0; i < SENSOR_COUNT; i++) {
+            configuration.sensorToButtonMapping[i] = BENCHMARK_CASES[c].sensorToButtonMapping[i];
+            configuration.sensorFilters[i] = BENCHMARK_CASES[c].sensorFilter;
+        }
+
+        PadConfiguration profiles[PROFILE_COUNT];
+
+        for (int i = 0; i < PROFILE_COUNT; i++) {
+            profiles[i] = configuration;
+        }
+
+        Pad_Initialize(profiles, 0);
+
+        // on the device, frame takes time in proportion to its conversions.
+        const AdcSchedule* schedule = StubADC_GetSchedule();
+        double conversionsPerFrame = schedule->sensorCount;
+
+        if (schedule->idleSensorCount > 0) {
+            conversionsPerFrame += schedule->sensorCount == 0 ? 1.0 : 1.0 / ADC_IDLE_SENSOR_INTERVAL;
+        }
+
+        printf("%-36s %-12s %10.2f conversions/frame (%u sensors every frame, %u idle)\n", "scan schedule", BENCHMARK_CASES[c].name,
+            conversionsPerFrame, schedule->sensorCount, schedule->idleSensorCount);
+
+
+        // configuration updates are rare, so fewer rounds is enough.
+        long updateIterations = iterations / 100 + 1;
+        uint64_t start = NowNs();
+        for (long i = 0; i < updateIterations; i++) {
+            Pad_UpdateConfiguration(0, &configuration);
+        }
+        PrintResult("Pad_UpdateConfiguration", BENCHMARK_CASES[c].name, NowNs() - start, updateIterations);
+
+        start = NowNs();
+        for (long i = 0; i < updateIterations; i++) {
+            Pad_SelectProfile(i & 1, &profiles[i & 1]);
+        }
+        PrintResult("Pad_SelectProfile", BENCHMARK_CASES[c].name, NowNs() - start, updateIterations);
+        Pad_SelectProfile(0, &profiles[0]);
+
+        start = NowNs();
+        for (long i = 0; i < iterations; i++) {
+            Pad_UpdateState();
+        }
+        PrintResult("Pad_UpdateState", BENCHMARK_CASES[c].name, NowNs() - start, iterations);
+
+        start = NowNs();
+        for (long i = 0; i < iterations; i++) {
+            Pad_UpdateState();
+            Communication_WriteInputHIDReport(&reportId, report, &reportSize);
+        }
+        PrintResult("scan + report", BENCHMARK_CASES[c].name, NowNs() - start, iterations);
+    }
+
+    for (uint8_t mode = 0; mode < INPUT_REPORT_MODE_COUNT; mode++) {
+        ReportingConfiguration reportingConfiguration = { .inputReportMode = mode };
+        Communication_UpdateReportingConfiguration(&reportingConfiguration);
+
+        uint64_t start = NowNs();
+        // batched report needs new frames every time to have something to do.
+        uint16_t framesPerReport = mode == INPUT_REPORT_MODE_BATCHED_SENSORS ? BATCHED_FRAME_COUNT : 0;
+
+        for (long i = 0; i < iterations; i++) {
+            StubADC_Advance(framesPerReport);
+            Communication_WriteInputHIDReport(&reportId, report, &reportSize);
+        }
+        PrintResult("Communication_WriteInputHIDReport", INPUT_REPORT_MODE_NAMES[mode], NowNs() - start, iterations);
+    }
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Config/DancePadConfig.h"
+#include "Calibration.h"
+#include "Pad.h"
+#include "TestUtil.h"
+
+#define WINDOW_FRAMES (1 << CALIBRATION_WINDOW_SHIFT)
+
+// feeds a window worth of frames where sensor i reads base + i, alternating
+// by +-wobble.
+static void RunWindow(uint16_t base, uint16_t wobble, SensorMask sensorsOverThreshold) {
+    uint16_t values[SENSOR_COUNT];
+
+    for (int frame = 0; frame < WINDOW_FRAMES; frame++) {
+        for (int i = 0; i < SENSOR_COUNT; i++) {
+            values[i] = base + i + (frame & 1 ? wobble : -wobble);
+        }
+
+        Calibration_Update(values, sensorsOverThreshold);
+    }
+}
+
+static void CreateConfiguration(PadConfiguration* conf, uint16_t threshold) {
+    memset(conf, 0, sizeof (PadConfiguration));
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        conf->sensorThresholds[i] = threshold;
+    }
+}
+
+static void TestCalibrationTakesOneWindow(void) {
+    PadConfiguration conf;
+    CreateConfiguration(&conf, 400);
+
+    uint16_t buffers[SENSOR_COUNT];
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        buffers[i] = 50 + i;
+    }
+
+    Calibration_Start(buffers);
+    EXPECT(CALIBRATION_STATE.calibrating);
+
+    RunWindow(100, 3, 0);
+    EXPECT(!CALIBRATION_STATE.calibrating);
+    EXPECT_EQ(Calibration_Apply(&conf), CALIBRATION_FINISHED);
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        EXPECT_EQ(CALIBRATION_STATE.baselines[i], 100 + i);
+        EXPECT_EQ(CALIBRATION_STATE.noise[i], 6);
+        EXPECT_EQ(conf.sensorThresholds[i], 100 + i + 50 + i);
+    }
+
+    // results are applied only once.
+    EXPECT_EQ(Calibration_Apply(&conf), CALIBRATION_UNCHANGED);
+}
+
+static void TestThresholdsFollowDriftSlowly(void) {
+    PadConfiguration conf;
+    CreateConfiguration(&conf, 400);
+
+    Calibration_SetDriftTracking(true);
+
+    // baseline is 100 + i after previous test. sensors jump 10 units up, but
+    // thresholds only move one unit per window.
+    for (int window = 1; window <= 3; window++) {
+        RunWindow(110, 0, 0);
+        EXPECT_EQ(Calibration_Apply(&conf), CALIBRATION_DRIFTED);
+        EXPECT_EQ(conf.sensorThresholds[0], 400 + window);
+        EXPECT_EQ(CALIBRATION_STATE.baselines[0], 100 + window);
+    }
+
+    Calibration_SetDriftTracking(false);
+
+    // baselines are still tracked, thresholds just stay put.
+    RunWindow(110, 0, 0);
+    EXPECT_EQ(Calibration_Apply(&conf), CALIBRATION_UNCHANGED);
+    EXPECT_EQ(conf.sensorThresholds[0], 403);
+    EXPECT_EQ(CALIBRATION_STATE.baselines[0], 104);
+}
+
+static void TestPressedSensorsDontDrift(void) {
+    PadConfiguration conf;
+    CreateConfiguration(&conf, 400);
+
+    Calibration_SetDriftTracking(true);
+
+    // sensor 0 is stepped on during the window.
+    RunWindow(300, 0, 1 << 0);
+    EXPECT_EQ(Calibration_Apply(&conf), CALIBRATION_DRIFTED);
+    EXPECT_EQ(conf.sensorThresholds[0], 400);
+    EXPECT_EQ(conf.sensorThresholds[1], 401);
+
+    Calibration_SetDriftTracking(false);
+}
+
+int main(void) {
+    RUN_TEST(TestCalibrationTakesOneWindow);
+    RUN_TEST(TestThresholdsFollowDriftSlowly);
+    RUN_TEST(TestPressedSensorsDontDrift);
+    return TEST_RESULT();
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <avr/interrupt.h>
+
+#include "Config/DancePadConfig.h"
+#include "ADC.h"
+#include "Characterization.h"
+#include "SimulatedHardware.h"
+#include "Telemetry.h"
+#include "TestUtil.h"
+
+#define CYCLES_PER_MS (SIMULATED_F_CPU / 1000)
+
+// ADC takes 13 of its clocks per conversion.
+#define CONVERSIONS_PER_SECOND(prescaler) (SIMULATED_F_CPU / (13UL << (prescaler)))
+
+static void Setup(void) {
+    SimulatedHardware_Reset();
+    sei();
+    Telemetry_Init();
+    ADC_Init();
+}
+
+// runs main loop until measurement is done, returns how long it took.
+static uint32_t RunCharacterization(void) {
+    uint64_t start = SimulatedHardware_GetCycles();
+
+    while (!Characterization_Update()) {
+        EXPECT(CHARACTERIZATION_STATE.measuring);
+
+        if (SimulatedHardware_GetCycles() - start > 1000 * CYCLES_PER_MS) {
+            printf("  measurement didn't finish\n");
+            testFailures++;
+            break;
+        }
+
+        SimulatedHardware_Run(500);
+    }
+
+    EXPECT(!CHARACTERIZATION_STATE.measuring);
+    return (SimulatedHardware_GetCycles() - start) / CYCLES_PER_MS;
+}
+
+static void ExpectRate(uint32_t expected) {
+    uint32_t rate = CHARACTERIZATION_STATE.conversionsPerSecond;
+    printf("  %lu conversions per second, %lu expected\n", (unsigned long) rate, (unsigned long) expected);
+    EXPECT(rate > expected * 95 / 100 && rate <= expected);
+}
+
+// wobbles +-2 around 500, 4 units squared of variance, changing every 100 us
+// so that frames catch both.
+static uint16_t WobblySource(uint8_t channel, uint64_t cycle) {
+    return (cycle / (CYCLES_PER_MS / 10)) % 2 ? 502 : 498;
+}
+
+static void TestDefaultSpeed(void) {
+    Setup();
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        SimulatedHardware_SetSensorInput(i, 300 + i);
+    }
+
+    AdcSpeedSettings settings = ADC_DEFAULT_SPEED;
+    EXPECT(Characterization_Start(&settings));
+    uint32_t ms = RunCharacterization();
+    printf("  took %lu ms\n", (unsigned long) ms);
+
+    ExpectRate(CONVERSIONS_PER_SECOND(6));
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        EXPECT_EQ(CHARACTERIZATION_STATE.noise[i], 0);
+    }
+}
+
+static void TestFasterClockMeasuresNoise(void) {
+    Setup();
+    SimulatedHardware_SetAnalogSource(WobblySource);
+
+    AdcSpeedSettings settings = { .prescaler = 4, .highSpeed = true, .eightBit = false };
+    EXPECT(Characterization_Start(&settings));
+    RunCharacterization();
+
+    ExpectRate(CONVERSIONS_PER_SECOND(4));
+
+    // how many frames land on each side varies a little.
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        EXPECT(abs(CHARACTERIZATION_STATE.noise[i] - 4 * 16) <= 4);
+    }
+}
+
+static uint16_t OneBitSource(uint8_t channel, uint64_t cycle) {
+    return (cycle / (CYCLES_PER_MS / 10)) % 2 ? 501 : 500;
+}
+
+static void TestEightBitsDropLowestBits(void) {
+    Setup();
+    SimulatedHardware_SetAnalogSource(OneBitSource);
+
+    AdcSpeedSettings settings = { .prescaler = 6, .highSpeed = true, .eightBit = false };
+    EXPECT(Characterization_Start(&settings));
+    RunCharacterization();
+    EXPECT(CHARACTERIZATION_STATE.noise[0] > 0);
+
+    settings.eightBit = true;
+    EXPECT(Characterization_Start(&settings));
+    RunCharacterization();
+    ExpectRate(CONVERSIONS_PER_SECOND(6));
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        EXPECT_EQ(CHARACTERIZATION_STATE.noise[i], 0);
+    }
+}
+
+static void TestInvalidSettingsAreRejected(void) {
+    Setup();
+
+    AdcSpeedSettings settings = { .prescaler = 0 };
+    EXPECT(!Characterization_Start(&settings));
+    settings.prescaler = 8;
+    EXPECT(!Characterization_Start(&settings));
+    EXPECT(!CHARACTERIZATION_STATE.measuring);
+    EXPECT(!Characterization_Update());
+}
+
+int main(void) {
+    RUN_TEST(TestDefaultSpeed);
+    RUN_TEST(TestFasterClockMeasuresNoise);
+    RUN_TEST(TestEightBitsDropLowestBits);
+    RUN_TEST(TestInvalidSettingsAreRejected);
+    return TEST_RESULT();
+}
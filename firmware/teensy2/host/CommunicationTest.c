@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <string.h>
+#include <avr/interrupt.h>
+
+#include "Config/DancePadConfig.h"
+#include "ADC.h"
+#include "Communication.h"
+#include "Descriptors.h"
+#include "Pad.h"
+#include "SimulatedHardware.h"
+#include "Telemetry.h"
+#include "TestUtil.h"
+
+#define CYCLES_PER_MS (SIMULATED_F_CPU / 1000)
+
+static uint8_t report[TELEMETRY_EPSIZE];
+static uint8_t reportId;
+static uint16_t reportSize;
+
+static bool WriteReport(void) {
+    return Communication_WriteInputHIDReport(&reportId, report, &reportSize);
+}
+
+static void Setup(uint8_t inputReportMode, bool changeDriven, uint8_t sensorChangeDelta, uint16_t idleKeepaliveMs) {
+    memset(&PAD_STATE, 0, sizeof (PAD_STATE));
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        PAD_STATE.sensorValues[i] = 500;
+    }
+
+    ReportingConfiguration configuration = {
+        .inputReportMode = inputReportMode,
+        .changeDriven = changeDriven,
+        .sensorChangeDelta = sensorChangeDelta,
+        .idleKeepaliveMs = idleKeepaliveMs
+    };
+
+    Communication_UpdateReportingConfiguration(&configuration);
+}
+
+static void TestEveryPollIsSentByDefault(void) {
+    Setup(INPUT_REPORT_MODE_FULL, false, 0, 0);
+
+    EXPECT(WriteReport());
+    EXPECT(WriteReport());
+    EXPECT_EQ(reportId, INPUT_REPORT_ID);
+    EXPECT_EQ(reportSize, sizeof (InputHIDReport));
+}
+
+static void TestPackedSensorValues(void) {
+    Setup(INPUT_REPORT_MODE_PACKED_SENSORS, false, 0, 0);
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        PAD_STATE.sensorValues[i] = (i * 97 + 1000) % 1024;
+    }
+
+    WriteReport();
+    EXPECT_EQ(reportId, PACKED_SENSORS_INPUT_REPORT_ID);
+
+    const uint8_t* packed = ((PackedSensorsInputHIDReport*) report)->sensorValues;
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        // groups of 4 sensors take exactly 5 bytes, so stream is continuous.
+        int bit = i * 10;
+        uint16_t value = (packed[bit / 8] | (packed[bit / 8 + 1] << 8)) >> (bit % 8);
+        EXPECT_EQ(value & 0x3FF, PAD_STATE.sensorValues[i]);
+    }
+}
+
+static void TestUnchangedReportsAreSuppressed(void) {
+    Setup(INPUT_REPORT_MODE_FULL, true, 4, 0);
+
+    // first report after configuration change always goes out.
+    EXPECT(WriteReport());
+    EXPECT(!WriteReport());
+
+    // sensor noise within delta is not worth a report.
+    PAD_STATE.sensorValues[3] = 504;
+    EXPECT(!WriteReport());
+
+    PAD_STATE.sensorValues[3] = 505;
+    EXPECT(WriteReport());
+    EXPECT(!WriteReport());
+
+    // delta is measured against the last sent report, so slow drift is sent
+    // eventually.
+    PAD_STATE.sensorValues[3] = 508;
+    EXPECT(!WriteReport());
+    PAD_STATE.sensorValues[3] = 510;
+    EXPECT(WriteReport());
+}
+
+static void TestButtonEdgesAreSentRightAway(void) {
+    Setup(INPUT_REPORT_MODE_FULL, true, 255, 0);
+    WriteReport();
+
+    PAD_STATE.buttonsPressed = 1 << 2;
+    EXPECT(WriteReport());
+    EXPECT(!WriteReport());
+
+    PAD_STATE.buttonsPressed = 0;
+    EXPECT(WriteReport());
+}
+
+static void TestButtonsModeIgnoresSensors(void) {
+    Setup(INPUT_REPORT_MODE_BUTTONS, true, 0, 0);
+    WriteReport();
+
+    PAD_STATE.sensorValues[0] = 0;
+    EXPECT(!WriteReport());
+}
+
+static void TestIdleKeepalive(void) {
+    Setup(INPUT_REPORT_MODE_FULL, true, 255, 50);
+    WriteReport();
+
+    for (int i = 0; i < 49; i++) {
+        Communication_MillisecondElapsed();
+        EXPECT(!WriteReport());
+    }
+
+    Communication_MillisecondElapsed();
+    EXPECT(WriteReport());
+    EXPECT(!WriteReport());
+}
+
+static void UnpackSensorValues(const uint8_t* packed, uint16_t* values) {
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        int bit = i * 10;
+        values[i] = ((packed[bit / 8] | (packed[bit / 8 + 1] << 8)) >> (bit % 8)) & 0x3FF;
+    }
+}
+
+static void TestReportIntervalLimitsRate(void) {
+    Setup(INPUT_REPORT_MODE_FULL, false, 0, 0);
+
+    ReportingConfiguration configuration = REPORTING_CONF;
+    configuration.reportIntervalMs = 4;
+    Communication_UpdateReportingConfiguration(&configuration);
+
+    EXPECT(WriteReport());
+
+    // buttons wait as well, games read them from the gamepad interface.
+    PAD_STATE.buttonsPressed = 1 << 2;
+
+    for (int i = 0; i < 3; i++) {
+        Communication_MillisecondElapsed();
+        EXPECT(!WriteReport());
+    }
+
+    Communication_MillisecondElapsed();
+    EXPECT(WriteReport());
+    EXPECT(!WriteReport());
+}
+
+static void TestGamepadReportHasOnlyButtons(void) {
+    Setup(INPUT_REPORT_MODE_FULL, false, 0, 0);
+    PAD_STATE.buttonsPressed = (1 << 0) | (1 << 9);
+
+    GamepadHIDReport gamepadReport;
+    memset(&gamepadReport, 0xFF, sizeof (gamepadReport));
+    Communication_WriteGamepadHIDReport(&gamepadReport);
+
+    EXPECT_EQ(sizeof (GamepadHIDReport), 3);
+    EXPECT_EQ(gamepadReport.buttons[0], 0x01);
+    EXPECT_EQ(gamepadReport.buttons[1], 0x02);
+    EXPECT_EQ(gamepadReport.unusedAxis, 0);
+}
+
+static void TestBatchedReportsCarryEveryFrame(void) {
+    SimulatedHardware_Reset();
+    sei();
+    Telemetry_Init();
+    ADC_Init();
+    Setup(INPUT_REPORT_MODE_BATCHED_SENSORS, false, 0, 0);
+
+    // get rid of frames scanned before the test.
+    SimulatedHardware_Run(CYCLES_PER_MS);
+    WriteReport();
+
+    uint16_t expectedSequence = ADC_GetFrameCount();
+    int frames = 0;
+
+    for (int ms = 0; ms < 20; ms++) {
+        SimulatedHardware_SetSensorInput(4, 300 + ms * 20);
+        SimulatedHardware_Run(CYCLES_PER_MS);
+
+        EXPECT(WriteReport());
+        EXPECT_EQ(reportId, BATCHED_SENSORS_INPUT_REPORT_ID);
+
+        const BatchedSensorsInputHIDReport* batch = (const BatchedSensorsInputHIDReport*) report;
+        uint16_t values[SENSOR_COUNT];
+        uint16_t timestamp = batch->timestamp;
+
+        // nothing is skipped while host keeps polling every ms.
+        EXPECT_EQ(batch->sequence, expectedSequence);
+        EXPECT(batch->frameCount >= 1);
+        UnpackSensorValues(batch->sensorValues, values);
+
+        for (int f = 1; f < batch->frameCount; f++) {
+            const BatchedSensorsDeltaFrame* delta = &batch->deltaFrames[f - 1];
+            timestamp += delta->timeDelta * BATCHED_TIME_DELTA_TICKS;
+
+            for (int i = 0; i < SENSOR_COUNT; i++) {
+                values[i] += delta->sensorDeltas[i];
+            }
+        }
+
+        // last frame in the batch decodes to exactly what was scanned.
+        AdcFrame frame;
+        EXPECT(ADC_ReadBufferedFrame(batch->sequence + batch->frameCount - 1, &frame));
+        EXPECT(memcmp(values, frame.sensorValues, sizeof (values)) == 0);
+        EXPECT((int16_t) (timestamp - frame.timestamp) <= BATCHED_TIME_DELTA_TICKS / 2);
+        EXPECT((int16_t) (frame.timestamp - timestamp) <= BATCHED_TIME_DELTA_TICKS / 2);
+
+        expectedSequence = batch->sequence + batch->frameCount;
+        frames += batch->frameCount;
+    }
+
+    printf("  %d frames in 20 reports\n", frames);
+    EXPECT(frames > 20);
+}
+
+static void TestBatchedReportEndsOnLargeChange(void) {
+    SimulatedHardware_Reset();
+    sei();
+    ADC_Init();
+    Setup(INPUT_REPORT_MODE_BATCHED_SENSORS, false, 0, 0);
+
+    SimulatedHardware_Run(CYCLES_PER_MS);
+    WriteReport();
+
+    // a jump that doesn't fit to int8 starts a new report.
+    SimulatedHardware_SetSensorInput(0, 0);
+    SimulatedHardware_Run(2 * CYCLES_PER_MS);
+    SimulatedHardware_SetSensorInput(0, 1000);
+    SimulatedHardware_Run(CYCLES_PER_MS);
+
+    bool jumpSeen = false;
+
+    while (WriteReport() && ((const BatchedSensorsInputHIDReport*) report)->frameCount > 0) {
+        const BatchedSensorsInputHIDReport* batch = (const BatchedSensorsInputHIDReport*) report;
+        uint16_t values[SENSOR_COUNT];
+        UnpackSensorValues(batch->sensorValues, values);
+
+        if (values[0] == 1000) {
+            jumpSeen = true;
+        }
+
+        // jump can only be in the first frame, deltas can't carry it.
+        for (int f = 1; f < batch->frameCount; f++) {
+            EXPECT(batch->deltaFrames[f - 1].sensorDeltas[0] == 0);
+        }
+    }
+
+    EXPECT(jumpSeen);
+}
+
+// every sensor on button 0, without filters, so pad state follows inputs.
+static void SetupPad(uint8_t inputReportMode, bool peakSensorValues) {
+    SimulatedHardware_Reset();
+    sei();
+    Telemetry_Init();
+
+    static PadConfiguration profiles[PROFILE_COUNT];
+
+    for (int p = 0; p < PROFILE_COUNT; p++) {
+        for (int i = 0; i < SENSOR_COUNT; i++) {
+            profiles[p].sensorThresholds[i] = 1000;
+            profiles[p].sensorReleaseThresholds[i] = SENSOR_RELEASE_THRESHOLD(0.9);
+            profiles[p].sensorToButtonMapping[i] = 0;
+            profiles[p].sensorFilters[i] = SENSOR_FILTER(0, false, 0);
+        }
+    }
+
+    Setup(inputReportMode, false, 0, 0);
+    Pad_Initialize(profiles, 0);
+
+    ReportingConfiguration configuration = REPORTING_CONF;
+    configuration.peakSensorValues = peakSensorValues;
+    Communication_UpdateReportingConfiguration(&configuration);
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        SimulatedHardware_SetSensorInput(i, 500);
+    }
+}
+
+static void ScanSensor(uint8_t sensor, uint16_t value) {
+    SimulatedHardware_SetSensorInput(sensor, value);
+    SimulatedHardware_Run(2 * CYCLES_PER_MS);
+    Pad_UpdateState();
+}
+
+static void TestPeaksBetweenReports(void) {
+    SetupPad(INPUT_REPORT_MODE_PEAK_SENSORS, false);
+    ScanSensor(0, 500);
+    WriteReport();
+
+    // a tap and a dip that have come and gone by the time of the next report.
+    ScanSensor(3, 900);
+    ScanSensor(3, 200);
+    ScanSensor(3, 500);
+
+    const PeakSensorsInputHIDReport* peaks = (const PeakSensorsInputHIDReport*) report;
+    uint16_t values[SENSOR_COUNT], maxima[SENSOR_COUNT], minima[SENSOR_COUNT];
+
+    EXPECT(WriteReport());
+    EXPECT_EQ(reportId, PEAK_SENSORS_INPUT_REPORT_ID);
+    EXPECT_EQ(reportSize, sizeof (PeakSensorsInputHIDReport));
+    UnpackSensorValues(peaks->sensorValues, values);
+    UnpackSensorValues(peaks->sensorMaxima, maxima);
+    UnpackSensorValues(peaks->sensorMinima, minima);
+
+    EXPECT_EQ(values[3], 500);
+    EXPECT_EQ(maxima[3], 900);
+    EXPECT_EQ(minima[3], 200);
+    EXPECT_EQ(maxima[4], 500);
+    EXPECT_EQ(minima[4], 500);
+
+    // and they are gone from the one after that.
+    WriteReport();
+    UnpackSensorValues(peaks->sensorMaxima, maxima);
+    UnpackSensorValues(peaks->sensorMinima, minima);
+    EXPECT_EQ(maxima[3], 500);
+    EXPECT_EQ(minima[3], 500);
+}
+
+static void TestPeaksInsteadOfCurrentValues(void) {
+    SetupPad(INPUT_REPORT_MODE_PACKED_SENSORS, true);
+
+    ReportingConfiguration configuration = REPORTING_CONF;
+    configuration.changeDriven = true;
+    configuration.sensorChangeDelta = 4;
+    Communication_UpdateReportingConfiguration(&configuration);
+
+    ScanSensor(0, 500);
+    WriteReport();
+    EXPECT(!WriteReport());
+
+    // current value is back where it was, but the tap still gets sent.
+    ScanSensor(7, 800);
+    ScanSensor(7, 500);
+
+    uint16_t values[SENSOR_COUNT];
+    EXPECT(WriteReport());
+    UnpackSensorValues(((const PackedSensorsInputHIDReport*) report)->sensorValues, values);
+    EXPECT_EQ(values[7], 800);
+
+    // next one tells that it's over.
+    EXPECT(WriteReport());
+    UnpackSensorValues(((const PackedSensorsInputHIDReport*) report)->sensorValues, values);
+    EXPECT_EQ(values[7], 500);
+    EXPECT(!WriteReport());
+}
+
+static void TestTapBetweenReportsIsQueued(void) {
+    SetupPad(INPUT_REPORT_MODE_BUTTON_EVENTS, false);
+
+    ReportingConfiguration configuration = REPORTING_CONF;
+    configuration.changeDriven = true;
+    configuration.sensorChangeDelta = 255;
+    Communication_UpdateReportingConfiguration(&configuration);
+
+    ScanSensor(0, 500);
+    WriteReport();
+    EXPECT(!WriteReport());
+
+    // button is released again by the time of the next report, but both
+    // edges are still there.
+    ScanSensor(2, 1010);
+    ScanSensor(2, 500);
+
+    const ButtonEventsInputHIDReport* events = (const ButtonEventsInputHIDReport*) report;
+
+    EXPECT(WriteReport());
+    EXPECT_EQ(reportId, BUTTON_EVENTS_INPUT_REPORT_ID);
+    EXPECT_EQ(reportSize, sizeof (ButtonEventsInputHIDReport));
+    EXPECT_EQ(events->buttons[0], 0);
+    EXPECT_EQ(events->eventCount, 2);
+    EXPECT_EQ(events->droppedEvents, 0);
+    EXPECT_EQ(events->events[0].button, 0 | BUTTON_EVENT_PRESSED);
+    EXPECT_EQ(events->events[1].button, 0);
+
+    // scans are 2 ms apart, give or take a frame, and both happened before
+    // the report.
+    uint16_t between = events->events[1].timestamp - events->events[0].timestamp;
+    uint16_t age = events->timestamp - events->events[1].timestamp;
+    EXPECT(between >= 1700 * TELEMETRY_TICKS_PER_US && between <= 2300 * TELEMETRY_TICKS_PER_US);
+    EXPECT(age < 2100 * TELEMETRY_TICKS_PER_US);
+
+    EXPECT(!WriteReport());
+}
+
+static void TestButtonEventOverflow(void) {
+    SetupPad(INPUT_REPORT_MODE_BUTTON_EVENTS, false);
+    ScanSensor(0, 500);
+    WriteReport();
+
+    // more taps than the queue holds.
+    for (int i = 0; i < BUTTON_EVENT_QUEUE_SIZE / 2 + 1; i++) {
+        ScanSensor(0, 1010);
+        ScanSensor(0, 500);
+    }
+
+    const ButtonEventsInputHIDReport* events = (const ButtonEventsInputHIDReport*) report;
+    int received = 0;
+
+    while (WriteReport() && events->eventCount > 0) {
+        EXPECT_EQ(events->droppedEvents, 2);
+
+        for (int i = 0; i < events->eventCount; i++, received++) {
+            EXPECT_EQ(events->events[i].button, received % 2 == 0 ? BUTTON_EVENT_PRESSED : 0);
+        }
+    }
+
+    EXPECT_EQ(received, BUTTON_EVENT_QUEUE_SIZE);
+}
+
+static void TestButtonEventsOnlyInTheirMode(void) {
+    SetupPad(INPUT_REPORT_MODE_FULL, false);
+
+    // more taps than the queue holds, while nothing reads the queue.
+    for (int i = 0; i < BUTTON_EVENT_QUEUE_SIZE; i++) {
+        ScanSensor(0, 1010);
+        ScanSensor(0, 500);
+    }
+
+    ReportingConfiguration configuration = REPORTING_CONF;
+    configuration.inputReportMode = INPUT_REPORT_MODE_BUTTON_EVENTS;
+    Communication_UpdateReportingConfiguration(&configuration);
+
+    const ButtonEventsInputHIDReport* events = (const ButtonEventsInputHIDReport*) report;
+
+    EXPECT(WriteReport());
+    EXPECT_EQ(reportId, BUTTON_EVENTS_INPUT_REPORT_ID);
+    EXPECT_EQ(events->eventCount, 0);
+    EXPECT_EQ(events->droppedEvents, 0);
+
+    // events left unread are gone once the mode is changed back and forth.
+    ScanSensor(0, 1010);
+    configuration.inputReportMode = INPUT_REPORT_MODE_BUTTONS;
+    Communication_UpdateReportingConfiguration(&configuration);
+    configuration.inputReportMode = INPUT_REPORT_MODE_BUTTON_EVENTS;
+    Communication_UpdateReportingConfiguration(&configuration);
+
+    EXPECT(WriteReport());
+    EXPECT_EQ(events->eventCount, 0);
+    EXPECT_EQ(events->buttons[0], 1);
+
+    ScanSensor(0, 500);
+    EXPECT(WriteReport());
+    EXPECT_EQ(events->eventCount, 1);
+    EXPECT_EQ(events->events[0].button, 0);
+}
+
+int main(void) {
+    RUN_TEST(TestEveryPollIsSentByDefault);
+    RUN_TEST(TestPackedSensorValues);
+    RUN_TEST(TestUnchangedReportsAreSuppressed);
+    RUN_TEST(TestButtonEdgesAreSentRightAway);
+    RUN_TEST(TestButtonsModeIgnoresSensors);
+    RUN_TEST(TestIdleKeepalive);
+    RUN_TEST(TestReportIntervalLimitsRate);
+    RUN_TEST(TestGamepadReportHasOnlyButtons);
+    RUN_TEST(TestBatchedReportsCarryEveryFrame);
+    RUN_TEST(TestBatchedReportEndsOnLargeChange);
+    RUN_TEST(TestPeaksBetweenReports);
+    RUN_TEST(TestPeaksInsteadOfCurrentValues);
+    RUN_TEST(TestTapBetweenReportsIsQueued);
+    RUN_TEST(TestButtonEventOverflow);
+    RUN_TEST(TestButtonEventsOnlyInTheirMode);
+    return TEST_RESULT();
+}
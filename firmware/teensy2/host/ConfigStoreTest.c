@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <string.h>
+#include <avr/interrupt.h>
+
+#include "Config/DancePadConfig.h"
+#include "ADC.h"
+#include "ConfigStore.h"
+#include "SimulatedHardware.h"
+#include "TestUtil.h"
+
+#define CYCLES_PER_MS (SIMULATED_F_CPU / 1000)
+
+// long enough for any store to finish, even if every byte has changed.
+#define STORE_TIMEOUT_MS 2000
+
+static void Boot(Configuration* conf) {
+    sei();
+    ConfigStore_LoadConfiguration(conf);
+}
+
+static void CreateConfiguration(Configuration* conf, uint16_t threshold, const char* name) {
+    memset(conf, 0, sizeof (Configuration));
+
+    for (int profile = 0; profile < PROFILE_COUNT; profile++) {
+        for (int i = 0; i < SENSOR_COUNT; i++) {
+            conf->profiles[profile].sensorThresholds[i] = threshold + profile * 10 + i;
+            conf->profiles[profile].sensorReleaseThresholds[i] = SENSOR_RELEASE_THRESHOLD(0.75);
+            conf->profiles[profile].sensorToButtonMapping[i] = i;
+        }
+    }
+
+    conf->activeProfile = threshold % PROFILE_COUNT;
+
+    conf->nameAndSize.size = strlen(name);
+    strcpy(conf->nameAndSize.name, name);
+}
+
+static int StoreAndWait(const Configuration* conf) {
+    int ms = 0;
+
+    ConfigStore_StoreConfiguration(conf);
+
+    while (ConfigStore_IsStoring() && ms < STORE_TIMEOUT_MS) {
+        SimulatedHardware_Run(CYCLES_PER_MS);
+        ms++;
+    }
+
+    EXPECT(!ConfigStore_IsStoring());
+    return ms;
+}
+
+static void TestDefaultConfigurationWhenNothingStored(void) {
+    SimulatedHardware_Reset();
+
+    Configuration conf;
+    Boot(&conf);
+
+    EXPECT(memcmp(conf.nameAndSize.name, "Untitled Pad Device", conf.nameAndSize.size) == 0);
+}
+
+static void TestStoredConfigurationSurvivesPowerCycle(void) {
+    SimulatedHardware_Reset();
+
+    Configuration conf, stored, loaded;
+    Boot(&conf);
+
+    CreateConfiguration(&stored, 300, "first");
+    StoreAndWait(&stored);
+
+    SimulatedHardware_PowerCycle();
+    Boot(&loaded);
+    EXPECT(memcmp(&loaded, &stored, sizeof (Configuration)) == 0);
+
+    // and newer one wins over older one.
+    CreateConfiguration(&stored, 500, "second");
+    StoreAndWait(&stored);
+
+    SimulatedHardware_PowerCycle();
+    Boot(&loaded);
+    EXPECT(memcmp(&loaded, &stored, sizeof (Configuration)) == 0);
+}
+
+static void TestScanningContinuesWhileStoring(void) {
+    SimulatedHardware_Reset();
+
+    Configuration conf, stored;
+    Boot(&conf);
+    ADC_Init();
+
+    CreateConfiguration(&stored, 300, "scanning");
+
+    uint16_t framesBefore = ADC_GetFrameCount();
+    int ms = StoreAndWait(&stored);
+    uint16_t frames = ADC_GetFrameCount() - framesBefore;
+
+    printf("  storing took %d ms, %u frames scanned meanwhile\n", ms, frames);
+    EXPECT(ms > 100);
+    EXPECT(frames > ms);
+}
+
+static void TestPowerCutWhileStoringKeepsEitherConfiguration(void) {
+    Configuration conf, old, new, loaded;
+    CreateConfiguration(&old, 300, "old");
+    CreateConfiguration(&new, 700, "new one");
+
+    // cut power at every possible moment of storing, including after it has
+    // finished.
+    for (int cutAtMs = 0; ; cutAtMs++) {
+        SimulatedHardware_Reset();
+        Boot(&conf);
+        StoreAndWait(&old);
+
+        ConfigStore_StoreConfiguration(&new);
+        SimulatedHardware_Run((uint64_t) cutAtMs * CYCLES_PER_MS);
+        bool finished = !ConfigStore_IsStoring();
+
+        SimulatedHardware_PowerCycle();
+        Boot(&loaded);
+
+        if (finished) {
+            EXPECT(memcmp(&loaded, &new, sizeof (Configuration)) == 0);
+            break;
+        }
+
+        EXPECT(memcmp(&loaded, &old, sizeof (Configuration)) == 0);
+        EXPECT(cutAtMs < STORE_TIMEOUT_MS);
+    }
+}
+
+static void TestCorruptSlotIsIgnored(void) {
+    SimulatedHardware_Reset();
+
+    Configuration conf, first, second, loaded;
+    Boot(&conf);
+
+    CreateConfiguration(&first, 300, "first");
+    StoreAndWait(&first);
+    CreateConfiguration(&second, 500, "second");
+    StoreAndWait(&second);
+
+    // flip a bit somewhere in the newest slot.
+    for (int i = 0; i <= E2END; i++) {
+        if (SimulatedHardware_EEPROM[i] == 's' && SimulatedHardware_EEPROM[i + 1] == 'e') {
+            SimulatedHardware_EEPROM[i] ^= 0x10;
+            break;
+        }
+    }
+
+    SimulatedHardware_PowerCycle();
+    Boot(&loaded);
+    EXPECT(memcmp(&loaded, &first, sizeof (Configuration)) == 0);
+}
+
+static void TestWritesAreSpreadOverEEPROM(void) {
+    SimulatedHardware_Reset();
+
+    Configuration conf, stored;
+    Boot(&conf);
+
+    const int stores = 64;
+
+    for (int i = 0; i < stores; i++) {
+        CreateConfiguration(&stored, 300 + i, i % 2 ? "odd" : "even");
+        StoreAndWait(&stored);
+    }
+
+    uint32_t maxWrites = 0;
+
+    for (int i = 0; i <= E2END; i++) {
+        if (SimulatedHardware_EEPROMWriteCounts[i] > maxWrites) {
+            maxWrites = SimulatedHardware_EEPROMWriteCounts[i];
+        }
+    }
+
+    printf("  %d stores, most written byte was written %u times\n", stores, maxWrites);
+    EXPECT(maxWrites <= stores / 2);
+
+    SimulatedHardware_PowerCycle();
+    Boot(&conf);
+    EXPECT(memcmp(&conf, &stored, sizeof (Configuration)) == 0);
+}
+
+static void TestStoringAgainWhileStoring(void) {
+    SimulatedHardware_Reset();
+
+    Configuration conf, first, second, loaded;
+    Boot(&conf);
+
+    CreateConfiguration(&first, 300, "first");
+    CreateConfiguration(&second, 500, "second");
+
+    ConfigStore_StoreConfiguration(&first);
+    SimulatedHardware_Run(20 * CYCLES_PER_MS);
+    StoreAndWait(&second);
+
+    SimulatedHardware_PowerCycle();
+    Boot(&loaded);
+    EXPECT(memcmp(&loaded, &second, sizeof (Configuration)) == 0);
+}
+
+// configuration is read while it's being stored, so a change meanwhile has
+// to start storing over.
+static void TestChangingWhileStoringStoresLatest(void) {
+    SimulatedHardware_Reset();
+
+    Configuration conf, stored, loaded;
+    Boot(&conf);
+
+    CreateConfiguration(&stored, 300, "before");
+    ConfigStore_StoreConfiguration(&stored);
+    SimulatedHardware_Run(200 * CYCLES_PER_MS);
+    EXPECT(ConfigStore_IsStoring());
+
+    // something early in the slot, which has been written already.
+    stored.profiles[0].sensorThresholds[0] = 1000;
+    strcpy(stored.nameAndSize.name, "after!");
+    StoreAndWait(&stored);
+
+    SimulatedHardware_PowerCycle();
+    Boot(&loaded);
+    EXPECT(memcmp(&loaded, &stored, sizeof (Configuration)) == 0);
+}
+
+int main(void) {
+    RUN_TEST(TestDefaultConfigurationWhenNothingStored);
+    RUN_TEST(TestStoredConfigurationSurvivesPowerCycle);
+    RUN_TEST(TestScanningContinuesWhileStoring);
+    RUN_TEST(TestPowerCutWhileStoringKeepsEitherConfiguration);
+    RUN_TEST(TestCorruptSlotIsIgnored);
+    RUN_TEST(TestWritesAreSpreadOverEEPROM);
+    RUN_TEST(TestStoringAgainWhileStoring);
+    RUN_TEST(TestChangingWhileStoringStoresLatest);
+    return TEST_RESULT();
+}
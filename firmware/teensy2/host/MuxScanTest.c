@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <avr/interrupt.h>
+
+#include "Config/DancePadConfig.h"
+#include "ADC.h"
+#include "Pad.h"
+#include "SimulatedHardware.h"
+#include "Telemetry.h"
+#include "TestUtil.h"
+
+// built with muxes enabled, see makefile.
+#if ADC_MUX_COUNT == 0
+    #error "MuxScanTest needs firmware built with ADC_MUX_COUNT"
+#endif
+
+#define CYCLES_PER_MS (SIMULATED_F_CPU / 1000)
+#define CYCLES_PER_US (SIMULATED_F_CPU / 1000000)
+
+// prescaler 64, 13 ADC clocks per conversion.
+#define CYCLES_PER_CONVERSION (13 * 64)
+
+static const uint8_t MUX_SETTLE_US[ADC_MUX_COUNT] = ADC_MUX_SETTLE_US;
+
+static uint16_t SensorValue(uint8_t sensor) {
+    return 10 + sensor * 20;
+}
+
+// muxes settle exactly as slowly as firmware is told they do.
+static void Setup(void) {
+    SimulatedHardware_Reset();
+
+    for (uint8_t mux = 0; mux < ADC_MUX_COUNT; mux++) {
+        uint8_t channel = SimulatedHardware_SensorToChannel(mux);
+        SimulatedHardware_ConnectMux(channel, ADC_MUX_SELECT_SHIFT, __builtin_ctz(ADC_MUX_CHANNELS), MUX_SETTLE_US[mux] * CYCLES_PER_US);
+
+        for (uint8_t input = 0; input < ADC_MUX_CHANNELS; input++) {
+            SimulatedHardware_SetMuxInput(channel, input, SensorValue(mux * ADC_MUX_CHANNELS + input));
+        }
+    }
+
+    Telemetry_Init();
+    sei();
+}
+
+static void TestEverySensorReadsItsOwnInput(void) {
+    Setup();
+    ADC_Init();
+
+    SimulatedHardware_Run(10 * CYCLES_PER_MS);
+
+    uint16_t values[SENSOR_COUNT];
+    EXPECT(ADC_ReadFrame(values));
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        EXPECT_EQ(values[i], SensorValue(i));
+    }
+}
+
+// select lines change while the ADC converts, so it never waits for muxes.
+static void TestMuxesSettleDuringConversions(void) {
+    Setup();
+    ADC_Init();
+
+    SimulatedHardware_Run(CYCLES_PER_MS);
+    uint64_t conversionsBefore = SimulatedHardware_GetConversionCount();
+    SimulatedHardware_Run(100 * CYCLES_PER_MS);
+    uint64_t conversions = SimulatedHardware_GetConversionCount() - conversionsBefore;
+
+    printf("  %u conversions in 100 ms\n", (unsigned) conversions);
+    EXPECT(conversions >= 100 * CYCLES_PER_MS / CYCLES_PER_CONVERSION - 1);
+}
+
+// with a fast ADC, conversions are shorter than the slow mux takes to settle.
+// ISR doesn't spin for it, timer interrupt starts the conversion later.
+static void TestSlowMuxIsNotWaitedInInterrupt(void) {
+    Setup();
+    ADC_Init();
+
+    AdcSpeedSettings speed = { .prescaler = 2, .highSpeed = true, .eightBit = false };
+    EXPECT(ADC_SetSpeed(&speed));
+
+    // inputs of the slow mux only, so select lines change for every one.
+    AdcSchedule schedule = { .sensors = { 0, 1, 2, 3 }, .sensorCount = 4, .idleSensorCount = 0 };
+    ADC_SetSchedule(&schedule);
+
+    SimulatedHardware_Run(CYCLES_PER_MS);
+    uint64_t stalledBefore = SimulatedHardware_GetStalledCycles();
+    uint16_t framesBefore = ADC_GetFrameCount();
+    SimulatedHardware_Run(10 * CYCLES_PER_MS);
+
+    uint64_t stalled = SimulatedHardware_GetStalledCycles() - stalledBefore;
+    uint16_t frames = ADC_GetFrameCount() - framesBefore;
+    printf("  %u frames, %u cycles spun in 10 ms\n", (unsigned) frames, (unsigned) stalled);
+
+    // every conversion waits for the mux, but not by spinning.
+    EXPECT(frames <= 10 * 1000 / (4 * MUX_SETTLE_US[0]) + 1);
+    EXPECT(stalled < frames * 4 * 16);
+
+    uint16_t values[SENSOR_COUNT];
+    EXPECT(ADC_ReadFrame(values));
+
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(values[i], SensorValue(i));
+    }
+}
+
+static void TestScheduleInAnyOrder(void) {
+    Setup();
+    ADC_Init();
+
+    // two of them behind the same mux input.
+    const uint8_t last = SENSOR_COUNT - 1;
+    const uint8_t shared = ADC_MUX_CHANNELS + 3;
+    AdcSchedule schedule = { .sensors = { last, 3, ADC_MUX_CHANNELS, shared }, .sensorCount = 4, .idleSensorCount = 0 };
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        if (i != last && i != 3 && i != ADC_MUX_CHANNELS && i != shared) {
+            schedule.idleSensors[schedule.idleSensorCount++] = i;
+        }
+    }
+
+    ADC_SetSchedule(&schedule);
+
+    // long enough for every idle sensor to be converted once.
+    SimulatedHardware_Run(300 * CYCLES_PER_MS);
+
+    uint16_t values[SENSOR_COUNT];
+    EXPECT(ADC_ReadFrame(values));
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        EXPECT_EQ(values[i], SensorValue(i));
+    }
+}
+
+static void TestPadWithMuxedSensors(void) {
+    Setup();
+
+    static PadConfiguration profiles[PROFILE_COUNT];
+
+    for (int p = 0; p < PROFILE_COUNT; p++) {
+        for (int i = 0; i < SENSOR_COUNT; i++) {
+            profiles[p].sensorThresholds[i] = 1000;
+            profiles[p].sensorReleaseThresholds[i] = SENSOR_RELEASE_THRESHOLD(0.9);
+            profiles[p].sensorToButtonMapping[i] = -1;
+            profiles[p].sensorFilters[i] = SENSOR_FILTER(0, false, 0);
+        }
+
+        // last sensor of the last mux.
+        profiles[p].sensorToButtonMapping[SENSOR_COUNT - 1] = 2;
+    }
+
+    Pad_Initialize(profiles, 0);
+
+    uint8_t channel = SimulatedHardware_SensorToChannel(ADC_MUX_COUNT - 1);
+    SimulatedHardware_SetMuxInput(channel, ADC_MUX_CHANNELS - 1, 1010);
+
+    for (int i = 0; i < 20; i++) {
+        SimulatedHardware_Run(CYCLES_PER_MS);
+        Pad_UpdateState();
+    }
+
+    EXPECT(PAD_STATE.buttonsPressed == (1 << 2));
+    EXPECT_EQ(PAD_STATE.sensorValues[SENSOR_COUNT - 1], 1010);
+}
+
+int main(void) {
+    RUN_TEST(TestEverySensorReadsItsOwnInput);
+    RUN_TEST(TestMuxesSettleDuringConversions);
+    RUN_TEST(TestSlowMuxIsNotWaitedInInterrupt);
+    RUN_TEST(TestScheduleInAnyOrder);
+    RUN_TEST(TestPadWithMuxedSensors);
+    return TEST_RESULT();
+}
@@ -0,0 +1,510 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <avr/interrupt.h>
+
+#include "Config/DancePadConfig.h"
+#include "ADC.h"
+#include "Pad.h"
+#include "Linearization.h"
+#include "SimulatedHardware.h"
+#include "Telemetry.h"
+#include "TestUtil.h"
+
+#define CYCLES_PER_MS (SIMULATED_F_CPU / 1000)
+
+// second profile has sensor 1 on a different button, and a higher threshold.
+#define TEST_PROFILE { \
+    .sensorThresholds = { [0 ... SENSOR_COUNT - 1] = 400 }, \
+    .sensorReleaseThresholds = { [0 ... SENSOR_COUNT - 1] = SENSOR_RELEASE_THRESHOLD(0.9) }, \
+    .sensorToButtonMapping = { 0, 0, -1, -1, -1, 3, -1, -1, -1, -1, -1, -1 }, \
+    .sensorFilters = { [0 ... SENSOR_COUNT - 1] = SENSOR_FILTER(1, false, 0) } \
+}
+
+static const PadConfiguration TEST_PROFILES[PROFILE_COUNT] = {
+    [0] = TEST_PROFILE,
+    [2 ... PROFILE_COUNT - 1] = TEST_PROFILE,
+    [1] = {
+        .sensorThresholds = { [0 ... SENSOR_COUNT - 1] = 900 },
+        .sensorReleaseThresholds = { [0 ... SENSOR_COUNT - 1] = SENSOR_RELEASE_THRESHOLD(0.9) },
+        .sensorToButtonMapping = { 5, 5, -1, -1, -1, 3, -1, -1, -1, -1, -1, -1 },
+        .sensorFilters = { [0 ... SENSOR_COUNT - 1] = SENSOR_FILTER(0, false, 0) }
+    }
+};
+
+static void Setup(void) {
+    SimulatedHardware_Reset();
+    sei();
+}
+
+static void TestFramesContainAllSensors(void) {
+    Setup();
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        SimulatedHardware_SetSensorInput(i, 100 + i);
+    }
+
+    ADC_Init();
+
+    uint16_t values[SENSOR_COUNT];
+    EXPECT(!ADC_ReadFrame(values));
+
+    SimulatedHardware_Run(CYCLES_PER_MS);
+    EXPECT(ADC_ReadFrame(values));
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        EXPECT_EQ(values[i], 100 + i);
+    }
+
+    // same frame is not handed out twice.
+    EXPECT(!ADC_ReadFrame(values));
+}
+
+static void TestScanRateIsAboveOneKilohertz(void) {
+    Setup();
+    ADC_Init();
+
+    uint16_t framesBefore = ADC_GetFrameCount();
+    SimulatedHardware_Run(100 * CYCLES_PER_MS);
+    uint16_t frames = ADC_GetFrameCount() - framesBefore;
+
+    printf("  %u frames in 100 ms (%u conversions)\n", frames, (unsigned) SimulatedHardware_GetConversionCount());
+    EXPECT(frames > 100);
+}
+
+static void TestLatestFrameWins(void) {
+    Setup();
+    SimulatedHardware_SetSensorInput(0, 10);
+    ADC_Init();
+
+    SimulatedHardware_Run(CYCLES_PER_MS);
+    SimulatedHardware_SetSensorInput(0, 20);
+    SimulatedHardware_Run(CYCLES_PER_MS);
+
+    uint16_t values[SENSOR_COUNT];
+    EXPECT(ADC_ReadFrame(values));
+    EXPECT_EQ(values[0], 20);
+}
+
+static void TestPadFollowsScanningWithoutPolling(void) {
+    Setup();
+    Pad_Initialize(TEST_PROFILES, 0);
+
+    SimulatedHardware_SetSensorInput(1, 800);
+    SimulatedHardware_SetSensorInput(5, 200);
+
+    for (int i = 0; i < 10; i++) {
+        SimulatedHardware_Run(CYCLES_PER_MS);
+        Pad_UpdateState();
+    }
+
+    EXPECT(PAD_STATE.buttonsPressed & (1 << 0));
+    EXPECT(!(PAD_STATE.buttonsPressed & (1 << 3)));
+
+    SimulatedHardware_SetSensorInput(1, 0);
+
+    for (int i = 0; i < 10; i++) {
+        SimulatedHardware_Run(CYCLES_PER_MS);
+        Pad_UpdateState();
+    }
+
+    EXPECT(!(PAD_STATE.buttonsPressed & (1 << 0)));
+}
+
+static void TestBufferedFramesKeepHistory(void) {
+    Setup();
+    Telemetry_Init();
+    ADC_Init();
+
+    AdcFrame previous, frame;
+
+    // slots that haven't been scanned to yet don't count.
+    EXPECT(!ADC_ReadBufferedFrame(ADC_GetFrameCount() - 1, &frame));
+    SimulatedHardware_Run(4 * CYCLES_PER_MS);
+
+    for (int i = 0; i < 4; i++) {
+        SimulatedHardware_SetSensorInput(2, 100 * i);
+        SimulatedHardware_Run(CYCLES_PER_MS);
+    }
+
+    uint16_t frameCount = ADC_GetFrameCount();
+
+    // frame that is being scanned right now isn't available yet, nor are the
+    // ones that have been overwritten already.
+    EXPECT(!ADC_ReadBufferedFrame(frameCount, &frame));
+    EXPECT(!ADC_ReadBufferedFrame(frameCount - ADC_FRAME_BUFFER_SIZE, &frame));
+
+    EXPECT(ADC_ReadBufferedFrame(frameCount - ADC_FRAME_BUFFER_SIZE + 1, &previous));
+
+    for (uint16_t sequence = frameCount - ADC_FRAME_BUFFER_SIZE + 2; sequence != frameCount; sequence++) {
+        EXPECT(ADC_ReadBufferedFrame(sequence, &frame));
+        EXPECT(frame.sensorValues[2] >= previous.sensorValues[2]);
+        EXPECT((uint16_t) (frame.timestamp - previous.timestamp) > 0);
+        previous = frame;
+    }
+
+    EXPECT_EQ(previous.sensorValues[2], 300);
+}
+
+static void RunScans(int count) {
+    for (int i = 0; i < count; i++) {
+        uint16_t frameCount = ADC_GetFrameCount();
+
+        while (ADC_GetFrameCount() == frameCount) {
+            SimulatedHardware_Run(100);
+        }
+
+        Pad_UpdateState();
+    }
+}
+
+static void TestProfileSwitchTakesOneScan(void) {
+    Setup();
+    Pad_Initialize(TEST_PROFILES, 0);
+
+    SimulatedHardware_SetSensorInput(1, 800);
+    RunScans(10);
+    EXPECT(PAD_STATE.buttonsPressed == (1 << 0));
+
+    Pad_SelectProfile(1, &TEST_PROFILES[1]);
+    EXPECT_EQ(Pad_GetActiveProfile(), 1);
+
+    // 800 is below threshold of the second profile.
+    RunScans(1);
+    EXPECT(PAD_STATE.buttonsPressed == 0);
+
+    SimulatedHardware_SetSensorInput(1, 1000);
+    RunScans(2);
+    EXPECT(PAD_STATE.buttonsPressed == (1 << 5));
+
+    // out of range profile is ignored.
+    Pad_SelectProfile(PROFILE_COUNT, &TEST_PROFILES[0]);
+    EXPECT_EQ(Pad_GetActiveProfile(), 1);
+
+    Pad_SelectProfile(0, &TEST_PROFILES[0]);
+    RunScans(1);
+    EXPECT(PAD_STATE.buttonsPressed == (1 << 0));
+}
+
+static void TestLinearizedThresholds(void) {
+    Setup();
+    Pad_Initialize(TEST_PROFILES, 0);
+
+    PadConfiguration profile = TEST_PROFILES[1];
+    profile.sensorThresholds[1] = 170;
+    profile.flags = PAD_CONFIGURATION_LINEARIZED_THRESHOLDS;
+    Pad_SelectProfile(2, &profile);
+
+    // highest raw value that is at most 170 when linearized doesn't press yet.
+    uint16_t rawThreshold = Linearization_Delinearize(170);
+    EXPECT(Linearization_Linearize(rawThreshold) <= 170);
+    EXPECT(Linearization_Linearize(rawThreshold + 1) > 170);
+
+    SimulatedHardware_SetSensorInput(1, rawThreshold);
+    RunScans(2);
+    EXPECT(PAD_STATE.buttonsPressed == 0);
+
+    SimulatedHardware_SetSensorInput(1, rawThreshold + 1);
+    RunScans(1);
+    EXPECT(PAD_STATE.buttonsPressed == (1 << 5));
+}
+
+// drift steps only move thresholds, filters keep their history.
+static void TestSetThresholdsKeepsFilters(void) {
+    Setup();
+    Pad_Initialize(TEST_PROFILES, 0);
+
+    PadConfiguration profile = TEST_PROFILES[0];
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        profile.sensorFilters[i] = SENSOR_FILTER(0, true, 0);
+    }
+
+    Pad_SelectProfile(2, &profile);
+
+    SimulatedHardware_SetSensorInput(1, 100);
+    RunScans(3);
+
+    // single sample is filtered out by median of 3.
+    SimulatedHardware_SetSensorInput(1, 800);
+    RunScans(1);
+    EXPECT_EQ(PAD_STATE.sensorValues[1], 100);
+
+    profile.sensorThresholds[1] = 900;
+    Pad_SetThresholds(2, &profile);
+
+    // second sample makes it through, but doesn't reach the new threshold.
+    RunScans(1);
+    EXPECT_EQ(PAD_STATE.sensorValues[1], 800);
+    EXPECT(PAD_STATE.buttonsPressed == 0);
+}
+
+static void TestUnmappedSensorsAreScannedRarely(void) {
+    Setup();
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        SimulatedHardware_SetSensorInput(i, 300);
+    }
+
+    // only sensors 0, 1 and 5 are mapped to buttons.
+    Pad_Initialize(TEST_PROFILES, 0);
+
+    SimulatedHardware_Run(CYCLES_PER_MS);
+    uint16_t framesBefore = ADC_GetFrameCount();
+    SimulatedHardware_Run(100 * CYCLES_PER_MS);
+    uint16_t frames = ADC_GetFrameCount() - framesBefore;
+
+    printf("  %u frames in 100 ms\n", frames);
+    EXPECT(frames > 400);
+
+    // every unmapped sensor gets its turn eventually, and keeps its value in
+    // every frame in between.
+    SimulatedHardware_SetSensorInput(2, 500);
+    SimulatedHardware_Run(300 * CYCLES_PER_MS);
+
+    uint16_t frameCount = ADC_GetFrameCount();
+    AdcFrame frame;
+
+    for (uint16_t sequence = frameCount - ADC_FRAME_BUFFER_SIZE + 1; sequence != frameCount; sequence++) {
+        EXPECT(ADC_ReadBufferedFrame(sequence, &frame));
+        EXPECT_EQ(frame.sensorValues[2], 500);
+        EXPECT_EQ(frame.sensorValues[7], 300);
+        EXPECT_EQ(frame.sensorValues[5], 300);
+    }
+}
+
+// start of frame every 1 ms, at some point of scanning. frame that completes
+// last before the deadline completes right at it, idle sensor or not.
+static void TestFramesLockToStartOfFrame(void) {
+    Setup();
+    Telemetry_Init();
+
+    // only sensors 0, 1 and 5 are mapped, so several frames fit in 1 ms.
+    Pad_Initialize(TEST_PROFILES, 0);
+    uint16_t initialFrames = ADC_GetFrameCount();
+
+    uint16_t deadline = 700 * TELEMETRY_TICKS_PER_US;
+    ADC_SetFrameDeadline(deadline);
+    SimulatedHardware_Run(CYCLES_PER_MS / 3);
+
+    uint16_t framesBefore = ADC_GetFrameCount();
+    uint16_t worstMiss = 0;
+
+    for (int ms = 0; ms < 100; ms++) {
+        uint16_t startOfFrame = Telemetry_Now();
+        ADC_StartOfFrame(startOfFrame);
+        SimulatedHardware_Run(CYCLES_PER_MS);
+
+        // locking takes a frame or two once frames both with and without an
+        // idle sensor have been timed.
+        if (ms < 2 || (uint16_t) (ADC_GetFrameCount() - initialFrames) < 2 * ADC_IDLE_SENSOR_INTERVAL) {
+            continue;
+        }
+
+        uint16_t frameCount = ADC_GetFrameCount();
+        uint16_t miss = UINT16_MAX;
+        AdcFrame frame;
+
+        for (uint16_t sequence = frameCount - ADC_FRAME_BUFFER_SIZE + 1; sequence != frameCount; sequence++) {
+            if (!ADC_ReadBufferedFrame(sequence, &frame)) {
+                continue;
+            }
+
+            // frames before this start of frame wrap around to large values.
+            uint16_t completed = frame.timestamp - startOfFrame;
+
+            if (completed <= deadline) {
+                miss = deadline - completed;
+            }
+        }
+
+        if (miss > worstMiss) {
+            worstMiss = miss;
+        }
+    }
+
+    uint16_t frames = ADC_GetFrameCount() - framesBefore;
+    printf("  %u frames in 100 ms, last frame before deadline at most %u ticks early\n", frames, worstMiss);
+    EXPECT(worstMiss <= 2);
+
+    // pausing costs at most one frame per 1 ms.
+    EXPECT(frames > 300);
+}
+
+static void TestCaptureConvertsBackToBack(void) {
+    Setup();
+    Telemetry_Init();
+    ADC_Init();
+
+    SimulatedHardware_SetSensorInput(2, 512);
+    SimulatedHardware_SetSensorInput(5, 1000);
+    SimulatedHardware_Run(CYCLES_PER_MS);
+
+    AdcCaptureSettings settings = { .sensors = { 2, 5 }, .sensorCount = 2, .sampleCount = 50 };
+    EXPECT(ADC_StartCapture(&settings));
+
+    uint16_t values[SENSOR_COUNT];
+    ADC_ReadFrame(values);
+    SimulatedHardware_Run(5 * CYCLES_PER_MS);
+
+    // no frames while capturing.
+    EXPECT(!ADC_ReadFrame(values));
+
+    AdcCaptureStatus status;
+    ADC_GetCaptureStatus(&status);
+    EXPECT_EQ(status.state, ADC_CAPTURE_DONE);
+    EXPECT_EQ(status.sampleCount, 50);
+    EXPECT_EQ(status.triggerPosition, 0);
+
+    // 13 us per conversion, two conversions per sample.
+    uint16_t sampleTicks = status.durationTicks / (status.sampleCount - 1);
+    printf("  %u ticks per sample of 2 sensors\n", sampleTicks);
+    EXPECT_EQ(sampleTicks, 2 * 13 * TELEMETRY_TICKS_PER_US);
+
+    uint8_t samples[100];
+    EXPECT_EQ(ADC_ReadCapture(0, samples, 64), 64);
+    EXPECT_EQ(ADC_ReadCapture(64, samples + 64, 64), 36);
+
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(samples[i], i % 2 == 0 ? 512 >> 2 : 1000 >> 2);
+    }
+
+    // scanning picks up with full precision.
+    ADC_StopCapture();
+    SimulatedHardware_Run(2 * CYCLES_PER_MS);
+    EXPECT(ADC_ReadFrame(values));
+    EXPECT_EQ(values[2], 512);
+    EXPECT_EQ(values[5], 1000);
+}
+
+static void TestSpeedChangesBetweenFrames(void) {
+    Setup();
+    Telemetry_Init();
+    SimulatedHardware_SetSensorInput(3, 0x1FF);
+    ADC_Init();
+    SimulatedHardware_Run(2 * CYCLES_PER_MS);
+
+    AdcSpeedSettings invalid = { .prescaler = 0 };
+    EXPECT(!ADC_SetSpeed(&invalid));
+
+    AdcSpeedSettings settings = { .prescaler = 4, .highSpeed = true, .eightBit = true };
+    EXPECT(ADC_SetSpeed(&settings));
+
+    // frame that was being scanned is finished at the old speed.
+    uint16_t values[SENSOR_COUNT];
+    SimulatedHardware_Run(CYCLES_PER_MS);
+
+    // 13 us per conversion instead of 52.
+    uint16_t framesBefore = ADC_GetFrameCount();
+    SimulatedHardware_Run(10 * CYCLES_PER_MS);
+    uint16_t frames = ADC_GetFrameCount() - framesBefore;
+    printf("  %u frames in 10 ms\n", frames);
+    EXPECT(abs(frames - 10000 / (13 * SENSOR_COUNT)) <= 1);
+
+    // lowest bits are gone, but scale stays.
+    EXPECT(ADC_ReadFrame(values));
+    EXPECT_EQ(values[3], 0x1FC);
+}
+
+static uint64_t stepCycle;
+
+static uint16_t StepSource(uint8_t channel, uint64_t cycle) {
+    return channel == SimulatedHardware_SensorToChannel(0) && cycle >= stepCycle ? 800 : 100;
+}
+
+static void TestCaptureKeepsSamplesFromBeforeTrigger(void) {
+    Setup();
+    Telemetry_Init();
+    ADC_Init();
+
+    stepCycle = SimulatedHardware_GetCycles() + 3 * CYCLES_PER_MS;
+    SimulatedHardware_SetAnalogSource(StepSource);
+
+    AdcCaptureSettings settings = {
+        .sensors = { 0 },
+        .sensorCount = 1,
+        .sampleCount = 100,
+        .preTriggerCount = 20,
+        .triggerLevel = 128,
+        .triggerFlags = ADC_CAPTURE_TRIGGER_RISING
+    };
+
+    EXPECT(ADC_StartCapture(&settings));
+    SimulatedHardware_Run(2 * CYCLES_PER_MS);
+
+    AdcCaptureStatus status;
+    ADC_GetCaptureStatus(&status);
+    EXPECT_EQ(status.state, ADC_CAPTURE_WAITING);
+
+    SimulatedHardware_Run(3 * CYCLES_PER_MS);
+    ADC_GetCaptureStatus(&status);
+    EXPECT_EQ(status.state, ADC_CAPTURE_DONE);
+    EXPECT_EQ(status.triggerPosition, 20);
+
+    uint8_t samples[100];
+    EXPECT_EQ(ADC_ReadCapture(0, samples, 100), 100);
+
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(samples[i], i < 20 ? 100 >> 2 : 800 >> 2);
+    }
+
+    ADC_StopCapture();
+}
+
+// capture that is stopped before the ISR has started it still gives scanning
+// back its settings and a clean frame ring.
+static void TestRestartedCaptureStopsCleanly(void) {
+    Setup();
+    Telemetry_Init();
+    SimulatedHardware_SetSensorInput(3, 0x1FF);
+    ADC_Init();
+    SimulatedHardware_Run(2 * CYCLES_PER_MS);
+
+    // input never rises, so this waits for the trigger until stopped.
+    AdcCaptureSettings settings = {
+        .sensors = { 3 },
+        .sensorCount = 1,
+        .sampleCount = 100,
+        .triggerLevel = 200,
+        .triggerFlags = ADC_CAPTURE_TRIGGER_RISING
+    };
+
+    EXPECT(ADC_StartCapture(&settings));
+    SimulatedHardware_Run(CYCLES_PER_MS);
+    EXPECT(ADC_StartCapture(&settings));
+    ADC_StopCapture();
+
+    AdcCaptureStatus status;
+    ADC_GetCaptureStatus(&status);
+    EXPECT_EQ(status.state, ADC_CAPTURE_IDLE);
+
+    uint16_t firstFrame = ADC_GetFrameCount();
+    SimulatedHardware_Run(2 * CYCLES_PER_MS);
+
+    uint16_t values[SENSOR_COUNT];
+    EXPECT(ADC_ReadFrame(values));
+    EXPECT_EQ(values[3], 0x1FF);
+
+    // frames from before the capture are gone, ones scanned since are there.
+    AdcFrame frame;
+    EXPECT(!ADC_ReadBufferedFrame(firstFrame - 1, &frame));
+    EXPECT(ADC_ReadBufferedFrame(ADC_GetFrameCount() - 1, &frame));
+    EXPECT_EQ(frame.sensorValues[3], 0x1FF);
+}
+
+int main(void) {
+    RUN_TEST(TestFramesContainAllSensors);
+    RUN_TEST(TestScanRateIsAboveOneKilohertz);
+    RUN_TEST(TestLatestFrameWins);
+    RUN_TEST(TestPadFollowsScanningWithoutPolling);
+    RUN_TEST(TestBufferedFramesKeepHistory);
+    RUN_TEST(TestProfileSwitchTakesOneScan);
+    RUN_TEST(TestLinearizedThresholds);
+    RUN_TEST(TestSetThresholdsKeepsFilters);
+    RUN_TEST(TestUnmappedSensorsAreScannedRarely);
+    RUN_TEST(TestFramesLockToStartOfFrame);
+    RUN_TEST(TestSpeedChangesBetweenFrames);
+    RUN_TEST(TestCaptureConvertsBackToBack);
+    RUN_TEST(TestCaptureKeepsSamplesFromBeforeTrigger);
+    RUN_TEST(TestRestartedCaptureStopsCleanly);
+    return TEST_RESULT();
+}
@@ -0,0 +1,384 @@
+#include <stdbool.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "SimulatedHardware.h"
+
+volatile uint8_t SREG;
+volatile uint8_t ADCSRA;
+volatile uint8_t ADCSRB;
+volatile uint8_t ADMUX;
+volatile uint16_t ADC;
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint16_t OCR1A;
+volatile uint8_t TIMSK1;
+volatile uint8_t TIFR1;
+volatile uint8_t EECR;
+volatile uint16_t EEAR;
+volatile uint8_t PORTB;
+volatile uint8_t DDRB;
+
+// how teensy 2.0 pins F0, F1, F4-F7, D4, D6, D7, B4-B6 are wired to the ADC
+// multiplexer. order is the same as sensor numbering in ADC.c.
+static const uint8_t boardSensorChannels[12] = {
+    0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25
+};
+
+uint8_t SimulatedHardware_EEPROM[E2END + 1];
+uint32_t SimulatedHardware_EEPROMWriteCounts[E2END + 1];
+
+static volatile uint8_t eepromData;
+static bool eepromWriteRunning;
+static uint64_t eepromWriteDoneAt;
+static uint16_t eepromWriteAddress;
+static uint8_t eepromWriteValue;
+
+static volatile uint16_t timer1Counter;
+static bool timer1CompareFlag;
+
+static uint16_t analogInputs[64];
+static SimulatedHardware_AnalogSource analogSource;
+
+typedef struct {
+    bool connected;
+    uint8_t selectShift;
+    uint8_t selectMask;
+    uint32_t settleCycles;
+    uint16_t inputs[SIMULATED_MAX_MUX_INPUTS];
+} SimulatedMux;
+
+static SimulatedMux muxes[64];
+
+// select lines of muxes are PORTB as it was last seen, which is when a busy
+// loop starts or an interrupt returns. that's when firmware writes to it.
+static uint8_t selectLines;
+static uint8_t previousSelectLines;
+static uint64_t selectLinesChangedAt;
+
+static uint64_t cycles;
+static uint64_t conversionCount;
+static uint64_t stalledCycles;
+
+static bool conversionRunning;
+static bool firstConversion;
+static bool conversionSampled;
+static uint8_t conversionChannel;
+static uint64_t conversionSampleAt;
+static uint64_t conversionDoneAt;
+static uint16_t conversionResult;
+
+void SimulatedHardware_PowerCycle(void) {
+    if (eepromWriteRunning) {
+        // erase has happened, write hasn't.
+        SimulatedHardware_EEPROM[eepromWriteAddress] = 0xFF;
+    }
+
+    SREG = 0;
+    ADCSRA = 0;
+    ADCSRB = 0;
+    ADMUX = 0;
+    ADC = 0;
+    TCCR1A = 0;
+    TCCR1B = 0;
+    OCR1A = 0;
+    TIMSK1 = 0;
+    TIFR1 = 0;
+    timer1CompareFlag = false;
+    EECR = 0;
+    EEAR = 0;
+    PORTB = 0;
+    DDRB = 0;
+
+    for (int i = 0; i < 64; i++) {
+        analogInputs[i] = 0;
+    }
+
+    memset(muxes, 0, sizeof (muxes));
+    selectLines = 0;
+    previousSelectLines = 0;
+    selectLinesChangedAt = 0;
+
+    analogSource = 0;
+    cycles = 0;
+    conversionCount = 0;
+    stalledCycles = 0;
+    conversionRunning = false;
+    firstConversion = true;
+    eepromWriteRunning = false;
+}
+
+void SimulatedHardware_Reset(void) {
+    SimulatedHardware_PowerCycle();
+    memset(SimulatedHardware_EEPROM, 0xFF, sizeof (SimulatedHardware_EEPROM));
+    memset(SimulatedHardware_EEPROMWriteCounts, 0, sizeof (SimulatedHardware_EEPROMWriteCounts));
+}
+
+void SimulatedHardware_SetAnalogInput(uint8_t channel, uint16_t value) {
+    analogInputs[channel & 0x3F] = value & 0x3FF;
+}
+
+uint8_t SimulatedHardware_SensorToChannel(uint8_t sensor) {
+    return boardSensorChannels[sensor];
+}
+
+void SimulatedHardware_SetSensorInput(uint8_t sensor, uint16_t value) {
+    SimulatedHardware_SetAnalogInput(SimulatedHardware_SensorToChannel(sensor), value);
+}
+
+void SimulatedHardware_SetAnalogSource(SimulatedHardware_AnalogSource source) {
+    analogSource = source;
+}
+
+void SimulatedHardware_ConnectMux(uint8_t channel, uint8_t selectShift, uint8_t selectBits, uint32_t settleCycles) {
+    SimulatedMux* mux = &muxes[channel & 0x3F];
+    mux->connected = true;
+    mux->selectShift = selectShift;
+    mux->selectMask = (1 << selectBits) - 1;
+    mux->settleCycles = settleCycles;
+}
+
+void SimulatedHardware_SetMuxInput(uint8_t channel, uint8_t input, uint16_t value) {
+    muxes[channel & 0x3F].inputs[input % SIMULATED_MAX_MUX_INPUTS] = value & 0x3FF;
+}
+
+static void TrackSelectLines(void) {
+    if (PORTB != selectLines) {
+        previousSelectLines = selectLines;
+        selectLines = PORTB;
+        selectLinesChangedAt = cycles;
+    }
+}
+
+static uint16_t SampleChannel(uint8_t channel) {
+    const SimulatedMux* mux = &muxes[channel];
+
+    if (mux->connected) {
+        // output still follows the previous input until it has settled.
+        bool settled = cycles - selectLinesChangedAt >= mux->settleCycles;
+        uint8_t lines = settled ? selectLines : previousSelectLines;
+        return mux->inputs[(lines >> mux->selectShift) & mux->selectMask];
+    }
+
+    return analogSource ? analogSource(channel, cycles) : analogInputs[channel];
+}
+
+uint64_t SimulatedHardware_GetCycles(void) {
+    return cycles;
+}
+
+uint64_t SimulatedHardware_GetConversionCount(void) {
+    return conversionCount;
+}
+
+uint64_t SimulatedHardware_GetStalledCycles(void) {
+    return stalledCycles;
+}
+
+// timer is assumed to be started at cycle 0 and never reconfigured.
+static uint16_t Timer1Prescaler(void) {
+    static const uint16_t prescalers[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+    return prescalers[TCCR1B & 0x07];
+}
+
+volatile uint16_t* SimulatedHardware_Timer1Counter(void) {
+    uint16_t prescaler = Timer1Prescaler();
+
+    timer1Counter = prescaler ? (uint16_t) (cycles / prescaler) : 0;
+    return &timer1Counter;
+}
+
+// cycle when counter next becomes OCR1A. compare match happens when
+// counter gets there, so not if it's there already.
+static uint64_t Timer1CompareAt(void) {
+    uint16_t prescaler = Timer1Prescaler();
+
+    if (!prescaler) {
+        return UINT64_MAX;
+    }
+
+    uint64_t nextTick = cycles / prescaler + 1;
+    return (nextTick + (uint16_t) (OCR1A - nextTick)) * prescaler;
+}
+
+volatile uint8_t* SimulatedHardware_EEPROMData(void) {
+    if (EECR & _BV(EERE)) {
+        // reading while a write is in progress isn't possible on real hardware.
+        if (!eepromWriteRunning) {
+            eepromData = SimulatedHardware_EEPROM[EEAR & E2END];
+        }
+
+        EECR &= ~_BV(EERE);
+    }
+
+    return &eepromData;
+}
+
+static void StartEEPROMWrite(void) {
+    // EEPE is ignored unless EEMPE was set right before it.
+    if (!(EECR & _BV(EEMPE))) {
+        EECR &= ~_BV(EEPE);
+        return;
+    }
+
+    eepromWriteRunning = true;
+    eepromWriteAddress = EEAR & E2END;
+    eepromWriteValue = eepromData;
+    eepromWriteDoneAt = cycles + SIMULATED_EEPROM_WRITE_CYCLES;
+    EECR &= ~_BV(EEMPE);
+}
+
+static void FinishEEPROMWrite(void) {
+    eepromWriteRunning = false;
+    SimulatedHardware_EEPROM[eepromWriteAddress] = eepromWriteValue;
+    SimulatedHardware_EEPROMWriteCounts[eepromWriteAddress]++;
+    EECR &= ~_BV(EEPE);
+}
+
+static uint32_t ADCPrescaler(void) {
+    uint8_t bits = ADCSRA & 0x07;
+    return bits == 0 ? 2 : (1UL << bits);
+}
+
+static void StartConversion(void) {
+    // first conversion after enabling the ADC takes 25 ADC clock cycles
+    // instead of 13, and input is sampled after 13.5 cycles instead of 1.5.
+    // see page 297 of the datasheet.
+    uint32_t adcCycles = firstConversion ? 25 : 13;
+    uint32_t sampleHalfCycles = firstConversion ? 27 : 3;
+    firstConversion = false;
+
+    conversionRunning = true;
+    conversionSampled = false;
+    conversionChannel = (ADMUX & 0x1F) | (ADCSRB & 0x20);
+    conversionSampleAt = cycles + sampleHalfCycles * ADCPrescaler() / 2;
+    conversionDoneAt = cycles + adcCycles * ADCPrescaler();
+}
+
+static void SampleConversion(void) {
+    conversionSampled = true;
+    conversionResult = SampleChannel(conversionChannel);
+}
+
+static void FinishConversion(void) {
+    conversionRunning = false;
+    conversionCount++;
+
+    ADC = (ADMUX & _BV(ADLAR)) ? (uint16_t) (conversionResult << 6) : conversionResult;
+    ADCSRA = (ADCSRA & ~_BV(ADSC)) | _BV(ADIF);
+}
+
+static void DeliverInterrupts(void) {
+    if (!(SREG & _BV(SREG_I))) {
+        return;
+    }
+
+    if ((ADCSRA & _BV(ADIE)) && (ADCSRA & _BV(ADIF))) {
+        // hardware clears the flag and global interrupts when entering the ISR.
+        ADCSRA &= ~_BV(ADIF);
+        cli();
+        ADC_vect();
+        sei();
+    }
+
+    if ((TIMSK1 & _BV(OCIE1A)) && timer1CompareFlag) {
+        timer1CompareFlag = false;
+        cli();
+        TIMER1_COMPA_vect();
+        sei();
+    }
+
+    // EEPROM ready interrupt keeps firing as long as it's enabled and no
+    // write is in progress.
+    if ((EECR & _BV(EERIE)) && !(EECR & _BV(EEPE))) {
+        cli();
+        EE_READY_vect();
+        sei();
+    }
+}
+
+// interrupts are not delivered while the cpu is stalled, which only happens
+// inside interrupts anyway.
+static void Advance(uint64_t target, bool deliverInterrupts) {
+    for (;;) {
+        if (deliverInterrupts) {
+            DeliverInterrupts();
+        }
+
+        TrackSelectLines();
+
+        if (TIFR1 & _BV(OCF1A)) {
+            TIFR1 = 0;
+            timer1CompareFlag = false;
+        }
+
+        if (!(ADCSRA & _BV(ADEN))) {
+            conversionRunning = false;
+            firstConversion = true;
+        } else if (!conversionRunning && (ADCSRA & _BV(ADSC))) {
+            StartConversion();
+        }
+
+        if (!eepromWriteRunning && (EECR & _BV(EEPE))) {
+            StartEEPROMWrite();
+        }
+
+        uint64_t next = UINT64_MAX;
+
+        if (conversionRunning) {
+            next = conversionSampled ? conversionDoneAt : conversionSampleAt;
+        }
+
+        if (eepromWriteRunning && eepromWriteDoneAt < next) {
+            next = eepromWriteDoneAt;
+        }
+
+        uint64_t compareAt = Timer1CompareAt();
+
+        if (compareAt < next) {
+            next = compareAt;
+        }
+
+        if (next > target) {
+            break;
+        }
+
+        cycles = next;
+
+        if (conversionRunning && !conversionSampled && conversionSampleAt == cycles) {
+            SampleConversion();
+        }
+
+        if (conversionRunning && conversionSampled && conversionDoneAt == cycles) {
+            FinishConversion();
+        }
+
+        if (eepromWriteRunning && eepromWriteDoneAt == cycles) {
+            FinishEEPROMWrite();
+        }
+
+        if (compareAt == cycles) {
+            timer1CompareFlag = true;
+        }
+    }
+
+    // interrupt can stall past the target.
+    if (cycles < target) {
+        cycles = target;
+    }
+}
+
+void SimulatedHardware_Run(uint64_t runCycles) {
+    Advance(cycles + runCycles, true);
+}
+
+void SimulatedHardware_Stall(uint64_t stallCycles) {
+    stalledCycles += stallCycles;
+    Advance(cycles + stallCycles, false);
+}
+
+void eeprom_read_block(void* dst, const void* src, size_t size) {
+    memcpy(dst, &SimulatedHardware_EEPROM[(uintptr_t) src], size);
+}
+
@@ -0,0 +1,61 @@
+#ifndef _SIMULATED_HARDWARE_H_
+#define _SIMULATED_HARDWARE_H_
+    #include <stdint.h>
+    #include <avr/eeprom.h>
+
+    // clock of the simulated microcontroller, same as F_CPU in build/makefile.
+    #define SIMULATED_F_CPU 16000000UL
+
+    // sample source for ADC conversions. channel is the 6-bit MUX5:0 value
+    // firmware selected, cycle is the moment sample and hold happens.
+    typedef uint16_t (*SimulatedHardware_AnalogSource)(uint8_t channel, uint64_t cycle);
+
+    // puts all simulated registers back to their power-on state and erases EEPROM.
+    void SimulatedHardware_Reset(void);
+
+    // cuts power and turns it back on: like reset, but EEPROM keeps its
+    // contents. byte that was being written to EEPROM is left erased.
+    void SimulatedHardware_PowerCycle(void);
+
+    // sets a constant value for an analog input. used when no source function is set.
+    void SimulatedHardware_SetAnalogInput(uint8_t channel, uint16_t value);
+
+    // same as above, but using the sensor numbering of the firmware, ie. how
+    // sensors are wired to the pins of teensy 2.0.
+    void SimulatedHardware_SetSensorInput(uint8_t sensor, uint16_t value);
+    uint8_t SimulatedHardware_SensorToChannel(uint8_t sensor);
+
+    void SimulatedHardware_SetAnalogSource(SimulatedHardware_AnalogSource source);
+
+    #define SIMULATED_MAX_MUX_INPUTS 16
+
+    // connects an external analog multiplexer to an analog input. select
+    // lines are selectBits bits of PORTB from selectShift up. once they
+    // change, the input reads the previously selected mux input until
+    // settleCycles have passed.
+    void SimulatedHardware_ConnectMux(uint8_t channel, uint8_t selectShift, uint8_t selectBits, uint32_t settleCycles);
+    void SimulatedHardware_SetMuxInput(uint8_t channel, uint8_t input, uint16_t value);
+
+    // advances simulated time by given amount of cpu cycles, delivering
+    // interrupts as the peripherals raise them.
+    void SimulatedHardware_Run(uint64_t cycles);
+
+    // advances simulated time without delivering interrupts, like a busy
+    // loop in an interrupt does. see shim/util/delay_basic.h.
+    void SimulatedHardware_Stall(uint64_t cycles);
+
+    // contents of the simulated EEPROM, initially erased (0xFF).
+    extern uint8_t SimulatedHardware_EEPROM[E2END + 1];
+
+    // how many times each EEPROM byte has been written since reset.
+    extern uint32_t SimulatedHardware_EEPROMWriteCounts[E2END + 1];
+
+    // cpu cycles it takes to write one EEPROM byte.
+    #define SIMULATED_EEPROM_WRITE_CYCLES (SIMULATED_F_CPU / 1000 * 34 / 10)
+
+    uint64_t SimulatedHardware_GetCycles(void);
+    uint64_t SimulatedHardware_GetConversionCount(void);
+
+    // cycles spent in busy loops since reset.
+    uint64_t SimulatedHardware_GetStalledCycles(void);
+#endif
@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/interrupt.h>
+
+#include "Config/DancePadConfig.h"
+#include "ADC.h"
+#include "StubADC.h"
+
+// replaces ADC.c for benchmarks: a new frame is always available, so the
+// measured time is only what firmware spends processing it. copying the frame
+// out is kept, because the real ADC_ReadFrame() does that too.
+
+static const uint16_t (*patternFrames)[SENSOR_COUNT];
+static uint16_t patternLength = 0;
+static uint16_t frameCount = 0;
+static AdcSchedule schedule;
+
+void StubADC_SetPattern(const uint16_t (*frames)[SENSOR_COUNT], uint16_t length) {
+    patternFrames = frames;
+    patternLength = length;
+    frameCount = 0;
+}
+
+void StubADC_Advance(uint16_t frames) {
+    frameCount += frames;
+}
+
+void ADC_Init(void) {}
+
+// frames come from the pattern as they are, schedule is only kept around to
+// be looked at.
+void ADC_SetSchedule(const AdcSchedule* newSchedule) {
+    schedule = *newSchedule;
+}
+
+const AdcSchedule* StubADC_GetSchedule(void) {
+    return &schedule;
+}
+
+// speed doesn't change how often frames come.
+bool ADC_SetSpeed(const AdcSpeedSettings* settings) {
+    return true;
+}
+
+// frames are never paused for.
+void ADC_SetFrameDeadline(uint16_t offsetTicks) {}
+void ADC_StartOfFrame(uint16_t ticks) {}
+
+bool ADC_ReadFrame(uint16_t* sensorValues) {
+    memcpy(sensorValues, patternFrames[frameCount % patternLength], sizeof (patternFrames[0]));
+    frameCount++;
+    return true;
+}
+
+uint16_t ADC_GetReadFrameTimestamp(void) {
+    return (frameCount - 1) * 2000;
+}
+
+uint16_t ADC_GetFrameCount(void) {
+    return frameCount;
+}
+
+// frames are 1 ms apart, as if they were scanned at 1 kHz.
+bool ADC_ReadBufferedFrame(uint16_t sequence, AdcFrame* frame) {
+    if ((uint16_t) (frameCount - 1 - sequence) >= ADC_FRAME_BUFFER_SIZE - 1) {
+        return false;
+    }
+
+    memcpy(frame->sensorValues, patternFrames[sequence % patternLength], sizeof (frame->sensorValues));
+    frame->timestamp = sequence * 2000;
+    return true;
+}
+
+// simulated ADC and timer are never enabled with the stub, so these never run.
+ISR(ADC_vect) {}
+ISR(TIMER1_COMPA_vect) {}
@@ -0,0 +1,15 @@
+#ifndef _STUB_ADC_H_
+#define _STUB_ADC_H_
+    #include <stdint.h>
+    #include "Config/DancePadConfig.h"
+    #include "ADC.h"
+
+    // frames that following ADC_ReadFrame() calls return, looping over.
+    void StubADC_SetPattern(const uint16_t (*frames)[SENSOR_COUNT], uint16_t length);
+
+    // pretends that given amount of frames were scanned.
+    void StubADC_Advance(uint16_t frames);
+
+    // latest schedule given to ADC_SetSchedule().
+    const AdcSchedule* StubADC_GetSchedule(void);
+#endif
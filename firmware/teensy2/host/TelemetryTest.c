@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+#include <avr/interrupt.h>
+
+#include "Config/DancePadConfig.h"
+#include "Telemetry.h"
+#include "SimulatedHardware.h"
+#include "TestUtil.h"
+
+static TelemetryData data;
+
+static void Setup(void) {
+    SimulatedHardware_Reset();
+    Telemetry_Init();
+    Telemetry_ReadAndReset(&data);
+}
+
+static void TestBucketsAreLogarithmic(void) {
+    Setup();
+    TelemetryHistogram histogram;
+    memset(&histogram, 0, sizeof (histogram));
+
+    // with shift 2, first bucket is for 0-3, then 4-7, 8-15, 16-31...
+    const uint16_t values[] = { 0, 3, 4, 7, 8, 16, 31, 32, 255, 256, 60000 };
+    for (size_t i = 0; i < sizeof (values) / sizeof (values[0]); i++) {
+        Telemetry_RecordValue(&histogram, 2, values[i]);
+    }
+
+    EXPECT_EQ(histogram.buckets[0], 2);
+    EXPECT_EQ(histogram.buckets[1], 2);
+    EXPECT_EQ(histogram.buckets[2], 1);
+    EXPECT_EQ(histogram.buckets[3], 2);
+    EXPECT_EQ(histogram.buckets[4], 1);
+    EXPECT_EQ(histogram.buckets[5], 0);
+    EXPECT_EQ(histogram.buckets[6], 1);
+    EXPECT_EQ(histogram.buckets[7], 2);
+    EXPECT_EQ(histogram.max, 60000);
+}
+
+static void TestBucketsSaturate(void) {
+    TelemetryHistogram histogram;
+    memset(&histogram, 0, sizeof (histogram));
+    histogram.buckets[0] = UINT16_MAX - 1;
+
+    Telemetry_RecordValue(&histogram, 0, 0);
+    Telemetry_RecordValue(&histogram, 0, 0);
+
+    EXPECT_EQ(histogram.buckets[0], UINT16_MAX);
+}
+
+static void TestPressLatencyFromFirstEdgeToReport(void) {
+    Setup();
+
+    uint16_t edgeTicks;
+    Telemetry_MarkButtonEdge(1000);
+    Telemetry_MarkButtonEdge(1200); // already waiting for a report, ignored
+    EXPECT(Telemetry_TakeButtonEdge(&edgeTicks));
+    EXPECT_EQ(edgeTicks, 1000);
+
+    // report without an edge doesn't carry one.
+    EXPECT(!Telemetry_TakeButtonEdge(&edgeTicks));
+
+    Telemetry_RecordPressLatency(100); // 100 ticks = 50 us -> bucket 1 with shift 6
+
+    Telemetry_ReadAndReset(&data);
+    EXPECT_EQ(data.pressLatency.buckets[1], 1);
+    EXPECT_EQ(data.pressLatency.max, 100);
+
+    uint32_t total = 0;
+    for (int i = 0; i < TELEMETRY_BUCKET_COUNT; i++) {
+        total += data.pressLatency.buckets[i];
+    }
+    EXPECT_EQ(total, 1);
+}
+
+static void TestCallbackJitterIsDistanceFromOneMillisecond(void) {
+    Setup();
+
+    uint16_t ticks = 65000; // wraps around during the test
+    Telemetry_RecordReportCallback(ticks);
+    ticks += TELEMETRY_CALLBACK_INTERVAL_TICKS;
+    Telemetry_RecordReportCallback(ticks); // exactly on time
+    ticks += TELEMETRY_CALLBACK_INTERVAL_TICKS + 3;
+    Telemetry_RecordReportCallback(ticks); // 3 ticks late
+    ticks += TELEMETRY_CALLBACK_INTERVAL_TICKS - 3;
+    Telemetry_RecordReportCallback(ticks); // 3 ticks early
+
+    Telemetry_ReadAndReset(&data);
+    EXPECT_EQ(data.callbackJitter.buckets[0], 1);
+    EXPECT_EQ(data.callbackJitter.buckets[2], 2);
+    EXPECT_EQ(data.callbackJitter.max, 3);
+}
+
+static void TestReadResets(void) {
+    Setup();
+
+    Telemetry_RecordValue(&data.scanDuration, 0, 0); // not the live data, must not matter
+    SimulatedHardware_Run(100);
+    Telemetry_RecordScanDuration(0);
+
+    Telemetry_ReadAndReset(&data);
+    EXPECT_EQ(data.scanDuration.max, 100 / 8);
+
+    Telemetry_ReadAndReset(&data);
+    EXPECT_EQ(data.scanDuration.max, 0);
+    EXPECT_EQ(data.scanDuration.buckets[0], 0);
+}
+
+int main(void) {
+    RUN_TEST(TestBucketsAreLogarithmic);
+    RUN_TEST(TestBucketsSaturate);
+    RUN_TEST(TestPressLatencyFromFirstEdgeToReport);
+    RUN_TEST(TestCallbackJitterIsDistanceFromOneMillisecond);
+    RUN_TEST(TestReadResets);
+    return TEST_RESULT();
+}
@@ -0,0 +1,31 @@
+#ifndef _TEST_UTIL_H_
+#define _TEST_UTIL_H_
+    // tiny helpers for host tests. a failed expectation is reported but the
+    // test keeps going, so one run shows everything that is broken.
+
+    #include <stdio.h>
+
+    static int testFailures = 0;
+
+    #define EXPECT(condition) do { \
+        if (!(condition)) { \
+            printf("  %s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            testFailures++; \
+        } \
+    } while (0)
+
+    #define EXPECT_EQ(actual, expected) do { \
+        long long _actual = (actual), _expected = (expected); \
+        if (_actual != _expected) { \
+            printf("  %s:%d: expected %s == %lld, was %lld\n", __FILE__, __LINE__, #actual, _expected, _actual); \
+            testFailures++; \
+        } \
+    } while (0)
+
+    #define RUN_TEST(test) do { \
+        printf("%s\n", #test); \
+        test(); \
+    } while (0)
+
+    #define TEST_RESULT() (testFailures == 0 ? 0 : (printf("%d failure(s)\n", testFailures), 1))
+#endif
@@ -0,0 +1,443 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "Config/DancePadConfig.h"
+#include "Communication.h"
+#include "Pad.h"
+#include "StubADC.h"
+#include "TestUtil.h"
+
+// replays sensor traces through Pad.c and Communication.c, one trace frame
+// per scan, and compares how fast and how reliably buttons follow what
+// really happened against baselines stored in traces/baselines.txt. run
+// with --update-baselines (or "make trace-baselines") to accept new numbers.
+//
+// traces are CSV files in traces/. lines starting with # are comments, the
+// first other line names the columns:
+// - buttons: buttons that are really pressed, as a bitmask. a press starts
+//   when the foot starts pushing, and ends when it starts to lift.
+// - s0, s1, ...: raw value of that sensor. sensors not in the trace are 0.
+// sensor n belongs to button n / 2, like on a pad with two sensors per panel.
+
+#define TRACE_DIRECTORY "traces"
+#define BASELINE_FILE "baselines.txt"
+
+#define MAX_LINE_LENGTH 1024
+#define MAX_TRACES 32
+#define MAX_BASELINES 256
+
+// reported press has to come within this many scans after the real press
+// ends, or the press counts as missed.
+#define MATCH_WINDOW_SCANS 20
+
+typedef struct {
+    const char* name;
+    uint8_t sensorFilter;
+    uint8_t releaseThreshold;
+} TraceConfiguration;
+
+static const TraceConfiguration CONFIGURATIONS[] = {
+    { "raw", SENSOR_FILTER(0, false, 0), SENSOR_RELEASE_THRESHOLD(0.9) },
+    { "default", SENSOR_FILTER(1, false, 0), SENSOR_RELEASE_THRESHOLD(0.9) },
+    { "median", SENSOR_FILTER(0, true, 0), SENSOR_RELEASE_THRESHOLD(0.9) },
+    { "smooth", SENSOR_FILTER(3, true, 0), SENSOR_RELEASE_THRESHOLD(0.9) },
+    { "hysteresis", SENSOR_FILTER(1, false, 0), SENSOR_RELEASE_THRESHOLD(0.6) }
+};
+
+#define CONFIGURATION_COUNT (sizeof (CONFIGURATIONS) / sizeof (CONFIGURATIONS[0]))
+
+typedef struct {
+    uint16_t (*frames)[SENSOR_COUNT];
+    ButtonMask* truth;
+    uint16_t length;
+} Trace;
+
+// worst case is what baselines are about, averages are only printed.
+typedef struct {
+    uint32_t presses;
+    uint32_t pressLatencyMax;
+    uint32_t pressLatencySum;
+    uint32_t releases;
+    uint32_t releaseLatencyMax;
+    uint32_t releaseLatencySum;
+    uint32_t missed;
+    uint32_t chatter;
+} TraceResult;
+
+typedef struct {
+    char trace[64];
+    char configuration[32];
+    uint32_t pressLatencyMax;
+    uint32_t releaseLatencyMax;
+    uint32_t missed;
+    uint32_t chatter;
+} Baseline;
+
+// follows one button through a trace.
+typedef struct {
+    bool truth;
+    bool reported;
+    bool tapOpen; // real press that a reported press can still be matched to
+    bool tapMatched;
+    bool tapEnded;
+    bool releasePending; // real press has ended, reported one hasn't
+    uint32_t tapStart;
+    uint32_t tapEnd;
+} ButtonTracker;
+
+static bool ReadTrace(const char* path, Trace* trace) {
+    FILE* file = fopen(path, "r");
+
+    if (!file) {
+        printf("  can't open %s\n", path);
+        return false;
+    }
+
+    char line[MAX_LINE_LENGTH];
+    int columns[SENSOR_COUNT + 1];
+    int columnCount = 0;
+    int truthColumn = -1;
+    size_t capacity = 0;
+
+    memset(trace, 0, sizeof (Trace));
+
+    while (fgets(line, sizeof (line), file)) {
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        }
+
+        if (columnCount == 0) {
+            // header, column n is sensor columns[n], or -1 for buttons.
+            for (char* name = strtok(line, ",\r\n"); name && columnCount < SENSOR_COUNT + 1; name = strtok(NULL, ",\r\n")) {
+                if (strcmp(name, "buttons") == 0) {
+                    truthColumn = columnCount;
+                    columns[columnCount++] = -1;
+                } else if (name[0] == 's' && atoi(name + 1) < SENSOR_COUNT) {
+                    columns[columnCount++] = atoi(name + 1);
+                } else {
+                    printf("  %s: unknown column %s\n", path, name);
+                    fclose(file);
+                    return false;
+                }
+            }
+
+            if (truthColumn < 0) {
+                printf("  %s: no buttons column\n", path);
+                fclose(file);
+                return false;
+            }
+
+            continue;
+        }
+
+        if (trace->length == UINT16_MAX) {
+            printf("  %s: too long, only first %u frames are used\n", path, trace->length);
+            break;
+        }
+
+        if (trace->length == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            trace->frames = realloc(trace->frames, capacity * sizeof (trace->frames[0]));
+            trace->truth = realloc(trace->truth, capacity * sizeof (trace->truth[0]));
+        }
+
+        uint16_t* frame = trace->frames[trace->length];
+        memset(frame, 0, sizeof (trace->frames[0]));
+
+        char* value = strtok(line, ",\r\n");
+
+        for (int column = 0; column < columnCount && value; column++, value = strtok(NULL, ",\r\n")) {
+            if (columns[column] < 0) {
+                trace->truth[trace->length] = (ButtonMask) strtoul(value, NULL, 0);
+            } else {
+                frame[columns[column]] = (uint16_t) atoi(value);
+            }
+        }
+
+        trace->length++;
+    }
+
+    fclose(file);
+    return trace->length > 0;
+}
+
+static void CountPress(TraceResult* result, uint32_t latency) {
+    result->presses++;
+    result->pressLatencySum += latency;
+
+    if (latency > result->pressLatencyMax) {
+        result->pressLatencyMax = latency;
+    }
+}
+
+static void CountRelease(TraceResult* result, uint32_t latency) {
+    result->releases++;
+    result->releaseLatencySum += latency;
+
+    if (latency > result->releaseLatencyMax) {
+        result->releaseLatencyMax = latency;
+    }
+}
+
+static void TrackButton(ButtonTracker* tracker, TraceResult* result, uint32_t scan, bool truth, bool reported) {
+    if (truth && !tracker->truth) {
+        if (tracker->tapOpen && !tracker->tapMatched) {
+            result->missed++;
+        }
+
+        // previous press is still reported, so it runs into this one.
+        if (tracker->releasePending) {
+            CountRelease(result, scan - tracker->tapEnd);
+            tracker->releasePending = false;
+        }
+
+        tracker->tapOpen = true;
+        tracker->tapMatched = false;
+        tracker->tapEnded = false;
+        tracker->tapStart = scan;
+    }
+
+    if (!truth && tracker->truth) {
+        tracker->tapEnded = true;
+        tracker->tapEnd = scan;
+
+        if (tracker->tapMatched) {
+            if (reported) {
+                tracker->releasePending = true;
+            } else {
+                // released already while still pressed for real.
+                CountRelease(result, 0);
+            }
+        }
+    }
+
+    if (reported && !tracker->reported) {
+        if (tracker->tapOpen && !tracker->tapMatched) {
+            tracker->tapMatched = true;
+            CountPress(result, scan - tracker->tapStart);
+
+            if (tracker->tapEnded) {
+                tracker->releasePending = true;
+            }
+        } else {
+            result->chatter++;
+        }
+    }
+
+    if (!reported && tracker->reported && tracker->releasePending) {
+        CountRelease(result, scan - tracker->tapEnd);
+        tracker->releasePending = false;
+    }
+
+    if (tracker->tapOpen && !tracker->tapMatched && tracker->tapEnded && scan - tracker->tapEnd > MATCH_WINDOW_SCANS) {
+        result->missed++;
+        tracker->tapOpen = false;
+    }
+
+    tracker->truth = truth;
+    tracker->reported = reported;
+}
+
+static TraceResult ReplayTrace(const Trace* trace, const TraceConfiguration* traceConfiguration) {
+    PadConfiguration configuration = {
+        .sensorThresholds = { [0 ... SENSOR_COUNT - 1] = 400 },
+        .sensorReleaseThresholds = { [0 ... SENSOR_COUNT - 1] = traceConfiguration->releaseThreshold },
+        .sensorFilters = { [0 ... SENSOR_COUNT - 1] = traceConfiguration->sensorFilter }
+    };
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        configuration.sensorToButtonMapping[i] = i / 2 < BUTTON_COUNT ? i / 2 : -1;
+    }
+
+    PadConfiguration profiles[PROFILE_COUNT];
+
+    for (int i = 0; i < PROFILE_COUNT; i++) {
+        profiles[i] = configuration;
+    }
+
+    // filters start from whatever the previous replay left behind otherwise.
+    memset(&PAD_STATE, 0, sizeof (PAD_STATE));
+    Pad_Initialize(profiles, 0);
+    StubADC_SetPattern((const uint16_t (*)[SENSOR_COUNT]) trace->frames, trace->length);
+
+    TraceResult result = { 0 };
+    ButtonTracker trackers[BUTTON_COUNT] = { { 0 } };
+
+    for (uint32_t scan = 0; scan < trace->length; scan++) {
+        Pad_UpdateState();
+
+        // buttons as games see them.
+        GamepadHIDReport report;
+        Communication_WriteGamepadHIDReport(&report);
+
+        for (int button = 0; button < BUTTON_COUNT; button++) {
+            bool truth = trace->truth[scan] & ((ButtonMask) 1 << button);
+            bool reported = report.buttons[button / 8] & (1 << (button % 8));
+            TrackButton(&trackers[button], &result, scan, truth, reported);
+        }
+    }
+
+    for (int button = 0; button < BUTTON_COUNT; button++) {
+        if (trackers[button].tapOpen && !trackers[button].tapMatched) {
+            result.missed++;
+        }
+    }
+
+    return result;
+}
+
+static int ReadBaselines(const char* path, Baseline* baselines) {
+    FILE* file = fopen(path, "r");
+    int count = 0;
+
+    if (!file) {
+        return 0;
+    }
+
+    char line[MAX_LINE_LENGTH];
+
+    while (count < MAX_BASELINES && fgets(line, sizeof (line), file)) {
+        Baseline* baseline = &baselines[count];
+
+        if (line[0] != '#' && sscanf(line, "%63s %31s %u %u %u %u", baseline->trace, baseline->configuration,
+                &baseline->pressLatencyMax, &baseline->releaseLatencyMax, &baseline->missed, &baseline->chatter) == 6) {
+            count++;
+        }
+    }
+
+    fclose(file);
+    return count;
+}
+
+static const Baseline* FindBaseline(const Baseline* baselines, int count, const char* trace, const char* configuration) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(baselines[i].trace, trace) == 0 && strcmp(baselines[i].configuration, configuration) == 0) {
+            return &baselines[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int CompareNames(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+static int ListTraces(const char* directory, char** names) {
+    DIR* dir = opendir(directory);
+    int count = 0;
+
+    if (!dir) {
+        printf("  can't open %s\n", directory);
+        return 0;
+    }
+
+    for (struct dirent* entry; (entry = readdir(dir)) && count < MAX_TRACES;) {
+        size_t length = strlen(entry->d_name);
+
+        if (length > 4 && strcmp(entry->d_name + length - 4, ".csv") == 0) {
+            names[count++] = strdup(entry->d_name);
+        }
+    }
+
+    closedir(dir);
+    qsort(names, count, sizeof (names[0]), CompareNames);
+    return count;
+}
+
+static void CheckAgainstBaseline(const char* what, uint32_t value, uint32_t baseline) {
+    if (value > baseline) {
+        printf("  %s got worse: %u, baseline is %u\n", what, value, baseline);
+        testFailures++;
+    } else if (value < baseline) {
+        printf("  %s got better: %u, baseline is %u\n", what, value, baseline);
+    }
+}
+
+int main(int argc, char** argv) {
+    bool updateBaselines = argc > 1 && strcmp(argv[1], "--update-baselines") == 0;
+    const char* directory = argc > (updateBaselines ? 2 : 1) ? argv[argc - 1] : TRACE_DIRECTORY;
+
+    char baselinePath[512];
+    snprintf(baselinePath, sizeof (baselinePath), "%s/%s", directory, BASELINE_FILE);
+
+    static Baseline baselines[MAX_BASELINES];
+    int baselineCount = ReadBaselines(baselinePath, baselines);
+
+    char* traceNames[MAX_TRACES];
+    int traceCount = ListTraces(directory, traceNames);
+    EXPECT(traceCount > 0);
+
+    FILE* baselineFile = NULL;
+
+    if (updateBaselines) {
+        baselineFile = fopen(baselinePath, "w");
+
+        if (!baselineFile) {
+            printf("can't write %s\n", baselinePath);
+            return 1;
+        }
+
+        fprintf(baselineFile, "# written by TraceTest --update-baselines, see TraceTest.c. latencies are in scans.\n");
+        fprintf(baselineFile, "# trace configuration press-latency-max release-latency-max missed chatter\n");
+    }
+
+    printf("%-12s %-11s %7s %17s %19s %7s %8s\n", "trace", "config", "presses", "press latency", "release latency", "missed", "chatter");
+
+    for (int t = 0; t < traceCount; t++) {
+        char path[512];
+        snprintf(path, sizeof (path), "%s/%s", directory, traceNames[t]);
+
+        Trace trace;
+
+        if (!ReadTrace(path, &trace)) {
+            testFailures++;
+            continue;
+        }
+
+        for (size_t c = 0; c < CONFIGURATION_COUNT; c++) {
+            const char* configurationName = CONFIGURATIONS[c].name;
+            TraceResult result = ReplayTrace(&trace, &CONFIGURATIONS[c]);
+
+            printf("%-12s %-11s %7u %6u max %5.1f avg %8u max %5.1f avg %7u %8u\n", traceNames[t], configurationName,
+                result.presses,
+                result.pressLatencyMax, result.presses ? (double) result.pressLatencySum / result.presses : 0.0,
+                result.releaseLatencyMax, result.releases ? (double) result.releaseLatencySum / result.releases : 0.0,
+                result.missed, result.chatter);
+
+            if (updateBaselines) {
+                fprintf(baselineFile, "%s %s %u %u %u %u\n", traceNames[t], configurationName,
+                    result.pressLatencyMax, result.releaseLatencyMax, result.missed, result.chatter);
+                continue;
+            }
+
+            const Baseline* baseline = FindBaseline(baselines, baselineCount, traceNames[t], configurationName);
+
+            if (!baseline) {
+                printf("  no baseline, run make trace-baselines\n");
+                testFailures++;
+                continue;
+            }
+
+            CheckAgainstBaseline("press latency", result.pressLatencyMax, baseline->pressLatencyMax);
+            CheckAgainstBaseline("release latency", result.releaseLatencyMax, baseline->releaseLatencyMax);
+            CheckAgainstBaseline("missed presses", result.missed, baseline->missed);
+            CheckAgainstBaseline("chatter", result.chatter, baseline->chatter);
+        }
+
+        free(trace.frames);
+        free(trace.truth);
+        free(traceNames[t]);
+    }
+
+    if (baselineFile) {
+        fclose(baselineFile);
+        printf("baselines written to %s\n", baselinePath);
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,19 @@
+#ifndef _SHIM_LUFA_USB_H_
+#define _SHIM_LUFA_USB_H_
+    // host build stand-in for LUFA's USB driver header. only has what is
+    // needed to include Descriptors.h, for the report IDs and sizes.
+
+    #include <stdint.h>
+    #include <stdbool.h>
+
+    #define ATTR_WARN_UNUSED_RESULT
+    #define ATTR_NON_NULL_PTR_ARG(...)
+
+    #define ENDPOINT_DIR_IN 0x80
+    #define ENDPOINT_DIR_OUT 0x00
+
+    typedef struct { uint8_t unused; } USB_Descriptor_Configuration_Header_t;
+    typedef struct { uint8_t unused; } USB_Descriptor_Interface_t;
+    typedef struct { uint8_t unused; } USB_HID_Descriptor_HID_t;
+    typedef struct { uint8_t unused; } USB_Descriptor_Endpoint_t;
+#endif
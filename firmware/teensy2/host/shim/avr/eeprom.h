@@ -0,0 +1,12 @@
+#ifndef _SHIM_AVR_EEPROM_H_
+#define _SHIM_AVR_EEPROM_H_
+    // host build stand-in for avr-libc's <avr/eeprom.h>, backed by the
+    // simulated EEPROM in SimulatedHardware.c.
+
+    #include <stddef.h>
+    #include <stdint.h>
+
+    #define E2END 0x3FF
+
+    void eeprom_read_block(void* dst, const void* src, size_t size);
+#endif
@@ -0,0 +1,17 @@
+#ifndef _SHIM_AVR_INTERRUPT_H_
+#define _SHIM_AVR_INTERRUPT_H_
+    // host build stand-in for avr-libc's <avr/interrupt.h>. interrupt vectors
+    // become ordinary functions that SimulatedHardware.c calls when the
+    // simulated peripheral raises the interrupt.
+
+    #include <avr/io.h>
+
+    #define ISR(vector, ...) void vector(void)
+
+    #define sei() (SREG |= _BV(SREG_I))
+    #define cli() (SREG &= ~_BV(SREG_I))
+
+    void ADC_vect(void);
+    void TIMER1_COMPA_vect(void);
+    void EE_READY_vect(void);
+#endif
@@ -0,0 +1,72 @@
+#ifndef _SHIM_AVR_IO_H_
+#define _SHIM_AVR_IO_H_
+    // host build stand-in for avr-libc's <avr/io.h>. registers are plain
+    // variables that SimulatedHardware.c reads and writes to emulate the
+    // peripherals of atmega32u4. only the bits firmware actually uses are here.
+
+    #include <stdint.h>
+
+    #define _BV(bit) (1 << (bit))
+
+    extern volatile uint8_t SREG;
+    #define SREG_I 7
+
+    // ADC
+    extern volatile uint8_t ADCSRA;
+    extern volatile uint8_t ADCSRB;
+    extern volatile uint8_t ADMUX;
+    extern volatile uint16_t ADC;
+    #define ADCH ((uint8_t) (ADC >> 8))
+
+    #define ADEN 7
+    #define ADSC 6
+    #define ADATE 5
+    #define ADIF 4
+    #define ADIE 3
+    #define ADPS2 2
+    #define ADPS1 1
+    #define ADPS0 0
+
+    #define ADHSM 7
+    #define MUX5 5
+
+    #define REFS1 7
+    #define REFS0 6
+    #define ADLAR 5
+
+    // timer 1. counter is computed from simulated cycles when read, writing
+    // to it is not supported. like on real hardware, compare flag is cleared
+    // by writing 1 to it, but reading TIFR1 doesn't tell whether it's set.
+    extern volatile uint8_t TCCR1A;
+    extern volatile uint8_t TCCR1B;
+    extern volatile uint16_t OCR1A;
+    extern volatile uint8_t TIMSK1;
+    extern volatile uint8_t TIFR1;
+    volatile uint16_t* SimulatedHardware_Timer1Counter(void);
+    #define TCNT1 (*SimulatedHardware_Timer1Counter())
+
+    #define CS12 2
+    #define CS11 1
+    #define CS10 0
+
+    #define OCIE1A 1
+    #define OCF1A 1
+
+    // GPIO. only port B, external analog muxes are selected with it.
+    extern volatile uint8_t PORTB;
+    extern volatile uint8_t DDRB;
+
+    // EEPROM. writes start when EEPE is set and take 3.4 ms. reading EEDR
+    // after setting EERE loads the byte from EEAR right away.
+    extern volatile uint8_t EECR;
+    extern volatile uint16_t EEAR;
+    volatile uint8_t* SimulatedHardware_EEPROMData(void);
+    #define EEDR (*SimulatedHardware_EEPROMData())
+
+    #define EEPM1 5
+    #define EEPM0 4
+    #define EERIE 3
+    #define EEMPE 2
+    #define EEPE 1
+    #define EERE 0
+#endif
@@ -0,0 +1,15 @@
+#ifndef _SHIM_AVR_PGMSPACE_H_
+#define _SHIM_AVR_PGMSPACE_H_
+    // host build stand-in for avr-libc's <avr/pgmspace.h>. there is only one
+    // address space on host, so flash reads are plain memory reads.
+
+    #include <stdint.h>
+    #include <string.h>
+
+    #define PROGMEM
+    #define PSTR(s) (s)
+
+    #define pgm_read_byte(address) (*(const uint8_t*) (address))
+    #define pgm_read_word(address) (*(const uint16_t*) (address))
+    #define memcpy_P memcpy
+#endif
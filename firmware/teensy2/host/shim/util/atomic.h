@@ -0,0 +1,16 @@
+#ifndef _SHIM_UTIL_ATOMIC_H_
+#define _SHIM_UTIL_ATOMIC_H_
+    // host build stand-in for avr-libc's <util/atomic.h>. simulated interrupts
+    // are only delivered when SREG has the I bit set, so clearing it for the
+    // duration of the block works just like on the device.
+
+    #include <stdint.h>
+    #include <avr/io.h>
+
+    #define ATOMIC_RESTORESTATE
+
+    #define ATOMIC_BLOCK(type) \
+        for (uint8_t _sreg_save = SREG, _atomic_once = (SREG &= ~_BV(SREG_I), 1); \
+             _atomic_once; \
+             _atomic_once = 0, SREG = _sreg_save)
+#endif
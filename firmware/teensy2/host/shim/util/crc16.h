@@ -0,0 +1,17 @@
+#ifndef _SHIM_UTIL_CRC16_H_
+#define _SHIM_UTIL_CRC16_H_
+    // host build stand-in for avr-libc's <util/crc16.h>. same as the C
+    // equivalent given in avr-libc documentation.
+
+    #include <stdint.h>
+
+    static inline uint16_t _crc16_update(uint16_t crc, uint8_t a) {
+        crc ^= a;
+
+        for (int i = 0; i < 8; ++i) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+        }
+
+        return crc;
+    }
+#endif
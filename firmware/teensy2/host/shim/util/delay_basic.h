@@ -0,0 +1,15 @@
+#ifndef _SHIM_UTIL_DELAY_BASIC_H_
+#define _SHIM_UTIL_DELAY_BASIC_H_
+    // host build stand-in for avr-libc's <util/delay_basic.h>. busy loops
+    // stall the simulated cpu for as long as they would take on the device,
+    // while peripherals keep running.
+
+    #include <stdint.h>
+
+    void SimulatedHardware_Stall(uint64_t cycles);
+
+    // 4 cycles per loop, 0 = 65536 loops.
+    static inline void _delay_loop_2(uint16_t count) {
+        SimulatedHardware_Stall((count ? count : 65536UL) * 4);
+    }
+#endif
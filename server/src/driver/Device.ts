@@ -1,15 +1,32 @@
 import {
   DeviceConfiguration,
   DeviceProperties,
-  DeviceInputData
+  DeviceTelemetry
 } from '../../../common-types/device'
 
 import StrictEventEmitter from 'strict-event-emitter-types'
 import { EventEmitter } from 'events'
 
+// same as DeviceInputData, but the arrays are owned by the device and
+// overwritten by the next input report. copy whatever needs to be kept.
+export interface DeviceInputState {
+  sensors: Float32Array
+  buttons: Uint8Array // 1 when pressed
+}
+
+// a press or release that device saw, even if it came and went between two
+// input reports. timeUs is on the clock of process.hrtime.
+export interface DeviceButtonEvent {
+  button: number
+  pressed: boolean
+  timeUs: number
+}
+
 export interface DeviceEvents {
-  inputData: DeviceInputData
+  inputData: DeviceInputState
+  buttonEvents: DeviceButtonEvent[]
   eventRate: number
+  telemetry: DeviceTelemetry
   disconnect: void
 }
 
@@ -19,5 +36,7 @@ export interface Device extends StrictEventEmitter<EventEmitter, DeviceEvents> {
   configuration: DeviceConfiguration
   updateConfiguration: (conf: Partial<DeviceConfiguration>) => Promise<void>
   saveConfiguration: () => Promise<void>
+  // sets thresholds to idle sensor values + calibrationBuffer, and saves them
+  calibrate: (calibrationBuffer: number) => Promise<void>
   close: () => void
 }
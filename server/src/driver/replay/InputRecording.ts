@@ -0,0 +1,135 @@
+import fs from 'fs'
+
+import { DeviceConfiguration, DeviceProperties } from '../../../../common-types/device'
+
+// recordings of raw input reports of a device. file is only ever appended to,
+// and everything is little-endian and aligned to 8 bytes, so it can be read
+// as is or mapped to memory:
+//
+//   header
+//     0   magic "ADPR"
+//     4   uint16 version
+//     6   uint16 reserved, 0
+//     8   uint32 length of metadata
+//     12  metadata, JSON in UTF-8, padded with zeros so that records start
+//         at a multiple of 8 bytes
+//   records, one per input report
+//     0   uint64 nanoseconds since the start of recording (hrtime)
+//     8   uint16 length of report
+//     10  report as received, starting from report ID, padded with zeros to
+//         a multiple of 8 bytes
+//
+// if recording stops abruptly, a partial record at the end is ignored.
+
+const MAGIC = 'ADPR'
+const VERSION = 1
+const HEADER_SIZE = 12
+const RECORD_HEADER_SIZE = 10
+
+// records are written in chunks, 1 kHz of small writes is a waste
+const WRITE_CHUNK_SIZE = 64 * 1024
+
+const align = (size: number) => (size + 7) & ~7
+
+export interface InputRecordingMetadata {
+  // which driver knows how to decode the reports
+  driver: string
+  recordedAt: string
+  properties: DeviceProperties
+  configuration: DeviceConfiguration
+  // sensor values in reports are linearized by the device
+  linearizedSensorValues: boolean
+}
+
+export interface InputRecording {
+  metadata: InputRecordingMetadata
+  // of every report, ns since the start of recording
+  timesNs: Float64Array
+  // views to the file, not copies
+  reports: Buffer[]
+}
+
+export class InputRecordingWriter {
+  private fd: number
+  private startTime: bigint
+  private chunk = Buffer.alloc(WRITE_CHUNK_SIZE)
+  private chunkLength = 0
+
+  constructor(path: string, metadata: InputRecordingMetadata) {
+    const metadataData = Buffer.from(JSON.stringify(metadata), 'utf8')
+    const header = Buffer.alloc(align(HEADER_SIZE + metadataData.length))
+
+    header.write(MAGIC, 0, 'ascii')
+    header.writeUInt16LE(VERSION, 4)
+    header.writeUInt32LE(metadataData.length, 8)
+    metadataData.copy(header, HEADER_SIZE)
+
+    this.fd = fs.openSync(path, 'wx')
+    fs.writeSync(this.fd, header)
+    this.startTime = process.hrtime.bigint()
+  }
+
+  public write(report: Buffer) {
+    const size = align(RECORD_HEADER_SIZE + report.length)
+
+    if (this.chunkLength + size > this.chunk.length) {
+      this.flush()
+    }
+
+    const offset = this.chunkLength
+    this.chunk.writeBigUInt64LE(process.hrtime.bigint() - this.startTime, offset)
+    this.chunk.writeUInt16LE(report.length, offset + 8)
+    report.copy(this.chunk, offset + RECORD_HEADER_SIZE)
+    this.chunk.fill(0, offset + RECORD_HEADER_SIZE + report.length, offset + size)
+    this.chunkLength += size
+  }
+
+  public flush() {
+    if (this.chunkLength > 0) {
+      fs.writeSync(this.fd, this.chunk, 0, this.chunkLength)
+      this.chunkLength = 0
+    }
+  }
+
+  public close() {
+    this.flush()
+    fs.closeSync(this.fd)
+  }
+}
+
+export const readInputRecording = (path: string): InputRecording => {
+  const data = fs.readFileSync(path)
+
+  if (data.length < HEADER_SIZE || data.toString('ascii', 0, 4) !== MAGIC) {
+    throw new Error(`"${path}" is not an input recording`)
+  }
+
+  const version = data.readUInt16LE(4)
+  if (version !== VERSION) {
+    throw new Error(`Input recording "${path}" has unknown version ${version}`)
+  }
+
+  const metadataLength = data.readUInt32LE(8)
+  const metadata: InputRecordingMetadata = JSON.parse(
+    data.toString('utf8', HEADER_SIZE, HEADER_SIZE + metadataLength)
+  )
+
+  const times: number[] = []
+  const reports: Buffer[] = []
+  let offset = align(HEADER_SIZE + metadataLength)
+
+  while (offset + RECORD_HEADER_SIZE <= data.length) {
+    const length = data.readUInt16LE(offset + 8)
+    const size = align(RECORD_HEADER_SIZE + length)
+
+    if (offset + size > data.length) {
+      break
+    }
+
+    times.push(Number(data.readBigUInt64LE(offset)))
+    reports.push(data.subarray(offset + RECORD_HEADER_SIZE, offset + RECORD_HEADER_SIZE + length))
+    offset += size
+  }
+
+  return { metadata, timesNs: Float64Array.from(times), reports }
+}
@@ -0,0 +1,252 @@
+import path from 'path'
+import consola from 'consola'
+import { clamp } from 'lodash'
+
+import { DeviceProperties, DeviceConfiguration } from '../../../../common-types/device'
+import { DeviceDriver, DeviceDriverEvents } from '../Driver'
+import { DeviceEvents, Device, DeviceInputState } from '../Device'
+import { ReportManager, RECORDING_DRIVER } from '../teensy2/Teensy2Reports'
+import { normalizeSensorValuesInto } from '../teensy2/Teensy2Linearization'
+import { ExtendableEmitter } from '../../util/ExtendableStrictEmitter'
+import { InputRecording, readInputRecording } from './InputRecording'
+
+// plays back input reports recorded from Teensy2 devices, see
+// InputRecording.ts. lets the server be benchmarked and tested without any
+// pads connected.
+
+export interface ReplayOptions {
+  recordingPath: string
+  // 1 = real time, 2 = twice as fast and so on. 0 = as fast as possible
+  speed: number
+  // how many devices play the same recording at once
+  deviceCount: number
+  // start over from the beginning after the last report
+  loop: boolean
+}
+
+// when playing as fast as possible, let other things happen after this many
+// reports.
+const MAX_SPEED_BATCH_SIZE = 1000
+
+// same as the window of device, see Calibration.h in firmware
+const CALIBRATION_FRAMES = 256
+
+type Calibration = {
+  calibrationBuffer: number
+  sums: Float64Array
+  frames: number
+  resolve: () => void
+}
+
+export class ReplayDevice extends ExtendableEmitter<DeviceEvents>() implements Device {
+  private recording: InputRecording
+  private options: ReplayOptions
+  private reportManager: ReportManager
+  private sensorValues: Uint16Array
+  private inputState: DeviceInputState
+  private playbackStart = BigInt(0)
+  private nextReport = 0
+  private playbackTimeout: NodeJS.Timeout | null = null
+  private eventsSinceLastUpdate = 0
+  private eventRateInterval: NodeJS.Timeout
+  private calibration: Calibration | null = null
+  private closed = false
+
+  id: string
+
+  properties: DeviceProperties
+
+  configuration: DeviceConfiguration
+
+  constructor(id: string, recording: InputRecording, options: ReplayOptions) {
+    super()
+    const { properties, configuration } = recording.metadata
+
+    this.id = id
+    this.properties = { ...properties }
+    this.configuration = { ...configuration }
+    this.recording = recording
+    this.options = options
+    this.reportManager = new ReportManager({
+      buttonCount: properties.buttonCount,
+      sensorCount: properties.sensorCount
+    })
+    this.sensorValues = new Uint16Array(properties.sensorCount)
+    this.inputState = {
+      sensors: new Float32Array(properties.sensorCount),
+      buttons: new Uint8Array(properties.buttonCount)
+    }
+
+    this.eventRateInterval = setInterval(this.handleEventRateMeasurement, 1000)
+  }
+
+  public startPlayback() {
+    this.playbackStart = process.hrtime.bigint()
+    this.nextReport = 0
+    this.schedulePlayback()
+  }
+
+  private schedulePlayback() {
+    if (this.closed) {
+      return
+    }
+
+    if (this.options.speed > 0) {
+      this.playbackTimeout = setTimeout(this.playDueReports, 1)
+    } else {
+      setImmediate(this.playDueReports)
+    }
+  }
+
+  private playDueReports = () => {
+    const { timesNs, reports } = this.recording
+    const { speed } = this.options
+
+    if (speed > 0) {
+      const playedNs = Number(process.hrtime.bigint() - this.playbackStart) * speed
+
+      while (this.nextReport < reports.length && timesNs[this.nextReport] <= playedNs) {
+        this.playReport(reports[this.nextReport++])
+      }
+    } else {
+      const end = Math.min(this.nextReport + MAX_SPEED_BATCH_SIZE, reports.length)
+
+      while (this.nextReport < end) {
+        this.playReport(reports[this.nextReport++])
+      }
+    }
+
+    if (this.nextReport < reports.length) {
+      this.schedulePlayback()
+    } else if (this.options.loop) {
+      this.startPlayback()
+    } else {
+      consola.info(`Replay device "${this.id}" has played the whole recording`)
+    }
+  }
+
+  // same as Teensy2Device.handleData
+  private playReport(data: Buffer) {
+    this.eventsSinceLastUpdate++
+
+    const { buttons, sensors } = this.inputState
+
+    if (this.reportManager.decodeInputReport(data, buttons, this.sensorValues)) {
+      normalizeSensorValuesInto(
+        this.sensorValues,
+        this.recording.metadata.linearizedSensorValues,
+        sensors
+      )
+    }
+
+    if (this.calibration) {
+      this.updateCalibration(this.calibration)
+    }
+
+    this.emit('inputData', this.inputState)
+  }
+
+  private updateCalibration(calibration: Calibration) {
+    const { sensors } = this.inputState
+
+    for (let i = 0; i < sensors.length; i++) {
+      calibration.sums[i] += sensors[i]
+    }
+
+    if (++calibration.frames < CALIBRATION_FRAMES) {
+      return
+    }
+
+    this.configuration = {
+      ...this.configuration,
+      sensorThresholds: Array.from(calibration.sums, sum =>
+        clamp(sum / CALIBRATION_FRAMES + calibration.calibrationBuffer, 0, 1)
+      )
+    }
+
+    this.calibration = null
+    calibration.resolve()
+  }
+
+  private handleEventRateMeasurement = () => {
+    this.emit('eventRate', this.eventsSinceLastUpdate)
+    this.eventsSinceLastUpdate = 0
+  }
+
+  // buttons come from the recording, so configuration changes only show up
+  // in the configuration itself.
+  public async updateConfiguration(updates: Partial<DeviceConfiguration>) {
+    this.configuration = { ...this.configuration, ...updates }
+  }
+
+  public async saveConfiguration() {
+    // nowhere to save to
+  }
+
+  // averages sensors over as many reports as the device would, instead of
+  // the same time, so it works at any speed.
+  public calibrate(calibrationBuffer: number) {
+    return new Promise<void>(resolve => {
+      this.calibration = {
+        calibrationBuffer,
+        sums: new Float64Array(this.properties.sensorCount),
+        frames: 0,
+        resolve
+      }
+    })
+  }
+
+  close() {
+    this.closed = true
+    clearInterval(this.eventRateInterval)
+
+    if (this.playbackTimeout) {
+      clearTimeout(this.playbackTimeout)
+    }
+
+    if (this.calibration) {
+      this.calibration.resolve()
+      this.calibration = null
+    }
+
+    this.emit('disconnect')
+  }
+}
+
+export class ReplayDeviceDriver extends ExtendableEmitter<DeviceDriverEvents>()
+  implements DeviceDriver {
+  private options: ReplayOptions
+  private devices: ReplayDevice[] = []
+
+  constructor(options: ReplayOptions) {
+    super()
+    this.options = options
+  }
+
+  start() {
+    const recording = readInputRecording(this.options.recordingPath)
+    const name = path.basename(this.options.recordingPath)
+
+    if (recording.metadata.driver !== RECORDING_DRIVER) {
+      throw new Error(`Cannot replay reports of driver "${recording.metadata.driver}"`)
+    }
+
+    consola.info(
+      `Started ReplayDeviceDriver, playing ${recording.reports.length} reports from "${name}"`,
+      { speed: this.options.speed, deviceCount: this.options.deviceCount }
+    )
+
+    for (let i = 0; i < this.options.deviceCount; i++) {
+      const device = new ReplayDevice(`replay-${name}-${i}`, recording, this.options)
+      this.devices.push(device)
+      this.emit('newDevice', device)
+      device.startPlayback()
+    }
+  }
+
+  close() {
+    consola.info('Stopped ReplayDeviceDriver')
+    this.devices.forEach(device => device.close())
+    this.devices = []
+  }
+}
@@ -1,12 +1,33 @@
 import * as HID from 'node-hid'
+import path from 'path'
 import usbDetection from 'usb-detection'
 import consola from 'consola'
 import PQueue from 'p-queue'
 
 import { DeviceProperties, DeviceConfiguration } from '../../../../common-types/device'
 import { DeviceDriver, DeviceDriverEvents } from '../Driver'
-import { DeviceEvents, Device } from '../Device'
-import { ReportManager, ReportID } from './Teensy2Reports'
+import { DeviceEvents, Device, DeviceInputState, DeviceButtonEvent } from '../Device'
+import {
+  ReportManager,
+  ReportID,
+  InputReportMode,
+  ConfigurationReport,
+  PropertiesReport,
+  ProfilesReport,
+  PROPERTIES_REPORT_SIZE,
+  parsePropertiesReport,
+  RECORDING_DRIVER
+} from './Teensy2Reports'
+import {
+  linearizeSensorValues,
+  delinearizeSensorValues,
+  normalizeSensorValues,
+  denormalizeSensorValues,
+  normalizeLinearizedValues,
+  denormalizeLinearizedValues,
+  normalizeSensorValuesInto
+} from './Teensy2Linearization'
+import { InputRecordingWriter } from '../replay/InputRecording'
 import { ExtendableEmitter } from '../../util/ExtendableStrictEmitter'
 import delay from '../../util/delay'
 import { clamp } from 'lodash'
@@ -14,74 +35,80 @@ import { clamp } from 'lodash'
 export const VENDOR_ID = 0x03eb
 export const PRODUCT_ID = 0x204f
 
-// in future version, I'd like to device to tell this information
-const SENSOR_COUNT = 12
-const BUTTON_COUNT = 16
-
-const reportManager = new ReportManager({ buttonCount: BUTTON_COUNT, sensorCount: SENSOR_COUNT })
-
-const MAX_SENSOR_VALUE = 850 // Maximum value for a sensor reading. Depends on the used resistors in the setup.
-const NTH_DEGREE_COEFFICIENT = 0.9 // Magic number
-const FIRST_DEGREE_COEFFICIENT = 0.1 // Magic number jr.
-const LINEARIZATION_POWER = 4 // The linearization function degree / power
-
-const LINEARIZATION_MAX_VALUE = Math.pow(MAX_SENSOR_VALUE, LINEARIZATION_POWER) / MAX_SENSOR_VALUE
-
-const calculateLinearizationValue = (value: number): number => {
-  const linearizedValue = Math.pow(value, LINEARIZATION_POWER) / LINEARIZATION_MAX_VALUE
-  return linearizedValue * NTH_DEGREE_COEFFICIENT + value * FIRST_DEGREE_COEFFICIENT
-}
-
-interface LinearizationValue {
-  [key: string]: number
-}
-
-const LINEARIZATION_LOOKUP_TABLE: LinearizationValue = {}
-const DELINEARIZATION_LOOKUP_TABLE: LinearizationValue = {}
-const DELINEARIZATION_LOOKUP_DIGITS = 12
-
-for (let i = MAX_SENSOR_VALUE; i >= 0; i--) {
-  const linearizedValue = calculateLinearizationValue(i)
-  LINEARIZATION_LOOKUP_TABLE[i] = linearizedValue
-  DELINEARIZATION_LOOKUP_TABLE[Math.floor(linearizedValue)] = i
-  DELINEARIZATION_LOOKUP_TABLE[linearizedValue.toFixed(DELINEARIZATION_LOOKUP_DIGITS)] = i
-}
-
-const linearizeValue = (value: number) => {
-  value = clamp(value, 0, MAX_SENSOR_VALUE)
-
-  if (typeof LINEARIZATION_LOOKUP_TABLE[value] === 'undefined') {
-    return calculateLinearizationValue(value)
-  }
-
-  return LINEARIZATION_LOOKUP_TABLE[value]
-}
-
-const delinearizeValue = (value: number) => {
-  value = clamp(value, 0, MAX_SENSOR_VALUE)
-  const valueStr: string = value.toFixed(DELINEARIZATION_LOOKUP_DIGITS)
-
-  if (typeof DELINEARIZATION_LOOKUP_TABLE[valueStr] === 'undefined') {
-    value = Math.floor(value)
-    while (value > 0) {
-      const lookupValue = DELINEARIZATION_LOOKUP_TABLE[value]
-      if (typeof lookupValue !== 'undefined') {
-        return lookupValue
-      }
-      value--
-    }
-
-    return 0
-  }
-
-  return DELINEARIZATION_LOOKUP_TABLE[valueStr]
+// from this release on, device has a gamepad interface that is left for games,
+// and a telemetry interface for everything else. see Descriptors.h in firmware.
+const COMPOSITE_RELEASE = 0x0002
+const TELEMETRY_INTERFACE = 1
+
+// whether this is the interface of a device that we talk to
+export const isTeensy2Interface = (device: HID.Device) =>
+  device.productId === PRODUCT_ID &&
+  device.vendorId === VENDOR_ID &&
+  (device.release < COMPOSITE_RELEASE || device.interface === TELEMETRY_INTERFACE)
+
+// older firmware doesn't have properties report, and always has these
+const DEFAULT_PROPERTIES: PropertiesReport = { buttonCount: 16, sensorCount: 12 }
+
+// older firmware has a single configuration, and no profiles report to choose
+// which one configuration report returns
+const DEFAULT_PROFILES: ProfilesReport = {
+  profileCount: 1,
+  activeProfile: 0,
+  configurationProfile: 0
 }
 
-const linearizeSensorValues = (numbers: number[]) => numbers.map(linearizeValue)
-const delinearizeSensorValues = (numbers: number[]) => numbers.map(delinearizeValue)
-const normalizeSensorValues = (numbers: number[]) => numbers.map(n => n / MAX_SENSOR_VALUE)
-const denormalizeSensorValues = (numbers: number[]) =>
-  numbers.map(n => Math.floor(n * MAX_SENSOR_VALUE))
+// only receive input reports when a button changes or a sensor moves more than
+// this, instead of one every millisecond. keepalive makes sure sensor values
+// that have drifted less than the delta are eventually seen as well.
+const SENSOR_CHANGE_DELTA = 2
+const IDLE_KEEPALIVE_MS = 50
+
+// sensor values are shown at a much lower rate anyway. games get buttons from
+// the gamepad interface, so this doesn't slow them down.
+const REPORT_INTERVAL_MS = 4
+
+// device calibrates over a window of ~160 ms, see Calibration.h in firmware
+const CALIBRATION_POLL_INTERVAL_MS = 50
+const CALIBRATION_TIMEOUT_MS = 2000
+
+const average = (numbers: number[]) => numbers.reduce((a, b) => a + b, 0) / numbers.length
+
+// device configuration only has the fields of the active profile
+type ProfileConfiguration = Pick<
+  DeviceConfiguration,
+  | 'sensorThresholds'
+  | 'releaseThreshold'
+  | 'sensorReleaseThresholds'
+  | 'sensorToButtonMapping'
+  | 'sensorFilters'
+>
+
+const reportToProfileConfiguration = (report: ConfigurationReport): ProfileConfiguration => ({
+  sensorThresholds: report.linearizedThresholds
+    ? normalizeLinearizedValues(report.sensorThresholds)
+    : normalizeSensorValues(linearizeSensorValues(report.sensorThresholds)),
+  releaseThreshold: average(report.sensorReleaseThresholds),
+  sensorReleaseThresholds: report.sensorReleaseThresholds,
+  sensorToButtonMapping: report.sensorToButtonMapping,
+  sensorFilters: report.sensorFilters
+})
+
+// device compares linearized thresholds at no extra cost, so no need to
+// convert them back to raw values unless it's legacy firmware.
+const profileConfigurationToReport = (
+  profileIndex: number,
+  conf: ProfileConfiguration,
+  linearizedThresholds: boolean
+): ConfigurationReport => ({
+  profileIndex,
+  sensorThresholds: linearizedThresholds
+    ? denormalizeLinearizedValues(conf.sensorThresholds)
+    : delinearizeSensorValues(denormalizeSensorValues(conf.sensorThresholds)),
+  sensorReleaseThresholds: conf.sensorReleaseThresholds,
+  sensorToButtonMapping: conf.sensorToButtonMapping,
+  sensorFilters: conf.sensorFilters,
+  linearizedThresholds
+})
 
 export class Teensy2Device extends ExtendableEmitter<DeviceEvents>() implements Device {
   private device: HID.HID
@@ -90,40 +117,161 @@ export class Teensy2Device extends ExtendableEmitter<DeviceEvents>() implements
   private eventsSinceLastUpdate: number
   private eventRateInterval: NodeJS.Timeout
   private sendQueue: PQueue
+  private reportManager: ReportManager
+  // decoded from every input report. only these are written on every report,
+  // so that no garbage is created at 1 kHz.
+  private sensorValues: Uint16Array
+  private inputState: DeviceInputState
+  private linearizedSensorValues: boolean
+  // firmware takes linearized thresholds, see profileConfigurationToReport
+  private linearizedThresholds: boolean
+  // all profiles as they are in the device
+  private profiles: ConfigurationReport[]
+  private recordingWriter: InputRecordingWriter | null = null
+  // what the device said it had dropped in the previous button events report
+  private droppedButtonEvents: number | null = null
 
   id: string
 
-  properties: DeviceProperties = {
-    buttonCount: BUTTON_COUNT,
-    sensorCount: SENSOR_COUNT
-  }
+  properties: DeviceProperties
 
   configuration: DeviceConfiguration
 
-  static async fromDevicePath(devicePath: string, onClose: () => void): Promise<Teensy2Device> {
+  static async fromDevicePath(
+    devicePath: string,
+    release: number,
+    onClose: () => void,
+    recordingDirectory?: string
+  ): Promise<Teensy2Device> {
     const hidDevice = new HID.HID(devicePath)
 
     try {
-      const padConfigurationData = hidDevice.getFeatureReport(
-        ReportID.PAD_CONFIGURATION,
-        reportManager.getConfigurationReportSize()
-      )
-      const padConfigurationReport = reportManager.parseConfigurationReport(
-        Buffer.from(padConfigurationData)
-      )
+      let deviceProperties = DEFAULT_PROPERTIES
+
+      try {
+        const propertiesData = hidDevice.getFeatureReport(
+          ReportID.PROPERTIES,
+          PROPERTIES_REPORT_SIZE
+        )
+        deviceProperties = parsePropertiesReport(Buffer.from(propertiesData))
+      } catch (e) {
+        consola.debug(`Could not read properties of device in path "${devicePath}"`, e)
+      }
+
+      // released 0.0.1 firmware has the configuration report from before
+      // per-sensor release thresholds, and only understands raw thresholds.
+      const legacyConfiguration = release < COMPOSITE_RELEASE
+      const reportManager = new ReportManager({ ...deviceProperties, legacyConfiguration })
+
+      let profilesReport = DEFAULT_PROFILES
+      let hasProfiles = false
+
+      try {
+        const profilesData = hidDevice.getFeatureReport(
+          ReportID.PROFILES,
+          reportManager.getProfilesReportSize()
+        )
+        profilesReport = reportManager.parseProfilesReport(Buffer.from(profilesData))
+        hasProfiles = true
+      } catch (e) {
+        consola.debug(`Could not read profiles of device in path "${devicePath}"`, e)
+      }
+
+      // configuration report only has one profile, so choose which one to
+      // read before reading each of them.
+      const profiles: ConfigurationReport[] = []
+
+      for (let i = 0; i < profilesReport.profileCount; i++) {
+        if (hasProfiles) {
+          hidDevice.sendFeatureReport(reportManager.createProfilesReport(i))
+        }
+
+        const padConfigurationData = hidDevice.getFeatureReport(
+          ReportID.PAD_CONFIGURATION,
+          reportManager.getConfigurationReportSize()
+        )
+        const padConfigurationReport = reportManager.parseConfigurationReport(
+          Buffer.from(padConfigurationData)
+        )
+
+        profiles.push(padConfigurationReport)
+      }
 
       const nameData = hidDevice.getFeatureReport(ReportID.NAME, reportManager.getNameReportSize())
       const nameReport = reportManager.parseNameReport(Buffer.from(nameData))
 
+      // older firmware can't calibrate, so it doesn't track drift either.
+      let trackSensorDrift = false
+
+      try {
+        const calibrationData = hidDevice.getFeatureReport(
+          ReportID.CALIBRATION,
+          reportManager.getCalibrationReportSize()
+        )
+        const calibrationReport = reportManager.parseCalibrationReport(Buffer.from(calibrationData))
+        trackSensorDrift = calibrationReport.trackDrift
+      } catch (e) {
+        consola.debug(`Could not read calibration of device in path "${devicePath}"`, e)
+      }
+
       const configuration: DeviceConfiguration = {
         name: nameReport.name,
-        sensorThresholds: normalizeSensorValues(
-          linearizeSensorValues(padConfigurationReport.sensorThresholds)
-        ),
-        releaseThreshold: padConfigurationReport.releaseThreshold,
-        sensorToButtonMapping: padConfigurationReport.sensorToButtonMapping
+        activeProfile: profilesReport.activeProfile,
+        ...reportToProfileConfiguration(profiles[profilesReport.activeProfile]),
+        trackSensorDrift
+      }
+
+      // button events layout has packed sensor values, which have full
+      // resolution in less than half of the bytes, and linearized values can
+      // be used as is. peak values and button events keep taps that come and
+      // go between two reports visible. older firmware doesn't know this
+      // report and sends full reports instead, which are understood as well.
+      // it ignores the report without an error though, so sensor values are
+      // only taken as linearized when the device reports them back so.
+      let linearizedSensorValues = false
+
+      try {
+        hidDevice.sendFeatureReport(
+          reportManager.createReportingConfigurationReport({
+            inputReportMode: InputReportMode.BUTTON_EVENTS,
+            changeDriven: true,
+            sensorChangeDelta: SENSOR_CHANGE_DELTA,
+            idleKeepaliveMs: IDLE_KEEPALIVE_MS,
+            linearizedSensorValues: true,
+            reportIntervalMs: REPORT_INTERVAL_MS,
+            peakSensorValues: true
+          })
+        )
+
+        const reportingData = hidDevice.getFeatureReport(
+          ReportID.REPORTING_CONFIGURATION,
+          reportManager.getReportingConfigurationReportSize()
+        )
+        const reportingReport = reportManager.parseReportingConfigurationReport(
+          Buffer.from(reportingData)
+        )
+        linearizedSensorValues = reportingReport.linearizedSensorValues
+      } catch (e) {
+        consola.debug(`Could not select button events input reports for device in path "${devicePath}"`, e)
+      }
+
+      const device = new Teensy2Device(
+        devicePath,
+        deviceProperties,
+        reportManager,
+        configuration,
+        profiles,
+        linearizedSensorValues,
+        !legacyConfiguration,
+        hidDevice,
+        onClose
+      )
+
+      if (recordingDirectory) {
+        device.startRecording(recordingDirectory)
       }
-      return new Teensy2Device(devicePath, configuration, hidDevice, onClose)
+
+      return device
     } catch (e) {
       hidDevice.close()
       throw e
@@ -132,16 +280,35 @@ export class Teensy2Device extends ExtendableEmitter<DeviceEvents>() implements
 
   private constructor(
     path: string,
+    deviceProperties: PropertiesReport,
+    reportManager: ReportManager,
     configuration: DeviceConfiguration,
+    profiles: ConfigurationReport[],
+    linearizedSensorValues: boolean,
+    linearizedThresholds: boolean,
     device: HID.HID,
     onClose: () => void
   ) {
     super()
     this.path = path
     this.id = 'teensy-2-device-' + path
+    this.properties = {
+      buttonCount: deviceProperties.buttonCount,
+      sensorCount: deviceProperties.sensorCount,
+      profileCount: profiles.length
+    }
+    this.reportManager = reportManager
     this.configuration = configuration
+    this.profiles = profiles
+    this.linearizedSensorValues = linearizedSensorValues
+    this.linearizedThresholds = linearizedThresholds
     this.device = device
     this.onClose = onClose
+    this.sensorValues = new Uint16Array(deviceProperties.sensorCount)
+    this.inputState = {
+      sensors: new Float32Array(deviceProperties.sensorCount),
+      buttons: new Uint8Array(deviceProperties.buttonCount)
+    }
     this.device.on('error', this.handleError)
     this.device.on('data', this.handleData)
 
@@ -153,6 +320,23 @@ export class Teensy2Device extends ExtendableEmitter<DeviceEvents>() implements
     this.sendQueue = new PQueue({ concurrency: 1 })
   }
 
+  // writes every input report to a new file in given directory, so that they
+  // can be played back with ReplayDeviceDriver.
+  private startRecording(directory: string) {
+    const fileName = `${RECORDING_DRIVER}-${Date.now()}-${this.path.replace(/\W+/g, '_')}.adpr`
+    const recordingPath = path.join(directory, fileName)
+
+    this.recordingWriter = new InputRecordingWriter(recordingPath, {
+      driver: RECORDING_DRIVER,
+      recordedAt: new Date().toISOString(),
+      properties: this.properties,
+      configuration: this.configuration,
+      linearizedSensorValues: this.linearizedSensorValues
+    })
+
+    consola.info(`Recording input reports of device in path "${this.path}" to "${recordingPath}"`)
+  }
+
   private handleError = (e: Error) => {
     consola.error(`Error received from HID device in path "${this.path}":`, e)
     this.close()
@@ -160,17 +344,81 @@ export class Teensy2Device extends ExtendableEmitter<DeviceEvents>() implements
 
   private handleData = (data: Buffer) => {
     this.eventsSinceLastUpdate++
-    const inputReport = reportManager.parseInputReport(data)
 
-    this.emit('inputData', {
-      buttons: inputReport.buttons,
-      sensors: normalizeSensorValues(linearizeSensorValues(inputReport.sensorValues))
-    })
+    if (this.recordingWriter) {
+      this.recordingWriter.write(data)
+    }
+
+    const { buttons, sensors } = this.inputState
+
+    if (this.reportManager.decodeInputReport(data, buttons, this.sensorValues)) {
+      normalizeSensorValuesInto(this.sensorValues, this.linearizedSensorValues, sensors)
+    }
+
+    this.emit('inputData', this.inputState)
+
+    if (data[0] === ReportID.BUTTON_EVENTS_INPUT) {
+      this.handleButtonEvents(data)
+    }
+  }
+
+  // turns event ages to times on our own clock, measured from when the report
+  // arrived. USB transfer time is left out, but it's the same for every event.
+  private handleButtonEvents = (data: Buffer) => {
+    const parsed = this.reportManager.parseButtonEvents(data)
+
+    if (!parsed) {
+      return
+    }
+
+    const { buttonEvents, droppedButtonEvents } = parsed
+
+    if (this.droppedButtonEvents !== null && droppedButtonEvents !== this.droppedButtonEvents) {
+      const dropped = (droppedButtonEvents - this.droppedButtonEvents) & 0xff
+      consola.warn(`Device in path "${this.path}" dropped ${dropped} button events`)
+    }
+
+    this.droppedButtonEvents = droppedButtonEvents
+
+    if (buttonEvents.length === 0) {
+      return
+    }
+
+    const receivedUs = Number(process.hrtime.bigint()) / 1000
+    const events: DeviceButtonEvent[] = buttonEvents.map(event => ({
+      button: event.button,
+      pressed: event.pressed,
+      timeUs: receivedUs - event.ageUs
+    }))
+
+    this.emit('buttonEvents', events)
   }
 
   private handleEventRateMeasurement = () => {
     this.emit('eventRate', this.eventsSinceLastUpdate)
     this.eventsSinceLastUpdate = 0
+    this.requestTelemetry()
+
+    if (this.recordingWriter) {
+      this.recordingWriter.flush()
+    }
+  }
+
+  private requestTelemetry = async () => {
+    try {
+      const telemetry = await this.sendEventToQueue(async () => {
+        const data = this.device.getFeatureReport(
+          ReportID.TELEMETRY,
+          this.reportManager.getTelemetryReportSize()
+        )
+        return this.reportManager.parseTelemetryReport(Buffer.from(data))
+      })
+
+      this.emit('telemetry', telemetry)
+    } catch (e) {
+      // older firmware doesn't have telemetry, that's fine.
+      consola.debug(`Could not read telemetry from device in path "${this.path}":`, e)
+    }
   }
 
   // What's the idea here? Well - node-hid doesn't like if we do multiple
@@ -185,40 +433,160 @@ export class Teensy2Device extends ExtendableEmitter<DeviceEvents>() implements
   }
 
   public async updateConfiguration(updates: Partial<DeviceConfiguration>) {
-    const newConfiguration = { ...this.configuration, ...updates }
+    const { activeProfile, ...otherUpdates } = updates
+
+    // switching profile is instant on the device, and the rest of the
+    // configuration comes from the profile switched to. other updates are
+    // then applied to that profile.
+    if (
+      activeProfile !== undefined &&
+      activeProfile !== this.configuration.activeProfile &&
+      this.profiles[activeProfile]
+    ) {
+      await this.sendEventToQueue(async () => {
+        this.device.write(this.reportManager.createSelectProfileReport(activeProfile))
+      })
+
+      this.configuration = {
+        ...this.configuration,
+        activeProfile,
+        ...reportToProfileConfiguration(this.profiles[activeProfile])
+      }
+
+      if (Object.keys(otherUpdates).length === 0) {
+        return
+      }
+    }
+
+    const newConfiguration = { ...this.configuration, ...otherUpdates }
+
+    // global release threshold is a shortcut for setting it to all sensors
+    if (
+      updates.releaseThreshold !== undefined &&
+      updates.releaseThreshold !== this.configuration.releaseThreshold &&
+      updates.sensorReleaseThresholds === undefined
+    ) {
+      newConfiguration.sensorReleaseThresholds = new Array(this.properties.sensorCount).fill(
+        updates.releaseThreshold
+      )
+    }
+
+    if (newConfiguration.trackSensorDrift !== this.configuration.trackSensorDrift) {
+      await this.sendEventToQueue(async () => {
+        const report = this.reportManager.createCalibrationReport(newConfiguration.trackSensorDrift)
+        this.device.sendFeatureReport(report)
+      })
+    }
 
     // TODO: only send configuration reports that are necessary
 
+    const profile = profileConfigurationToReport(
+      newConfiguration.activeProfile,
+      newConfiguration,
+      this.linearizedThresholds
+    )
+
     await this.sendEventToQueue(async () => {
-      const report = reportManager.createConfigurationReport({
-        releaseThreshold: newConfiguration.releaseThreshold,
-        sensorThresholds: delinearizeSensorValues(
-          denormalizeSensorValues(newConfiguration.sensorThresholds)
-        ),
-        sensorToButtonMapping: newConfiguration.sensorToButtonMapping
-      })
+      const report = this.reportManager.createConfigurationReport(profile)
       this.device.sendFeatureReport(report)
     })
 
     await this.sendEventToQueue(async () => {
-      const report = reportManager.createNameReport({ name: newConfiguration.name })
+      const report = this.reportManager.createNameReport({ name: newConfiguration.name })
       this.device.sendFeatureReport(report)
     })
 
+    this.profiles[newConfiguration.activeProfile] = profile
     this.configuration = newConfiguration
   }
 
   public async saveConfiguration() {
     await this.sendEventToQueue(async () => {
-      this.device.write(reportManager.createSaveConfigurationReport())
+      this.device.write(this.reportManager.createSaveConfigurationReport())
     })
   }
 
+  private readCalibrationReport = () =>
+    this.sendEventToQueue(async () => {
+      const data = this.device.getFeatureReport(
+        ReportID.CALIBRATION,
+        this.reportManager.getCalibrationReportSize()
+      )
+      return this.reportManager.parseCalibrationReport(Buffer.from(data))
+    })
+
+  private calculateCalibrationBuffers = async (calibrationBuffer: number) => {
+    const { activeProfile } = this.configuration
+
+    // device adds buffer to linearized baselines, so it can be used as is.
+    if (this.profiles[activeProfile].linearizedThresholds) {
+      const buffer = denormalizeLinearizedValues([calibrationBuffer])[0]
+      return new Array(this.properties.sensorCount).fill(buffer)
+    }
+
+    // profile has raw thresholds, so convert buffer separately for every
+    // sensor based on their current baselines.
+    const { baselines } = await this.readCalibrationReport()
+    const thresholds = delinearizeSensorValues(
+      denormalizeSensorValues(
+        normalizeSensorValues(linearizeSensorValues(baselines)).map(value =>
+          clamp(value + calibrationBuffer, 0, 1)
+        )
+      )
+    )
+
+    return thresholds.map((threshold, i) => Math.max(threshold - baselines[i], 0))
+  }
+
+  public async calibrate(calibrationBuffer: number) {
+    const sensorBuffers = await this.calculateCalibrationBuffers(calibrationBuffer)
+
+    await this.sendEventToQueue(async () => {
+      this.device.write(this.reportManager.createCalibrateReport(sensorBuffers))
+    })
+
+    let calibrating = true
+    let waitedMs = 0
+
+    while (calibrating && waitedMs < CALIBRATION_TIMEOUT_MS) {
+      await delay(CALIBRATION_POLL_INTERVAL_MS)
+      waitedMs += CALIBRATION_POLL_INTERVAL_MS
+      calibrating = (await this.readCalibrationReport()).calibrating
+    }
+
+    if (calibrating) {
+      throw new Error(`Calibration of device in path "${this.path}" did not finish`)
+    }
+
+    // device has set and stored the new thresholds, read them back.
+    const { activeProfile } = this.configuration
+    const padConfigurationReport = await this.sendEventToQueue(async () => {
+      this.device.sendFeatureReport(this.reportManager.createProfilesReport(activeProfile))
+      const data = this.device.getFeatureReport(
+        ReportID.PAD_CONFIGURATION,
+        this.reportManager.getConfigurationReportSize()
+      )
+      return this.reportManager.parseConfigurationReport(Buffer.from(data))
+    })
+
+    this.profiles[activeProfile] = padConfigurationReport
+    this.configuration = {
+      ...this.configuration,
+      ...reportToProfileConfiguration(padConfigurationReport)
+    }
+  }
+
   close() {
     clearInterval(this.eventRateInterval)
     this.sendQueue.pause()
     this.sendQueue.clear()
     this.device.close()
+
+    if (this.recordingWriter) {
+      this.recordingWriter.close()
+      this.recordingWriter = null
+    }
+
     this.onClose()
     this.emit('disconnect')
   }
@@ -227,13 +595,26 @@ export class Teensy2Device extends ExtendableEmitter<DeviceEvents>() implements
 export class Teensy2DeviceDriver extends ExtendableEmitter<DeviceDriverEvents>()
   implements DeviceDriver {
   private knownDevicePaths = new Set<string>()
+  private recordingDirectory?: string
 
-  private connectDevice = async (devicePath: string) => {
+  // input reports of every device are recorded to files in
+  // recordingDirectory, if given
+  constructor(recordingDirectory?: string) {
+    super()
+    this.recordingDirectory = recordingDirectory
+  }
+
+  private connectDevice = async (devicePath: string, release: number) => {
     this.knownDevicePaths.add(devicePath)
 
     try {
       const handleClose = () => this.knownDevicePaths.delete(devicePath)
-      const newDevice = await Teensy2Device.fromDevicePath(devicePath, handleClose)
+      const newDevice = await Teensy2Device.fromDevicePath(
+        devicePath,
+        release,
+        handleClose,
+        this.recordingDirectory
+      )
       this.emit('newDevice', newDevice)
     } catch (e) {
       this.knownDevicePaths.delete(devicePath)
@@ -244,7 +625,7 @@ export class Teensy2DeviceDriver extends ExtendableEmitter<DeviceDriverEvents>()
   private connectToNewDevices() {
     HID.devices().forEach(device => {
       // only known devices
-      if (device.productId !== PRODUCT_ID || device.vendorId !== VENDOR_ID) {
+      if (!isTeensy2Interface(device)) {
         return
       }
 
@@ -264,7 +645,7 @@ export class Teensy2DeviceDriver extends ExtendableEmitter<DeviceDriverEvents>()
       // Linux needs a while from plugging the device in to be able to use it with hidraw. Thus,
       // let's wait for a while! Windows doesn't seem to have the same problem, but certainly no
       // one is in such a hurry they can't wait a second, right?
-      setTimeout(() => this.connectDevice(devicePath), 1000)
+      setTimeout(() => this.connectDevice(devicePath, device.release), 1000)
     })
   }
 
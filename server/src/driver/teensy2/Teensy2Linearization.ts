@@ -0,0 +1,79 @@
+import { clamp } from 'lodash'
+
+// linearization curve, same as LINEARIZATION_CURVE in DancePadConfig.h of firmware
+const MAX_SENSOR_VALUE = 850 // Maximum value for a sensor reading. Depends on the used resistors in the setup.
+const NTH_DEGREE_COEFFICIENT = 0.9 // Magic number
+const FIRST_DEGREE_COEFFICIENT = 0.1 // Magic number jr.
+const LINEARIZATION_POWER = 4 // The linearization function degree / power
+
+const LINEARIZATION_MAX_VALUE = Math.pow(MAX_SENSOR_VALUE, LINEARIZATION_POWER) / MAX_SENSOR_VALUE
+
+const calculateLinearizationValue = (value: number): number => {
+  const linearizedValue = Math.pow(value, LINEARIZATION_POWER) / LINEARIZATION_MAX_VALUE
+  return linearizedValue * NTH_DEGREE_COEFFICIENT + value * FIRST_DEGREE_COEFFICIENT
+}
+
+// curve is increasing, so raw values can be found from this with a binary search
+const LINEARIZATION_LOOKUP_TABLE = new Float64Array(MAX_SENSOR_VALUE + 1)
+
+for (let i = 0; i <= MAX_SENSOR_VALUE; i++) {
+  LINEARIZATION_LOOKUP_TABLE[i] = calculateLinearizationValue(i)
+}
+
+const linearizeValue = (value: number) => {
+  value = clamp(value, 0, MAX_SENSOR_VALUE)
+
+  if (!Number.isInteger(value)) {
+    return calculateLinearizationValue(value)
+  }
+
+  return LINEARIZATION_LOOKUP_TABLE[value]
+}
+
+// largest raw value that linearizes to at most given value
+const delinearizeValue = (value: number) => {
+  let low = 0
+  let high = MAX_SENSOR_VALUE
+
+  while (low < high) {
+    const middle = Math.ceil((low + high) / 2)
+
+    if (LINEARIZATION_LOOKUP_TABLE[middle] <= value) {
+      low = middle
+    } else {
+      high = middle - 1
+    }
+  }
+
+  return low
+}
+
+export const linearizeSensorValues = (numbers: number[]) => numbers.map(linearizeValue)
+export const delinearizeSensorValues = (numbers: number[]) => numbers.map(delinearizeValue)
+
+export const normalizeSensorValues = (numbers: number[]) => numbers.map(n => n / MAX_SENSOR_VALUE)
+export const denormalizeSensorValues = (numbers: number[]) =>
+  numbers.map(n => Math.floor(n * MAX_SENSOR_VALUE))
+
+// values linearized by device, see Linearization.h in firmware
+const LINEARIZED_MAX_VALUE = 1023
+
+export const normalizeLinearizedValues = (numbers: number[]) =>
+  numbers.map(n => n / LINEARIZED_MAX_VALUE)
+export const denormalizeLinearizedValues = (numbers: number[]) =>
+  numbers.map(n => Math.round(clamp(n, 0, 1) * LINEARIZED_MAX_VALUE))
+
+// same as normalizing linearized values, or linearizing and normalizing raw
+// ones, but writes to given array instead of allocating new ones. used for
+// every input report.
+export const normalizeSensorValuesInto = (
+  values: Uint16Array,
+  linearized: boolean,
+  result: Float32Array
+) => {
+  for (let i = 0; i < values.length; i++) {
+    result[i] = linearized
+      ? values[i] / LINEARIZED_MAX_VALUE
+      : LINEARIZATION_LOOKUP_TABLE[Math.min(values[i], MAX_SENSOR_VALUE)] / MAX_SENSOR_VALUE
+  }
+}
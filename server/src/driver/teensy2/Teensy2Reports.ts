@@ -1,52 +1,396 @@
 import { Parser } from 'binary-parser'
+import { clamp } from 'lodash'
+import {
+  DeviceTelemetry,
+  DeviceTelemetryHistogram,
+  SensorFilter
+} from '../../../../common-types/device'
 
 const MAX_NAME_SIZE = 50
 
+// see Telemetry.h in firmware
+const TELEMETRY_TICKS_PER_US = 2
+const TELEMETRY_BUCKET_COUNT = 8
+const TELEMETRY_SCAN_DURATION_SHIFT = 3
+const TELEMETRY_PRESS_LATENCY_SHIFT = 6
+const TELEMETRY_CALLBACK_JITTER_SHIFT = 0
+const TELEMETRY_SAMPLE_AGE_SHIFT = 5
+
+// see Pad.h in firmware
+const SENSOR_FILTER_EMA_SHIFT_MASK = 0x07
+const SENSOR_FILTER_MEDIAN_OF_3 = 0x08
+const SENSOR_FILTER_DEADBAND_SHIFT = 4
+const SENSOR_FILTER_MAX_EMA_SHIFT = 6
+const SENSOR_FILTER_MAX_DEADBAND = 15
+
+// see PadConfiguration in firmware
+const PAD_CONFIGURATION_LINEARIZED_THRESHOLDS = 0x01
+
+// release thresholds are fractions of sensor thresholds in 1/256ths
+const SENSOR_RELEASE_THRESHOLD_SCALE = 256
+const SENSOR_RELEASE_THRESHOLD_MAX = 255
+
+// legacy configuration report has no filters, so they are all off
+const LEGACY_SENSOR_FILTER: SensorFilter = { medianOf3: false, emaShift: 0, deadband: 0 }
+
+// input recordings made from these reports are marked with this, see
+// InputRecording.ts
+export const RECORDING_DRIVER = 'teensy2'
+
 export enum ReportID {
   SENSOR_VALUES = 0x01,
   PAD_CONFIGURATION = 0x02,
   RESET = 0x03,
   SAVE_CONFIGURATION = 0x04,
-  NAME = 0x05
+  NAME = 0x05,
+  TELEMETRY = 0x07,
+  REPORTING_CONFIGURATION = 0x08,
+  BUTTONS_INPUT = 0x09,
+  PACKED_SENSORS_INPUT = 0x0a,
+  SCALED_SENSORS_INPUT = 0x0b,
+  BATCHED_SENSORS_INPUT = 0x0c,
+  SELECT_PROFILE = 0x0d,
+  PROFILES = 0x0e,
+  CALIBRATE = 0x0f,
+  CALIBRATION = 0x10,
+  PROPERTIES = 0x11,
+  PEAK_SENSORS_INPUT = 0x12,
+  BUTTON_EVENTS_INPUT = 0x13,
+  CAPTURE = 0x14,
+  CAPTURE_SAMPLES = 0x15,
+  ADC_SPEED = 0x16,
+  CHARACTERIZE = 0x17,
+  CHARACTERIZATION = 0x18
+}
+
+// see Communication.h in firmware
+export enum InputReportMode {
+  FULL = 0,
+  BUTTONS = 1,
+  PACKED_SENSORS = 2,
+  SCALED_SENSORS = 3,
+  BATCHED_SENSORS = 4,
+  PEAK_SENSORS = 5,
+  BUTTON_EVENTS = 6
+}
+
+// see BatchedSensorsInputHIDReport in firmware
+const BATCHED_TIME_DELTA_TICKS = 16
+
+// see ButtonEvent in firmware
+const BUTTON_EVENT_INDEX_MASK = 0x1f
+const BUTTON_EVENT_PRESSED = 0x80
+const BUTTON_EVENT_SIZE = 3
+
+export interface ButtonEvent {
+  button: number
+  pressed: boolean
+  // how long before the report was written this was scanned
+  ageUs: number
+}
+
+export interface SensorFrame {
+  // scan sequence number, wraps around at 16 bits. gaps mean skipped frames.
+  sequence: number
+  // when the frame was scanned. wraps around every ~32.8 ms.
+  timestampUs: number
+  sensorValues: number[]
 }
 
 export interface InputReport {
   buttons: boolean[]
-  sensorValues: number[]
+  // null when device only reports buttons
+  sensorValues: number[] | null
+  // every scanned frame since previous report, when using batched reports
+  sensorFrames?: SensorFrame[]
+  // highest and lowest values since previous report, when using peak reports
+  sensorMaxima?: number[]
+  sensorMinima?: number[]
+  // presses and releases since previous report, oldest first, when using
+  // button events reports
+  buttonEvents?: ButtonEvent[]
+  // events that device had no room for since it started, wraps around at 8 bits
+  droppedButtonEvents?: number
+}
+
+export interface ReportingConfigurationReport {
+  inputReportMode: InputReportMode
+  // only send input reports when something has changed, see Communication.h in firmware
+  changeDriven: boolean
+  sensorChangeDelta: number
+  idleKeepaliveMs: number
+  // sensor values are linearized by device, see Linearization.h in firmware
+  linearizedSensorValues: boolean
+  // input reports are sent at most this often, 0 = every poll
+  reportIntervalMs: number
+  // sensor values are the highest ones since previous report
+  peakSensorValues: boolean
 }
 
 export interface ConfigurationReport {
+  profileIndex: number
   sensorThresholds: number[]
-  releaseThreshold: number
+  sensorReleaseThresholds: number[]
   sensorToButtonMapping: number[]
+  sensorFilters: SensorFilter[]
+  // thresholds are in linearized units instead of raw ones
+  linearizedThresholds: boolean
+}
+
+export interface ProfilesReport {
+  profileCount: number
+  activeProfile: number
+  // profile that configuration report is read from
+  configurationProfile: number
+}
+
+export interface CalibrationReport {
+  // thresholds follow slow changes in baselines
+  trackDrift: boolean
+  calibrating: boolean
+  // average idle value of every sensor, in raw sensor units even when the
+  // active profile has linearized thresholds
+  baselines: number[]
+  // difference of highest and lowest value during last ~160 ms
+  noise: number[]
 }
 
 export interface NameReport {
   name: string
 }
 
+export interface PropertiesReport {
+  buttonCount: number
+  sensorCount: number
+}
+
+// see PropertiesFeatureHIDReport in firmware. rest of the reports depend on
+// these counts, so this one is read before there is a ReportManager.
+export const PROPERTIES_REPORT_SIZE = 1 + 1 + 1
+
+export const parsePropertiesReport = (data: Buffer): PropertiesReport => ({
+  buttonCount: data.readUInt8(1),
+  sensorCount: data.readUInt8(2)
+})
+
+// see AdcCaptureSettings in firmware
+const CAPTURE_MAX_SENSORS = 4
+const CAPTURE_TRIGGER_RISING = 0x01
+const CAPTURE_TRIGGER_FALLING = 0x02
+const CAPTURE_PAGE_SIZE = 64
+
+export enum CaptureState {
+  IDLE = 0,
+  WAITING = 1, // for the trigger
+  RUNNING = 2,
+  DONE = 3
+}
+
+export interface CaptureSettings {
+  // first one is the one that triggers capture
+  sensors: number[]
+  // per sensor, device caps this to what fits its buffer
+  sampleCount: number
+  // of sampleCount, how many are from before the trigger
+  preTriggerCount: number
+  // 8-bit, like samples. null captures right away
+  triggerLevel: number | null
+  triggerFalling: boolean
+}
+
+export interface CaptureSamplesReport {
+  state: CaptureState
+  sensorCount: number
+  sampleCount: number
+  triggerPosition: number
+  // from the trigger to the last sample
+  durationUs: number
+  offset: number
+  // samples of all sensors interleaved, from offset on
+  samples: Buffer
+}
+
+// capture reports don't depend on sensor count, so they don't need a
+// ReportManager either. see CaptureHIDReport in firmware.
+export const createCaptureReport = (settings: CaptureSettings | null): number[] => {
+  // 1 for report id
+  // 1 for every sensor (uint8), 1 for sensor count (uint8)
+  // 2 for sample count, 2 for pre-trigger count (uint16)
+  // 1 for trigger level, 1 for trigger flags (uint8)
+  const buffer = Buffer.alloc(1 + CAPTURE_MAX_SENSORS + 1 + 2 + 2 + 1 + 1)
+  buffer.writeUInt8(ReportID.CAPTURE, 0)
+
+  // no settings stops capture
+  if (!settings) {
+    return [...buffer]
+  }
+
+  const sensors = settings.sensors.slice(0, CAPTURE_MAX_SENSORS)
+  sensors.forEach((sensor, i) => buffer.writeUInt8(sensor, 1 + i))
+  buffer.writeUInt8(sensors.length, 1 + CAPTURE_MAX_SENSORS)
+  buffer.writeUInt16LE(settings.sampleCount, 2 + CAPTURE_MAX_SENSORS)
+  buffer.writeUInt16LE(settings.preTriggerCount, 4 + CAPTURE_MAX_SENSORS)
+
+  if (settings.triggerLevel !== null) {
+    buffer.writeUInt8(settings.triggerLevel, 6 + CAPTURE_MAX_SENSORS)
+    buffer.writeUInt8(
+      settings.triggerFalling ? CAPTURE_TRIGGER_FALLING : CAPTURE_TRIGGER_RISING,
+      7 + CAPTURE_MAX_SENSORS
+    )
+  }
+
+  return [...buffer]
+}
+
+// see CaptureSamplesFeatureHIDReport in firmware
+// 1 for report id
+// 1 for state, 1 for sensor count (uint8)
+// 2 for sample count, 2 for trigger position, 2 for duration (uint16)
+// 2 for offset (uint16)
+// 1 for every sample in a page (uint8)
+export const CAPTURE_SAMPLES_REPORT_SIZE = 1 + 1 + 1 + 2 + 2 + 2 + 2 + CAPTURE_PAGE_SIZE
+
+// only offset can be written, rest are read only
+export const createCaptureSamplesReport = (offset: number): number[] => {
+  const buffer = Buffer.alloc(CAPTURE_SAMPLES_REPORT_SIZE)
+  buffer.writeUInt8(ReportID.CAPTURE_SAMPLES, 0)
+  buffer.writeUInt16LE(offset, 9)
+  return [...buffer]
+}
+
+export const parseCaptureSamplesReport = (data: Buffer): CaptureSamplesReport => ({
+  state: data.readUInt8(1),
+  sensorCount: data.readUInt8(2),
+  sampleCount: data.readUInt16LE(3),
+  triggerPosition: data.readUInt16LE(5),
+  durationUs: data.readUInt16LE(7) / TELEMETRY_TICKS_PER_US,
+  offset: data.readUInt16LE(9),
+  samples: data.subarray(11, 11 + CAPTURE_PAGE_SIZE)
+})
+
+// see AdcSpeedSettings in firmware
+export interface AdcSpeedSettings {
+  // ADC clock is cpu clock divided by 2^prescaler, 1-7
+  prescaler: number
+  highSpeed: boolean
+  // only the 8 most significant bits are converted, values stay 10-bit
+  eightBit: boolean
+}
+
+// 1 for prescaler (uint8), 1 for high speed, 1 for eight bit (bool)
+const ADC_SPEED_SETTINGS_SIZE = 1 + 1 + 1
+
+const writeAdcSpeedSettings = (buffer: Buffer, settings: AdcSpeedSettings, pos: number) => {
+  buffer.writeUInt8(settings.prescaler, pos)
+  buffer.writeUInt8(settings.highSpeed ? 1 : 0, pos + 1)
+  buffer.writeUInt8(settings.eightBit ? 1 : 0, pos + 2)
+}
+
+const readAdcSpeedSettings = (data: Buffer, pos: number): AdcSpeedSettings => ({
+  prescaler: data.readUInt8(pos),
+  highSpeed: data.readUInt8(pos + 1) !== 0,
+  eightBit: data.readUInt8(pos + 2) !== 0
+})
+
+// see AdcSpeedFeatureHIDReport in firmware. stored with SAVE_CONFIGURATION.
+export const ADC_SPEED_REPORT_SIZE = 1 + ADC_SPEED_SETTINGS_SIZE
+
+export const createAdcSpeedReport = (settings: AdcSpeedSettings): number[] => {
+  const buffer = Buffer.alloc(ADC_SPEED_REPORT_SIZE)
+  buffer.writeUInt8(ReportID.ADC_SPEED, 0)
+  writeAdcSpeedSettings(buffer, settings, 1)
+  return [...buffer]
+}
+
+export const parseAdcSpeedReport = (data: Buffer): AdcSpeedSettings =>
+  readAdcSpeedSettings(data, 1)
+
+// starts measuring given settings, see CharacterizeHIDReport in firmware
+export const createCharacterizeReport = (settings: AdcSpeedSettings): number[] => {
+  const buffer = Buffer.alloc(1 + ADC_SPEED_SETTINGS_SIZE)
+  buffer.writeUInt8(ReportID.CHARACTERIZE, 0)
+  writeAdcSpeedSettings(buffer, settings, 1)
+  return [...buffer]
+}
+
+export interface CharacterizationReport {
+  settings: AdcSpeedSettings
+  measuring: boolean
+  conversionsPerSecond: number
+  // variance of every sensor while idle, in raw units squared
+  noise: number[]
+}
+
+// see CharacterizationState in firmware
+const CHARACTERIZATION_NOISE_SCALE = 16
+
 export class ReportManager {
   private buttonCount: number
   private sensorCount: number
+  // every input report starts with report id and a bit for every button,
+  // see InputHIDReport in firmware
+  private buttonBytes: number
+  private sensorOffset: number
+  // configuration report has the layout of 0.0.1 firmware, which has raw
+  // thresholds and one release multiplier for every sensor
+  private legacyConfiguration: boolean
   private inputReportParser: Parser<any>
   private configurationReportParser: Parser<any>
+  private legacyConfigurationReportParser: Parser<any>
+  private reportingConfigurationReportParser: Parser<any>
+  private profilesReportParser: Parser<any>
+  private calibrationReportParser: Parser<any>
   private nameReportParser: Parser<any>
+  private telemetryReportParser: Parser<any>
 
-  constructor(settings: { buttonCount: number; sensorCount: number }) {
+  constructor(settings: {
+    buttonCount: number
+    sensorCount: number
+    legacyConfiguration?: boolean
+  }) {
     this.buttonCount = settings.buttonCount
     this.sensorCount = settings.sensorCount
+    this.legacyConfiguration = settings.legacyConfiguration || false
+    this.buttonBytes = Math.ceil(settings.buttonCount / 8)
+    this.sensorOffset = 1 + this.buttonBytes
 
     this.inputReportParser = new Parser()
       .uint8('reportId', {
         assert: ReportID.SENSOR_VALUES
       })
-      .uint16le('buttonBits')
+      .array('buttonBytes', {
+        type: 'uint8',
+        length: this.buttonBytes
+      })
       .array('sensorValues', {
         type: 'uint16le',
         length: settings.sensorCount
       })
 
     this.configurationReportParser = new Parser()
+      .uint8('reportId', {
+        assert: ReportID.PAD_CONFIGURATION
+      })
+      .uint8('profileIndex')
+      .array('sensorThresholds', {
+        type: 'uint16le',
+        length: this.sensorCount
+      })
+      .array('sensorReleaseThresholds', {
+        type: 'uint8',
+        length: this.sensorCount
+      })
+      .array('sensorToButtonMapping', {
+        type: 'int8',
+        length: this.sensorCount
+      })
+      .array('sensorFilters', {
+        type: 'uint8',
+        length: this.sensorCount
+      })
+      .uint8('flags')
+
+    this.legacyConfigurationReportParser = new Parser()
       .uint8('reportId', {
         assert: ReportID.PAD_CONFIGURATION
       })
@@ -60,12 +404,63 @@ export class ReportManager {
         length: this.sensorCount
       })
 
+    this.reportingConfigurationReportParser = new Parser()
+      .uint8('reportId', {
+        assert: ReportID.REPORTING_CONFIGURATION
+      })
+      .uint8('inputReportMode')
+      .uint8('changeDriven')
+      .uint8('sensorChangeDelta')
+      .uint16le('idleKeepaliveMs')
+      .uint8('linearizedSensorValues')
+      .uint8('reportIntervalMs')
+      .uint8('peakSensorValues')
+
+    this.profilesReportParser = new Parser()
+      .uint8('reportId', {
+        assert: ReportID.PROFILES
+      })
+      .uint8('profileCount')
+      .uint8('activeProfile')
+      .uint8('configurationProfile')
+
+    this.calibrationReportParser = new Parser()
+      .uint8('reportId', {
+        assert: ReportID.CALIBRATION
+      })
+      .uint8('trackDrift')
+      .uint8('calibrating')
+      .array('baselines', {
+        type: 'uint16le',
+        length: this.sensorCount
+      })
+      .array('noise', {
+        type: 'uint8',
+        length: this.sensorCount
+      })
+
     this.nameReportParser = new Parser()
       .uint8('reportId', {
         assert: ReportID.NAME
       })
       .uint8('size')
       .string('name', { length: 'size' })
+
+    const telemetryHistogramParser = new Parser()
+      .array('buckets', {
+        type: 'uint16le',
+        length: TELEMETRY_BUCKET_COUNT
+      })
+      .uint16le('max')
+
+    this.telemetryReportParser = new Parser()
+      .uint8('reportId', {
+        assert: ReportID.TELEMETRY
+      })
+      .nest('scanDuration', { type: telemetryHistogramParser })
+      .nest('pressLatency', { type: telemetryHistogramParser })
+      .nest('callbackJitter', { type: telemetryHistogramParser })
+      .nest('sampleAge', { type: telemetryHistogramParser })
   }
 
   private formatButtons = (data: number) => {
@@ -78,22 +473,333 @@ export class ReportManager {
     return bitArray
   }
 
+  private readButtonBits = (data: Buffer): number => data.readUIntLE(1, this.buttonBytes)
+
+  private parseSensorFilter = (data: number): SensorFilter => ({
+    medianOf3: (data & SENSOR_FILTER_MEDIAN_OF_3) !== 0,
+    emaShift: data & SENSOR_FILTER_EMA_SHIFT_MASK,
+    deadband: data >> SENSOR_FILTER_DEADBAND_SHIFT
+  })
+
+  private createSensorFilter = (filter: SensorFilter): number =>
+    Math.min(filter.emaShift, SENSOR_FILTER_MAX_EMA_SHIFT) |
+    (filter.medianOf3 ? SENSOR_FILTER_MEDIAN_OF_3 : 0) |
+    (Math.min(filter.deadband, SENSOR_FILTER_MAX_DEADBAND) << SENSOR_FILTER_DEADBAND_SHIFT)
+
+  // every group of 4 sensors is packed to 5 bytes as a little endian bit stream
+  private unpackSensorValuesInto = (
+    data: Buffer,
+    offset: number,
+    values: number[] | Uint16Array
+  ) => {
+    for (let i = 0; i < this.sensorCount; i++) {
+      const bit = (i % 4) * 10
+      const pos = offset + Math.floor(i / 4) * 5 + (bit >> 3)
+      values[i] = ((data[pos] | (data[pos + 1] << 8)) >> (bit & 7)) & 0x3ff
+    }
+  }
+
+  private unpackSensorValues = (data: Buffer, offset: number): number[] => {
+    const values = new Array(this.sensorCount)
+    this.unpackSensorValuesInto(data, offset, values)
+    return values
+  }
+
+  private parseBatchedSensorFrames = (data: Buffer): SensorFrame[] => {
+    let pos = this.sensorOffset
+    const frameCount = data.readUInt8(pos)
+    let sequence = data.readUInt16LE(pos + 1)
+    let timestamp = data.readUInt16LE(pos + 3)
+    pos += 5
+
+    const frames: SensorFrame[] = []
+
+    if (frameCount === 0) {
+      return frames
+    }
+
+    let sensorValues = this.unpackSensorValues(data, pos)
+    pos += Math.ceil(this.sensorCount / 4) * 5
+
+    frames.push({ sequence, timestampUs: timestamp / TELEMETRY_TICKS_PER_US, sensorValues })
+
+    for (let f = 1; f < frameCount; f++) {
+      timestamp = (timestamp + data.readUInt8(pos) * BATCHED_TIME_DELTA_TICKS) & 0xffff
+      sequence = (sequence + 1) & 0xffff
+      pos += 1
+
+      sensorValues = sensorValues.map((value, i) => value + data.readInt8(pos + i))
+      pos += this.sensorCount
+
+      frames.push({ sequence, timestampUs: timestamp / TELEMETRY_TICKS_PER_US, sensorValues })
+    }
+
+    return frames
+  }
+
+  // returns null if report is not a button events report. see
+  // ButtonEventsInputHIDReport in firmware for the layout.
+  parseButtonEvents = (
+    data: Buffer
+  ): { buttonEvents: ButtonEvent[]; droppedButtonEvents: number } | null => {
+    if (data[0] !== ReportID.BUTTON_EVENTS_INPUT) {
+      return null
+    }
+
+    let pos = this.sensorOffset + Math.ceil(this.sensorCount / 4) * 5
+    const timestamp = data.readUInt16LE(pos)
+    const droppedButtonEvents = data.readUInt8(pos + 2)
+    const eventCount = data.readUInt8(pos + 3)
+    pos += 4
+
+    const buttonEvents: ButtonEvent[] = []
+
+    for (let i = 0; i < eventCount; i++, pos += BUTTON_EVENT_SIZE) {
+      const age = (timestamp - data.readUInt16LE(pos)) & 0xffff
+      const button = data.readUInt8(pos + 2)
+
+      buttonEvents.push({
+        button: button & BUTTON_EVENT_INDEX_MASK,
+        pressed: (button & BUTTON_EVENT_PRESSED) !== 0,
+        ageUs: age / TELEMETRY_TICKS_PER_US
+      })
+    }
+
+    return { buttonEvents, droppedButtonEvents }
+  }
+
   parseInputReport(data: Buffer): InputReport {
-    const parsed = this.inputReportParser.parse(data)
+    switch (data[0]) {
+      case ReportID.BUTTONS_INPUT:
+        return {
+          buttons: this.formatButtons(this.readButtonBits(data)),
+          sensorValues: null
+        }
 
-    return {
-      buttons: this.formatButtons(parsed.buttonBits),
-      sensorValues: parsed.sensorValues
+      case ReportID.PACKED_SENSORS_INPUT:
+        return {
+          buttons: this.formatButtons(this.readButtonBits(data)),
+          sensorValues: this.unpackSensorValues(data, this.sensorOffset)
+        }
+
+      case ReportID.SCALED_SENSORS_INPUT:
+        return {
+          buttons: this.formatButtons(this.readButtonBits(data)),
+          sensorValues: Array.from(
+            data.subarray(this.sensorOffset, this.sensorOffset + this.sensorCount),
+            v => v << 2
+          )
+        }
+
+      case ReportID.PEAK_SENSORS_INPUT: {
+        const packedSize = Math.ceil(this.sensorCount / 4) * 5
+
+        return {
+          buttons: this.formatButtons(this.readButtonBits(data)),
+          sensorValues: this.unpackSensorValues(data, this.sensorOffset),
+          sensorMaxima: this.unpackSensorValues(data, this.sensorOffset + packedSize),
+          sensorMinima: this.unpackSensorValues(data, this.sensorOffset + 2 * packedSize)
+        }
+      }
+
+      case ReportID.BUTTON_EVENTS_INPUT:
+        return {
+          buttons: this.formatButtons(this.readButtonBits(data)),
+          sensorValues: this.unpackSensorValues(data, this.sensorOffset),
+          ...this.parseButtonEvents(data)
+        }
+
+      case ReportID.BATCHED_SENSORS_INPUT: {
+        const sensorFrames = this.parseBatchedSensorFrames(data)
+
+        return {
+          buttons: this.formatButtons(this.readButtonBits(data)),
+          sensorValues: sensorFrames.length
+            ? sensorFrames[sensorFrames.length - 1].sensorValues
+            : null,
+          sensorFrames
+        }
+      }
+
+      default: {
+        const parsed = this.inputReportParser.parse(data)
+
+        return {
+          buttons: this.formatButtons(this.readButtonBits(data)),
+          sensorValues: parsed.sensorValues
+        }
+      }
+    }
+  }
+
+  // same as parseInputReport, but reads straight to given arrays without
+  // allocating anything, as this is done for every report. buttons are 1 when
+  // pressed. returns false if report had no sensor values, in which case
+  // sensorValues is left as it was. for batched reports, only the latest
+  // frame is decoded, and for peak reports, only the highest values. buttons
+  // that were pressed at any point since previous button events report are
+  // decoded as pressed, so that taps shorter than report interval show up.
+  decodeInputReport(data: Buffer, buttons: Uint8Array, sensorValues: Uint16Array): boolean {
+    const buttonBits = this.readButtonBits(data)
+
+    for (let i = 0; i < this.buttonCount; i++) {
+      buttons[i] = (buttonBits >> i) & 1
+    }
+
+    switch (data[0]) {
+      case ReportID.BUTTONS_INPUT:
+        return false
+
+      case ReportID.PACKED_SENSORS_INPUT:
+        this.unpackSensorValuesInto(data, this.sensorOffset, sensorValues)
+        return true
+
+      case ReportID.SCALED_SENSORS_INPUT:
+        for (let i = 0; i < this.sensorCount; i++) {
+          sensorValues[i] = data[this.sensorOffset + i] << 2
+        }
+        return true
+
+      case ReportID.PEAK_SENSORS_INPUT:
+        this.unpackSensorValuesInto(
+          data,
+          this.sensorOffset + Math.ceil(this.sensorCount / 4) * 5,
+          sensorValues
+        )
+        return true
+
+      case ReportID.BUTTON_EVENTS_INPUT: {
+        this.unpackSensorValuesInto(data, this.sensorOffset, sensorValues)
+
+        // see parseButtonEvents for the layout
+        let pos = this.sensorOffset + Math.ceil(this.sensorCount / 4) * 5 + 3
+        const eventCount = data[pos]
+        pos += 1
+
+        for (let i = 0; i < eventCount; i++, pos += BUTTON_EVENT_SIZE) {
+          const button = data[pos + 2]
+
+          if (button & BUTTON_EVENT_PRESSED) {
+            buttons[button & BUTTON_EVENT_INDEX_MASK] = 1
+          }
+        }
+
+        return true
+      }
+
+      case ReportID.BATCHED_SENSORS_INPUT: {
+        // see parseBatchedSensorFrames for the layout
+        let pos = this.sensorOffset
+        const frameCount = data[pos]
+        pos += 5
+
+        if (frameCount === 0) {
+          return false
+        }
+
+        this.unpackSensorValuesInto(data, pos, sensorValues)
+        pos += Math.ceil(this.sensorCount / 4) * 5
+
+        for (let f = 1; f < frameCount; f++) {
+          pos += 1 // time delta
+
+          for (let i = 0; i < this.sensorCount; i++) {
+            sensorValues[i] += data.readInt8(pos + i)
+          }
+
+          pos += this.sensorCount
+        }
+
+        return true
+      }
+
+      default:
+        for (let i = 0; i < this.sensorCount; i++) {
+          sensorValues[i] = data.readUInt16LE(this.sensorOffset + 2 * i)
+        }
+        return true
     }
   }
 
   parseConfigurationReport(data: Buffer): ConfigurationReport {
+    if (this.legacyConfiguration) {
+      return this.parseLegacyConfigurationReport(data)
+    }
+
     const parsed = this.configurationReportParser.parse(data)
 
     return {
-      releaseThreshold: parsed.releaseThreshold,
+      profileIndex: parsed.profileIndex,
       sensorThresholds: parsed.sensorThresholds,
-      sensorToButtonMapping: parsed.sensorToButtonMapping
+      sensorReleaseThresholds: parsed.sensorReleaseThresholds.map(
+        (value: number) => value / SENSOR_RELEASE_THRESHOLD_SCALE
+      ),
+      sensorToButtonMapping: parsed.sensorToButtonMapping,
+      sensorFilters: parsed.sensorFilters.map(this.parseSensorFilter),
+      linearizedThresholds: (parsed.flags & PAD_CONFIGURATION_LINEARIZED_THRESHOLDS) !== 0
+    }
+  }
+
+  private parseLegacyConfigurationReport(data: Buffer): ConfigurationReport {
+    const parsed = this.legacyConfigurationReportParser.parse(data)
+
+    return {
+      profileIndex: 0,
+      sensorThresholds: parsed.sensorThresholds,
+      sensorReleaseThresholds: new Array(this.sensorCount).fill(parsed.releaseThreshold),
+      sensorToButtonMapping: parsed.sensorToButtonMapping,
+      sensorFilters: new Array(this.sensorCount).fill(LEGACY_SENSOR_FILTER),
+      linearizedThresholds: false
+    }
+  }
+
+  parseReportingConfigurationReport(data: Buffer): ReportingConfigurationReport {
+    const parsed = this.reportingConfigurationReportParser.parse(data)
+
+    return {
+      inputReportMode: parsed.inputReportMode,
+      changeDriven: parsed.changeDriven !== 0,
+      sensorChangeDelta: parsed.sensorChangeDelta,
+      idleKeepaliveMs: parsed.idleKeepaliveMs,
+      linearizedSensorValues: parsed.linearizedSensorValues !== 0,
+      reportIntervalMs: parsed.reportIntervalMs,
+      peakSensorValues: parsed.peakSensorValues !== 0
+    }
+  }
+
+  parseProfilesReport(data: Buffer): ProfilesReport {
+    const parsed = this.profilesReportParser.parse(data)
+
+    return {
+      profileCount: parsed.profileCount,
+      activeProfile: parsed.activeProfile,
+      configurationProfile: parsed.configurationProfile
+    }
+  }
+
+  parseCalibrationReport(data: Buffer): CalibrationReport {
+    const parsed = this.calibrationReportParser.parse(data)
+
+    return {
+      trackDrift: parsed.trackDrift !== 0,
+      calibrating: parsed.calibrating !== 0,
+      baselines: parsed.baselines,
+      noise: parsed.noise
+    }
+  }
+
+  parseCharacterizationReport(data: Buffer): CharacterizationReport {
+    const noise: number[] = []
+
+    for (let i = 0; i < this.sensorCount; i++) {
+      noise.push(data.readUInt16LE(9 + 2 * i) / CHARACTERIZATION_NOISE_SCALE)
+    }
+
+    return {
+      settings: readAdcSpeedSettings(data, 1),
+      measuring: data.readUInt8(4) !== 0,
+      conversionsPerSecond: data.readUInt32LE(5),
+      noise
     }
   }
 
@@ -105,16 +811,75 @@ export class ReportManager {
     }
   }
 
+  private formatTelemetryHistogram = (
+    histogram: { buckets: number[]; max: number },
+    shift: number
+  ): DeviceTelemetryHistogram => {
+    const bucketUpperBoundsUs: number[] = []
+
+    // every bucket is twice as wide as the previous one, see Telemetry.h
+    for (let i = 0; i < TELEMETRY_BUCKET_COUNT - 1; i++) {
+      bucketUpperBoundsUs.push(Math.pow(2, shift + i) / TELEMETRY_TICKS_PER_US)
+    }
+
+    return {
+      bucketUpperBoundsUs,
+      counts: histogram.buckets,
+      maxUs: histogram.max / TELEMETRY_TICKS_PER_US
+    }
+  }
+
+  parseTelemetryReport(data: Buffer): DeviceTelemetry {
+    const parsed = this.telemetryReportParser.parse(data)
+
+    return {
+      scanDuration: this.formatTelemetryHistogram(
+        parsed.scanDuration,
+        TELEMETRY_SCAN_DURATION_SHIFT
+      ),
+      pressLatency: this.formatTelemetryHistogram(
+        parsed.pressLatency,
+        TELEMETRY_PRESS_LATENCY_SHIFT
+      ),
+      callbackJitter: this.formatTelemetryHistogram(
+        parsed.callbackJitter,
+        TELEMETRY_CALLBACK_JITTER_SHIFT
+      ),
+      sampleAge: this.formatTelemetryHistogram(parsed.sampleAge, TELEMETRY_SAMPLE_AGE_SHIFT)
+    }
+  }
+
+  getTelemetryReportSize(): number {
+    // 1 for report id
+    // 4 histograms, each having uint16 for every bucket and uint16 for max value
+    return 1 + 4 * (TELEMETRY_BUCKET_COUNT + 1) * 2
+  }
+
   getConfigurationReportSize = () => {
+    if (this.legacyConfiguration) {
+      // 1 for report id
+      // 2 for every sensor threshold (uint16)
+      // 4 for release multiplier (float)
+      // 1 for every sensor to button mapping (int8)
+      return 1 + 2 * this.sensorCount + 4 + this.sensorCount
+    }
+
     // size is as follows:
     // - 1 byte for report id
+    // - 1 byte for profile index
     // - 2 bytes for every sensor threshold (they're uint16)
-    // - 4 bytes for request threshold (float)
-    // - 1 byte for sensor to button mapping (int8)
-    return 2 * this.sensorCount + 4 + this.sensorCount + 1
+    // - 1 byte for every sensor release threshold (uint8)
+    // - 1 byte for every sensor to button mapping (int8)
+    // - 1 byte for every sensor filter (uint8)
+    // - 1 byte for flags
+    return 2 * this.sensorCount + this.sensorCount + this.sensorCount + this.sensorCount + 1 + 1 + 1
   }
 
   createConfigurationReport(conf: ConfigurationReport): number[] {
+    if (this.legacyConfiguration) {
+      return this.createLegacyConfigurationReport(conf)
+    }
+
     const buffer = Buffer.alloc(this.getConfigurationReportSize())
     let pos = 0
 
@@ -122,15 +887,22 @@ export class ReportManager {
     buffer.writeUInt8(ReportID.PAD_CONFIGURATION, pos)
     pos += 1
 
+    // profile index
+    buffer.writeUInt8(conf.profileIndex, pos)
+    pos += 1
+
     // sensor thresholds
     for (let i = 0; i < this.sensorCount; i++) {
       buffer.writeUInt16LE(conf.sensorThresholds[i], pos)
       pos += 2
     }
 
-    // release threshold
-    buffer.writeFloatLE(conf.releaseThreshold, pos)
-    pos += 4
+    // sensor release thresholds
+    for (let i = 0; i < this.sensorCount; i++) {
+      const value = Math.round(conf.sensorReleaseThresholds[i] * SENSOR_RELEASE_THRESHOLD_SCALE)
+      buffer.writeUInt8(clamp(value, 0, SENSOR_RELEASE_THRESHOLD_MAX), pos)
+      pos += 1
+    }
 
     // sensor to button mapping
     for (let i = 0; i < this.sensorCount; i++) {
@@ -138,9 +910,140 @@ export class ReportManager {
       pos += 1
     }
 
+    // sensor filters
+    for (let i = 0; i < this.sensorCount; i++) {
+      buffer.writeUInt8(this.createSensorFilter(conf.sensorFilters[i]), pos)
+      pos += 1
+    }
+
+    // flags
+    buffer.writeUInt8(conf.linearizedThresholds ? PAD_CONFIGURATION_LINEARIZED_THRESHOLDS : 0, pos)
+
+    return [...buffer]
+  }
+
+  // legacy firmware has one release multiplier, so sensors get the average
+  // of their release thresholds. thresholds have to be raw ones.
+  private createLegacyConfigurationReport(conf: ConfigurationReport): number[] {
+    const buffer = Buffer.alloc(this.getConfigurationReportSize())
+    let pos = 0
+
+    buffer.writeUInt8(ReportID.PAD_CONFIGURATION, pos)
+    pos += 1
+
+    for (let i = 0; i < this.sensorCount; i++) {
+      buffer.writeUInt16LE(conf.sensorThresholds[i], pos)
+      pos += 2
+    }
+
+    const releaseThresholdSum = conf.sensorReleaseThresholds.reduce((a, b) => a + b, 0)
+    buffer.writeFloatLE(releaseThresholdSum / this.sensorCount, pos)
+    pos += 4
+
+    for (let i = 0; i < this.sensorCount; i++) {
+      buffer.writeInt8(conf.sensorToButtonMapping[i], pos)
+      pos += 1
+    }
+
     return [...buffer]
   }
 
+  getReportingConfigurationReportSize(): number {
+    // 1 for report id
+    // 1 for input report mode (uint8)
+    // 1 for change driven flag (bool)
+    // 1 for sensor change delta (uint8)
+    // 2 for idle keepalive (uint16)
+    // 1 for linearized sensor values flag (bool)
+    // 1 for report interval (uint8)
+    // 1 for peak sensor values flag (bool)
+    return 1 + 1 + 1 + 1 + 2 + 1 + 1 + 1
+  }
+
+  createReportingConfigurationReport(conf: ReportingConfigurationReport): number[] {
+    const buffer = Buffer.alloc(this.getReportingConfigurationReportSize())
+    let pos = 0
+
+    buffer.writeUInt8(ReportID.REPORTING_CONFIGURATION, pos)
+    pos += 1
+
+    buffer.writeUInt8(conf.inputReportMode, pos)
+    pos += 1
+
+    buffer.writeUInt8(conf.changeDriven ? 1 : 0, pos)
+    pos += 1
+
+    buffer.writeUInt8(conf.sensorChangeDelta, pos)
+    pos += 1
+
+    buffer.writeUInt16LE(conf.idleKeepaliveMs, pos)
+    pos += 2
+
+    buffer.writeUInt8(conf.linearizedSensorValues ? 1 : 0, pos)
+    pos += 1
+
+    buffer.writeUInt8(conf.reportIntervalMs, pos)
+    pos += 1
+
+    buffer.writeUInt8(conf.peakSensorValues ? 1 : 0, pos)
+
+    return [...buffer]
+  }
+
+  getProfilesReportSize(): number {
+    // 1 for report id
+    // 1 for profile count, 1 for active profile, 1 for configuration profile
+    return 1 + 1 + 1 + 1
+  }
+
+  // only configuration profile can be written, others are read only
+  createProfilesReport(configurationProfile: number): number[] {
+    return [ReportID.PROFILES, 0x00, 0x00, configurationProfile]
+  }
+
+  createSelectProfileReport(profileIndex: number): number[] {
+    return [ReportID.SELECT_PROFILE, profileIndex]
+  }
+
+  createCalibrateReport(sensorBuffers: number[]): number[] {
+    // 1 for report id, 2 for every sensor buffer (uint16)
+    const buffer = Buffer.alloc(1 + 2 * this.sensorCount)
+
+    buffer.writeUInt8(ReportID.CALIBRATE, 0)
+
+    for (let i = 0; i < this.sensorCount; i++) {
+      buffer.writeUInt16LE(sensorBuffers[i], 1 + 2 * i)
+    }
+
+    return [...buffer]
+  }
+
+  getCalibrationReportSize(): number {
+    // 1 for report id
+    // 1 for drift tracking flag, 1 for calibrating flag (bool)
+    // 2 for every baseline (uint16)
+    // 1 for every noise value (uint8)
+    return 1 + 1 + 1 + 2 * this.sensorCount + this.sensorCount
+  }
+
+  // only drift tracking can be written, rest are read only
+  createCalibrationReport(trackDrift: boolean): number[] {
+    const buffer = Buffer.alloc(this.getCalibrationReportSize())
+
+    buffer.writeUInt8(ReportID.CALIBRATION, 0)
+    buffer.writeUInt8(trackDrift ? 1 : 0, 1)
+
+    return [...buffer]
+  }
+
+  getCharacterizationReportSize(): number {
+    // 1 for report id
+    // 3 for settings, 1 for measuring flag (bool)
+    // 4 for conversions per second (uint32)
+    // 2 for every noise value (uint16)
+    return 1 + ADC_SPEED_SETTINGS_SIZE + 1 + 4 + 2 * this.sensorCount
+  }
+
   createSaveConfigurationReport(): number[] {
     return [ReportID.SAVE_CONFIGURATION, 0x00]
   }
@@ -0,0 +1,180 @@
+import * as HID from 'node-hid'
+import { isTeensy2Interface } from '../Teensy2DeviceDriver'
+import {
+  ReportID,
+  ReportManager,
+  AdcSpeedSettings,
+  CharacterizationReport,
+  ADC_SPEED_REPORT_SIZE,
+  PROPERTIES_REPORT_SIZE,
+  createAdcSpeedReport,
+  createCharacterizeReport,
+  parseAdcSpeedReport,
+  parsePropertiesReport
+} from '../Teensy2Reports'
+import delay from '../../../util/delay'
+
+// Measures conversion rate and noise of the first device with every ADC
+// speed setting, one at a time, and prints them as a table. Pad should be
+// left alone meanwhile, anything that moves a sensor counts as noise.
+// Fastest setting that is quiet enough is recommended. Run with
+// "npm run sweep-teensy -- [options]":
+//   --max-noise 1   highest standard deviation of a sensor to accept, in raw units
+//   --apply         take the recommended setting in use and save it to the device
+
+const POLL_INTERVAL_MS = 10
+const TIMEOUT_MS = 2000
+const CPU_HZ = 16000000
+
+const option = (name: string, defaultValue: string): string => {
+  const index = process.argv.indexOf(`--${name}`)
+  return index >= 0 && index + 1 < process.argv.length ? process.argv[index + 1] : defaultValue
+}
+
+const allSettings = (): AdcSpeedSettings[] => {
+  const settings: AdcSpeedSettings[] = []
+
+  for (let prescaler = 1; prescaler <= 7; prescaler++) {
+    for (const highSpeed of [true, false]) {
+      for (const eightBit of [false, true]) {
+        settings.push({ prescaler, highSpeed, eightBit })
+      }
+    }
+  }
+
+  return settings
+}
+
+const sameSettings = (a: AdcSpeedSettings, b: AdcSpeedSettings) =>
+  a.prescaler === b.prescaler && a.highSpeed === b.highSpeed && a.eightBit === b.eightBit
+
+const characterize = async (
+  hidDevice: HID.HID,
+  reportManager: ReportManager,
+  settings: AdcSpeedSettings
+): Promise<CharacterizationReport> => {
+  hidDevice.write(createCharacterizeReport(settings))
+  const start = Date.now()
+
+  for (;;) {
+    const data = hidDevice.getFeatureReport(
+      ReportID.CHARACTERIZATION,
+      reportManager.getCharacterizationReportSize()
+    )
+    const report = reportManager.parseCharacterizationReport(Buffer.from(data))
+
+    if (!report.measuring && sameSettings(report.settings, settings)) {
+      return report
+    }
+
+    if (Date.now() - start > TIMEOUT_MS) {
+      throw new Error('Device did not finish measuring')
+    }
+
+    await delay(POLL_INTERVAL_MS)
+  }
+}
+
+interface SweepResult {
+  settings: AdcSpeedSettings
+  conversionsPerSecond: number
+  // standard deviations of the noisiest sensor and of all of them on average
+  worstNoise: number
+  averageNoise: number
+}
+
+const adcKhz = (settings: AdcSpeedSettings) =>
+  (CPU_HZ / (1 << settings.prescaler) / 1000).toFixed(0)
+
+const describe = (settings: AdcSpeedSettings) =>
+  [
+    `prescaler ${settings.prescaler}`,
+    `(${adcKhz(settings)} kHz)`,
+    settings.highSpeed ? 'high speed' : '',
+    settings.eightBit ? '8-bit' : '10-bit'
+  ]
+    .filter(part => part)
+    .join(' ')
+
+const printResults = (results: SweepResult[]) => {
+  console.log(
+    ['prescaler', 'adc khz', 'high speed', '8-bit', 'conversions/s', 'worst sd', 'avg sd'].join(',')
+  )
+
+  for (const { settings, conversionsPerSecond, worstNoise, averageNoise } of results) {
+    console.log(
+      [
+        settings.prescaler,
+        adcKhz(settings),
+        settings.highSpeed ? 1 : 0,
+        settings.eightBit ? 1 : 0,
+        conversionsPerSecond,
+        worstNoise.toFixed(2),
+        averageNoise.toFixed(2)
+      ].join(',')
+    )
+  }
+}
+
+const main = async () => {
+  const maxNoise = Number(option('max-noise', '1'))
+  const device = HID.devices().find(device => isTeensy2Interface(device) && device.path)
+
+  if (!device || !device.path) {
+    console.error('No device found')
+    process.exitCode = 1
+    return
+  }
+
+  const hidDevice = new HID.HID(device.path)
+
+  try {
+    const properties = parsePropertiesReport(
+      Buffer.from(hidDevice.getFeatureReport(ReportID.PROPERTIES, PROPERTIES_REPORT_SIZE))
+    )
+    const reportManager = new ReportManager(properties)
+    const current = parseAdcSpeedReport(
+      Buffer.from(hidDevice.getFeatureReport(ReportID.ADC_SPEED, ADC_SPEED_REPORT_SIZE))
+    )
+    const results: SweepResult[] = []
+
+    for (const settings of allSettings()) {
+      const report = await characterize(hidDevice, reportManager, settings)
+      const deviations = report.noise.map(variance => Math.sqrt(variance))
+
+      results.push({
+        settings,
+        conversionsPerSecond: report.conversionsPerSecond,
+        worstNoise: Math.max(...deviations),
+        averageNoise: deviations.reduce((sum, value) => sum + value, 0) / deviations.length
+      })
+    }
+
+    printResults(results)
+    console.log(`\nin use: ${describe(current)}`)
+
+    const best = results
+      .filter(result => result.worstNoise <= maxNoise)
+      .sort((a, b) => b.conversionsPerSecond - a.conversionsPerSecond)[0]
+
+    if (!best) {
+      console.log(`no setting keeps noise under ${maxNoise}`)
+      return
+    }
+
+    console.log(`recommended: ${describe(best.settings)}`)
+
+    if (process.argv.includes('--apply')) {
+      hidDevice.sendFeatureReport(createAdcSpeedReport(best.settings))
+      hidDevice.write(reportManager.createSaveConfigurationReport())
+      console.log('applied and saved')
+    }
+  } catch (e) {
+    console.error(e.message)
+    process.exitCode = 1
+  } finally {
+    hidDevice.close()
+  }
+}
+
+main()
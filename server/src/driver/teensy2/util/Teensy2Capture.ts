@@ -0,0 +1,125 @@
+import * as HID from 'node-hid'
+import { isTeensy2Interface } from '../Teensy2DeviceDriver'
+import {
+  ReportID,
+  CaptureSettings,
+  CaptureState,
+  CaptureSamplesReport,
+  CAPTURE_SAMPLES_REPORT_SIZE,
+  createCaptureReport,
+  createCaptureSamplesReport,
+  parseCaptureSamplesReport
+} from '../Teensy2Reports'
+import delay from '../../../util/delay'
+
+// Captures a few sensors of the first device at full ADC speed, and prints
+// the samples as CSV, time relative to the trigger. Samples are 8-bit, ie.
+// raw sensor values divided by 4. Pad doesn't react to anything while
+// capturing. Run with "npm run capture-teensy -- [options]":
+//   --sensors 0,1     sensors to capture, first one triggers
+//   --samples 200     samples per sensor
+//   --trigger 100     start when first sensor rises past this (8-bit)
+//   --falling         ...or falls below it instead
+//   --pre-trigger 20  samples to keep from before the trigger
+//   --timeout 10000   how long to wait for the trigger, in ms
+
+const POLL_INTERVAL_MS = 10
+
+const option = (name: string, defaultValue: string | null): string | null => {
+  const index = process.argv.indexOf(`--${name}`)
+  return index >= 0 && index + 1 < process.argv.length ? process.argv[index + 1] : defaultValue
+}
+
+const readCaptureSamples = (hidDevice: HID.HID, offset: number): CaptureSamplesReport => {
+  hidDevice.sendFeatureReport(createCaptureSamplesReport(offset))
+  const data = hidDevice.getFeatureReport(ReportID.CAPTURE_SAMPLES, CAPTURE_SAMPLES_REPORT_SIZE)
+  return parseCaptureSamplesReport(Buffer.from(data))
+}
+
+const capture = async (hidDevice: HID.HID, settings: CaptureSettings, timeoutMs: number) => {
+  hidDevice.write(createCaptureReport(settings))
+
+  const start = Date.now()
+  let status = readCaptureSamples(hidDevice, 0)
+
+  while (status.state !== CaptureState.DONE) {
+    if (status.state === CaptureState.IDLE) {
+      throw new Error('Device did not accept capture settings')
+    }
+
+    if (Date.now() - start > timeoutMs) {
+      throw new Error('Capture was not triggered in time')
+    }
+
+    await delay(POLL_INTERVAL_MS)
+    status = readCaptureSamples(hidDevice, 0)
+  }
+
+  const sampleCount = status.sampleCount * status.sensorCount
+  const samples = Buffer.alloc(sampleCount)
+  let offset = 0
+
+  while (offset < sampleCount) {
+    const page = readCaptureSamples(hidDevice, offset)
+    const length = Math.min(page.samples.length, sampleCount - offset)
+    page.samples.copy(samples, offset, 0, length)
+    offset += length
+  }
+
+  return { status, samples }
+}
+
+const printCapture = (status: CaptureSamplesReport, samples: Buffer, sensors: number[]) => {
+  // duration is from the trigger to the last sample
+  const intervals = status.sampleCount - status.triggerPosition - 1
+  const intervalUs = intervals > 0 ? status.durationUs / intervals : 0
+
+  console.log(['us', ...sensors.map(sensor => `s${sensor}`)].join(','))
+
+  for (let i = 0; i < status.sampleCount; i++) {
+    const row = samples.subarray(i * status.sensorCount, (i + 1) * status.sensorCount)
+    const timeUs = (i - status.triggerPosition) * intervalUs
+    console.log([timeUs.toFixed(1), ...row].join(','))
+  }
+}
+
+const main = async () => {
+  const sensors = (option('sensors', '0') as string).split(',').map(Number)
+  const triggerLevel = option('trigger', null)
+
+  const settings: CaptureSettings = {
+    sensors,
+    sampleCount: Number(option('samples', '200')),
+    preTriggerCount: Number(option('pre-trigger', '0')),
+    triggerLevel: triggerLevel === null ? null : Number(triggerLevel),
+    triggerFalling: process.argv.includes('--falling')
+  }
+
+  const device = HID.devices().find(device => isTeensy2Interface(device) && device.path)
+
+  if (!device || !device.path) {
+    console.error('No device found')
+    process.exitCode = 1
+    return
+  }
+
+  const hidDevice = new HID.HID(device.path)
+
+  try {
+    const { status, samples } = await capture(
+      hidDevice,
+      settings,
+      Number(option('timeout', '10000'))
+    )
+    printCapture(status, samples, sensors.slice(0, status.sensorCount))
+  } catch (e) {
+    console.error(e.message)
+    process.exitCode = 1
+  } finally {
+    // pad only works again once capture is stopped
+    hidDevice.write(createCaptureReport(null))
+    hidDevice.close()
+  }
+}
+
+main()
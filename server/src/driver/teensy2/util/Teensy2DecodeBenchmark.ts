@@ -0,0 +1,133 @@
+import { ReportManager, ReportID } from '../Teensy2Reports'
+import {
+  linearizeSensorValues,
+  normalizeSensorValues,
+  normalizeLinearizedValues,
+  normalizeSensorValuesInto
+} from '../Teensy2Linearization'
+
+// Compares decoding input reports the old way (binary-parser and mapping
+// arrays) to decoding them to preallocated typed arrays, which is what
+// Teensy2Device does. Run with "npm run bench-decoding", which exposes gc so
+// that allocations can be measured.
+
+const SENSOR_COUNT = 12
+const BUTTON_COUNT = 16
+const REPORTS_PER_ROUND = 200000
+const ALLOCATION_REPORTS = 1000
+
+const reportManager = new ReportManager({ buttonCount: BUTTON_COUNT, sensorCount: SENSOR_COUNT })
+
+const createFullReport = () => {
+  const buffer = Buffer.alloc(3 + 2 * SENSOR_COUNT)
+  buffer.writeUInt8(ReportID.SENSOR_VALUES, 0)
+  buffer.writeUInt16LE(0x0005, 1)
+
+  for (let i = 0; i < SENSOR_COUNT; i++) {
+    buffer.writeUInt16LE(100 + i * 50, 3 + 2 * i)
+  }
+
+  return buffer
+}
+
+const createPackedReport = () => {
+  const buffer = Buffer.alloc(3 + Math.ceil(SENSOR_COUNT / 4) * 5)
+  buffer.writeUInt8(ReportID.PACKED_SENSORS_INPUT, 0)
+  buffer.writeUInt16LE(0x0005, 1)
+
+  for (let i = 0; i < SENSOR_COUNT; i++) {
+    const value = 100 + i * 50
+    const bit = (i % 4) * 10
+    const pos = 3 + Math.floor(i / 4) * 5 + (bit >> 3)
+    const shifted = value << (bit & 7)
+    buffer[pos] |= shifted & 0xff
+    buffer[pos + 1] |= shifted >> 8
+  }
+
+  return buffer
+}
+
+const decodeOld = (data: Buffer, linearized: boolean) => {
+  const inputReport = reportManager.parseInputReport(data)
+  const sensorValues = inputReport.sensorValues || []
+
+  return {
+    buttons: inputReport.buttons,
+    sensors: linearized
+      ? normalizeLinearizedValues(sensorValues)
+      : normalizeSensorValues(linearizeSensorValues(sensorValues))
+  }
+}
+
+const sensorValues = new Uint16Array(SENSOR_COUNT)
+const inputState = {
+  sensors: new Float32Array(SENSOR_COUNT),
+  buttons: new Uint8Array(BUTTON_COUNT)
+}
+
+const decodeNew = (data: Buffer, linearized: boolean) => {
+  if (reportManager.decodeInputReport(data, inputState.buttons, sensorValues)) {
+    normalizeSensorValuesInto(sensorValues, linearized, inputState.sensors)
+  }
+
+  return inputState
+}
+
+type Decoder = (data: Buffer, linearized: boolean) => unknown
+
+const measureRate = (decode: Decoder, data: Buffer, linearized: boolean) => {
+  const start = process.hrtime.bigint()
+
+  for (let i = 0; i < REPORTS_PER_ROUND; i++) {
+    decode(data, linearized)
+  }
+
+  const elapsedNs = Number(process.hrtime.bigint() - start)
+  return (REPORTS_PER_ROUND * 1e9) / elapsedNs
+}
+
+// heap growth over a batch small enough to not trigger a collection. null if
+// gc is not exposed.
+const measureAllocations = (decode: Decoder, data: Buffer, linearized: boolean) => {
+  const gc: (() => void) | undefined = (global as any).gc
+
+  if (!gc) {
+    return null
+  }
+
+  gc()
+  const before = process.memoryUsage().heapUsed
+
+  for (let i = 0; i < ALLOCATION_REPORTS; i++) {
+    decode(data, linearized)
+  }
+
+  const after = process.memoryUsage().heapUsed
+  return Math.max(after - before, 0) / ALLOCATION_REPORTS
+}
+
+const cases = [
+  { name: 'full, raw', data: createFullReport(), linearized: false },
+  { name: 'packed, raw', data: createPackedReport(), linearized: false },
+  { name: 'packed, linearized', data: createPackedReport(), linearized: true }
+]
+
+const decoders = [{ name: 'old', decode: decodeOld }, { name: 'new', decode: decodeNew }]
+
+for (const { name, data, linearized } of cases) {
+  for (const decoder of decoders) {
+    // warm up so that both paths are optimized before measuring
+    measureRate(decoder.decode, data, linearized)
+
+    const rate = measureRate(decoder.decode, data, linearized)
+    const bytes = measureAllocations(decoder.decode, data, linearized)
+
+    const rateText = `${Math.round(rate)} reports/s`
+    const allocationText =
+      bytes === null ? 'run with --expose-gc for allocations' : `${bytes.toFixed(0)} bytes/report`
+
+    console.log(
+      `${name.padEnd(20)} ${decoder.name.padEnd(4)} ${rateText.padStart(20)}  ${allocationText}`
+    )
+  }
+}
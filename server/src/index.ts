@@ -4,10 +4,18 @@ import { Server as HttpServer } from 'http'
 import SocketIO from 'socket.io'
 
 import { Teensy2DeviceDriver } from './driver/teensy2/Teensy2DeviceDriver'
+import { ReplayDeviceDriver } from './driver/replay/ReplayDeviceDriver'
+import { DeviceDriver } from './driver/Driver'
 import createServer from './server'
+import { SensorBits } from './util/InputFrameEncoder'
 import consola from 'consola'
 
-function start(port: number, host: string) {
+function start(
+  port: number,
+  host: string,
+  inputEventSensorBits: SensorBits,
+  deviceDrivers: DeviceDriver[]
+) {
   const expressApplication = express()
   const httpServer = new HttpServer(expressApplication)
   const socketIOServer = SocketIO(httpServer, {
@@ -22,7 +30,8 @@ function start(port: number, host: string) {
   const closeServer = createServer({
     expressApplication,
     socketIOServer,
-    deviceDrivers: [new Teensy2DeviceDriver()]
+    deviceDrivers,
+    inputEventSensorBits
   })
 
   httpServer.listen(port, host, () =>
@@ -42,4 +51,19 @@ function start(port: number, host: string) {
 
 const port = (process.env.PORT && parseInt(process.env.PORT, 10)) || 3333
 const host = process.env.HOST || '0.0.0.0'
-start(port, host)
+// 8 bits halves the size of input events, which helps on crowded networks
+const inputEventSensorBits = process.env.INPUT_EVENT_SENSOR_BITS === '8' ? 8 : 16
+
+// replaying a recording replaces real devices, see ReplayDeviceDriver
+const deviceDrivers: DeviceDriver[] = process.env.REPLAY_FILE
+  ? [
+      new ReplayDeviceDriver({
+        recordingPath: process.env.REPLAY_FILE,
+        speed: process.env.REPLAY_SPEED ? parseFloat(process.env.REPLAY_SPEED) : 1,
+        deviceCount: (process.env.REPLAY_DEVICES && parseInt(process.env.REPLAY_DEVICES, 10)) || 1,
+        loop: process.env.REPLAY_LOOP !== '0'
+      })
+    ]
+  : [new Teensy2DeviceDriver(process.env.RECORD_DIRECTORY)]
+
+start(port, host, inputEventSensorBits, deviceDrivers)
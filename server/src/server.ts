@@ -1,19 +1,21 @@
 import consola from 'consola'
 
 import { ServerEvents, ClientEvents } from '../../common-types/events'
-import { Device } from './driver/Device'
+import { Device, DeviceInputState } from './driver/Device'
 import { DeviceDriver } from './driver/Driver'
-import { DeviceInputData } from '../../common-types/device'
-import { clamp, mapValues } from 'lodash'
+import { DeviceInputData, DeviceTelemetry } from '../../common-types/device'
+import InputFrameEncoder, { SensorBits } from './util/InputFrameEncoder'
+import { mapValues } from 'lodash'
 
 const SECOND_AS_NS = BigInt(1e9)
 const INPUT_EVENT_SEND_NS = SECOND_AS_NS / BigInt(20) // 20hz
-const INPUT_EVENTS_REQUIRED_FOR_CALIBRATION = 250
 
 interface Params {
   expressApplication: Express.Application
   socketIOServer: SocketIO.Server
   deviceDrivers: DeviceDriver[]
+  // precision of sensor values in input events
+  inputEventSensorBits: SensorBits
 }
 
 type DeviceData = {
@@ -22,6 +24,7 @@ type DeviceData = {
   inputEventTracker: {
     lastSent: bigint
     accumulatedInputData: DeviceInputData | null
+    encoder: InputFrameEncoder
   }
   calibration: CalibrationStatus
 }
@@ -29,8 +32,6 @@ type DeviceData = {
 // null = not calibrating
 type CalibrationStatus = {
   calibrationBuffer: number
-  inputEventsCalculated: number
-  currentSensorValueAverage: number[] | null // null = no data yet
 } | null
 
 const createServer = (params: Params) => {
@@ -63,7 +64,8 @@ const createServer = (params: Params) => {
       device: device,
       inputEventTracker: {
         lastSent: BigInt(0),
-        accumulatedInputData: null
+        accumulatedInputData: null,
+        encoder: new InputFrameEncoder(device.properties.sensorCount, params.inputEventSensorBits)
       },
       calibration: null
     }
@@ -71,6 +73,7 @@ const createServer = (params: Params) => {
     device.on('disconnect', () => handleDisconnectDevice(device.id))
     device.on('inputData', data => handleInputData(device.id, data))
     device.on('eventRate', number => handleEventRate(device.id, number))
+    device.on('telemetry', telemetry => handleTelemetry(device.id, telemetry))
 
     broadcastDevicesUpdated()
 
@@ -86,58 +89,19 @@ const createServer = (params: Params) => {
     consola.info(`Disconnected from device id "${deviceId}"`)
   }
 
-  const doCalibrationTick = async (deviceData: DeviceData, inputData: DeviceInputData) => {
-    const { device, calibration } = deviceData
-
-    // Calibration not active, do nothing.
-    if (calibration === null) {
-      return
-    }
-
-    if (calibration.currentSensorValueAverage === null) {
-      calibration.currentSensorValueAverage = [...inputData.sensors]
-    } else {
-      // Update cumulative moving average. If not familiar:
-      // https://en.wikipedia.org/wiki/Moving_average#Cumulative_moving_average
-      for (let sensorIndex = 0; sensorIndex < device.properties.sensorCount; sensorIndex++) {
-        const oldAverage = calibration.currentSensorValueAverage[sensorIndex]
-        const newValue = inputData.sensors[sensorIndex]
-        const newAverage =
-          oldAverage + (newValue - oldAverage) / (calibration.inputEventsCalculated + 1)
-        calibration.currentSensorValueAverage[sensorIndex] = newAverage
-      }
-    }
-
-    calibration.inputEventsCalculated++
-
-    // Have we enough data to update?
-    if (calibration.inputEventsCalculated > INPUT_EVENTS_REQUIRED_FOR_CALIBRATION) {
-      const sensorThresholds = calibration.currentSensorValueAverage.map(value =>
-        clamp(value + calibration.calibrationBuffer, 0, 1)
-      )
-
-      // Remove calibration and update new values.
-      deviceData.calibration = null
-      await device.updateConfiguration({ sensorThresholds })
-      await device.saveConfiguration()
-      broadcastDevicesUpdated()
-    }
-  }
-
-  const doSendInputEventToClient = (data: DeviceData, inputData: DeviceInputData) => {
+  const doSendInputEventToClient = (data: DeviceData, inputData: DeviceInputState) => {
     const inputEventTracker = data.inputEventTracker
     const now = process.hrtime.bigint()
 
     if (inputEventTracker.accumulatedInputData === null) {
-      // first time receiving sensor values since sending an input event?
+      // first time receiving sensor values since sending an input event? device
+      // reuses its arrays, so copy them.
       inputEventTracker.accumulatedInputData = {
-        sensors: [...inputData.sensors],
-        buttons: [...inputData.buttons]
+        sensors: Array.from(inputData.sensors),
+        buttons: Array.from(inputData.buttons, pressed => pressed !== 0)
       }
     } else {
       // merge input data to accumulated input data so far.
-      const inputData = inputEventTracker.accumulatedInputData
-
       // during accumulation, get the maximum sensor values of all input events received.
       for (let sensorIndex = 0; sensorIndex < data.device.properties.sensorCount; sensorIndex++) {
         inputEventTracker.accumulatedInputData.sensors[sensorIndex] = Math.max(
@@ -150,7 +114,7 @@ const createServer = (params: Params) => {
       // events.
       for (let buttonIndex = 0; buttonIndex < data.device.properties.buttonCount; buttonIndex++) {
         inputEventTracker.accumulatedInputData.buttons[buttonIndex] =
-          inputData.buttons[buttonIndex] ||
+          inputData.buttons[buttonIndex] !== 0 ||
           inputEventTracker.accumulatedInputData.buttons[buttonIndex]
       }
     }
@@ -162,7 +126,7 @@ const createServer = (params: Params) => {
 
     const event: ServerEvents.InputEvent = {
       deviceId: data.id,
-      inputData: inputEventTracker.accumulatedInputData
+      frame: inputEventTracker.encoder.encode(inputEventTracker.accumulatedInputData)
     }
 
     params.socketIOServer.volatile.to(data.id).emit('inputEvent', event)
@@ -171,10 +135,9 @@ const createServer = (params: Params) => {
     inputEventTracker.accumulatedInputData = null
   }
 
-  const handleInputData = async (deviceId: string, inputData: DeviceInputData) => {
+  const handleInputData = (deviceId: string, inputData: DeviceInputState) => {
     const deviceData = deviceDataById[deviceId]
     doSendInputEventToClient(deviceData, inputData)
-    await doCalibrationTick(deviceData, inputData)
   }
 
   const handleEventRate = (deviceId: string, rate: number) => {
@@ -182,6 +145,11 @@ const createServer = (params: Params) => {
     params.socketIOServer.to(deviceId).emit('eventRate', event)
   }
 
+  const handleTelemetry = (deviceId: string, telemetry: DeviceTelemetry) => {
+    const event: ServerEvents.Telemetry = { deviceId, telemetry }
+    params.socketIOServer.to(deviceId).emit('telemetry', event)
+  }
+
   /* Start server. */
 
   params.deviceDrivers.forEach(dd => {
@@ -196,6 +164,12 @@ const createServer = (params: Params) => {
     socket.on('subscribeToDevice', (data: ClientEvents.SubscribeToDevice) => {
       consola.info(`Socket "${socket.handshake.address}" subscribed to device "${data.deviceId}"`)
       socket.join(data.deviceId)
+
+      // frames are deltas, so the new subscriber needs every sensor first.
+      const deviceData = deviceDataById[data.deviceId]
+      if (deviceData) {
+        deviceData.inputEventTracker.encoder.requestKeyframe()
+      }
     })
 
     socket.on('unsubscribeFromDevice', (data: ClientEvents.UnsubscribeFromDevice) => {
@@ -241,12 +215,20 @@ const createServer = (params: Params) => {
       const deviceData = deviceDataById[data.deviceId]
 
       deviceData.calibration = {
-        calibrationBuffer: data.calibrationBuffer,
-        currentSensorValueAverage: null,
-        inputEventsCalculated: 0
+        calibrationBuffer: data.calibrationBuffer
       }
 
       broadcastDevicesUpdated()
+
+      // device calibrates and saves the thresholds by itself.
+      try {
+        await deviceData.device.calibrate(data.calibrationBuffer)
+      } catch (e) {
+        consola.error(`Could not calibrate device id "${data.deviceId}":`, e)
+      }
+
+      deviceData.calibration = null
+      broadcastDevicesUpdated()
     })
 
     socket.on('disconnect', (reason: string) => {
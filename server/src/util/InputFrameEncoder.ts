@@ -0,0 +1,100 @@
+import { DeviceInputData } from '../../../common-types/device'
+
+// encodes input events of a device to the binary frames described in
+// common-types/events.ts. frames are deltas to the previous frame, so one
+// encoder is shared by everyone subscribed to the device.
+
+const FLAG_KEYFRAME = 0x01
+const FLAG_SENSORS_16_BIT = 0x02
+
+const HEADER_SIZE = 3
+
+// input events are sent volatile, so clients can miss frames. a keyframe
+// every now and then brings them back in sync.
+const KEYFRAME_INTERVAL = 20
+
+export type SensorBits = 8 | 16
+
+export default class InputFrameEncoder {
+  private sensorBits: SensorBits
+  private maxSensorValue: number
+  private lastSensorValues: Uint16Array
+  private framesSinceKeyframe = 0
+  private keyframeRequested = true
+
+  constructor(sensorCount: number, sensorBits: SensorBits) {
+    this.sensorBits = sensorBits
+    this.maxSensorValue = (1 << sensorBits) - 1
+    this.lastSensorValues = new Uint16Array(sensorCount)
+  }
+
+  // next frame contains all sensors. call when a client starts listening.
+  public requestKeyframe() {
+    this.keyframeRequested = true
+  }
+
+  public encode(inputData: DeviceInputData): Buffer {
+    const sensorCount = inputData.sensors.length
+    const buttonCount = inputData.buttons.length
+    const buttonBytes = Math.ceil(buttonCount / 8)
+    const maskBytes = Math.ceil(sensorCount / 8)
+    const valueSize = this.sensorBits / 8
+
+    const keyframe = this.keyframeRequested || this.framesSinceKeyframe >= KEYFRAME_INTERVAL
+    const changedSensors = new Uint16Array(sensorCount)
+    let changedCount = 0
+
+    for (let i = 0; i < sensorCount; i++) {
+      const value = Math.round(Math.min(Math.max(inputData.sensors[i], 0), 1) * this.maxSensorValue)
+
+      if (keyframe || value !== this.lastSensorValues[i]) {
+        changedSensors[changedCount++] = i
+      }
+
+      this.lastSensorValues[i] = value
+    }
+
+    const size = HEADER_SIZE + buttonBytes + (keyframe ? 0 : maskBytes) + changedCount * valueSize
+    const frame = Buffer.alloc(size)
+
+    frame[0] = (keyframe ? FLAG_KEYFRAME : 0) | (this.sensorBits === 16 ? FLAG_SENSORS_16_BIT : 0)
+    frame[1] = sensorCount
+    frame[2] = buttonCount
+
+    let offset = HEADER_SIZE
+
+    for (let i = 0; i < buttonCount; i++) {
+      if (inputData.buttons[i]) {
+        frame[offset + (i >> 3)] |= 1 << (i & 7)
+      }
+    }
+
+    offset += buttonBytes
+
+    if (!keyframe) {
+      for (let i = 0; i < changedCount; i++) {
+        const sensorIndex = changedSensors[i]
+        frame[offset + (sensorIndex >> 3)] |= 1 << (sensorIndex & 7)
+      }
+
+      offset += maskBytes
+    }
+
+    for (let i = 0; i < changedCount; i++) {
+      const value = this.lastSensorValues[changedSensors[i]]
+
+      if (this.sensorBits === 16) {
+        frame.writeUInt16LE(value, offset)
+      } else {
+        frame.writeUInt8(value, offset)
+      }
+
+      offset += valueSize
+    }
+
+    this.framesSinceKeyframe = keyframe ? 0 : this.framesSinceKeyframe + 1
+    this.keyframeRequested = false
+
+    return frame
+  }
+}